@@ -0,0 +1,96 @@
+/**
+ * Startup cost of every .obj file under a directory (default common/objects)
+ * with and without its binary mesh cache.
+ *
+ * "parse + build" is what a start without a cache does: parse the file, build
+ * the BVH and fill the triangle store. "cache" maps the cache written by the
+ * first run and fills the triangle store from it. Times are the best of a few
+ * runs. The caches go to a temporary directory, which is removed afterwards.
+ * Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -D LINUX -I include bench/MeshCacheBench.cpp $(find src -name '*.cpp' ! -name main.cpp) -o meshcachebench -pthread
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "MeshCache.hpp"
+#include "Object.hpp"
+
+namespace
+{
+    const int RUNS = 5;
+
+    // best of RUNS, in milliseconds
+    double bestTime(const std::function<void()> &load)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < RUNS; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            load();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    bool sameMesh(const MeshData &a, const MeshData &b)
+    {
+        return a.vertices.size() == b.vertices.size() && a.indices == b.indices && a.bvh.nodes.size() == b.bvh.nodes.size() &&
+               std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0 &&
+               std::memcmp(a.bvh.nodes.data(), b.bvh.nodes.data(), a.bvh.nodes.size() * sizeof(WideBVHNode)) == 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string root = argc > 1 ? argv[1] : "common/objects";
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "meshcachebench";
+
+    std::vector<std::string> files;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    printf("%-48s %9s %10s %16s %9s %8s %6s\n", "file", "triangles", "cache KiB", "parse + build ms", "cache ms", "speedup", "same");
+    for (const std::string &file : files)
+    {
+        std::string cachePath = MeshCache::pathFor(file, cacheDir.string());
+        MeshData built = MeshData::build(Object(file, 1));
+        if (!MeshCache::save(file, cachePath, built))
+        {
+            printf("%-48s could not write %s\n", file.c_str(), cachePath.c_str());
+            continue;
+        }
+
+        double buildTime = bestTime([&] {
+            MeshData mesh = MeshData::build(Object(file, 1));
+            mesh.toTriangleMesh(nullptr);
+        });
+        double cacheTime = bestTime([&] {
+            MeshData mesh;
+            MeshCache::load(file, cachePath, mesh);
+            mesh.toTriangleMesh(nullptr);
+        });
+
+        MeshData cached;
+        bool same = MeshCache::load(file, cachePath, cached) && sameMesh(built, cached);
+        double kib = std::filesystem::file_size(cachePath) / 1024.0;
+        printf("%-48s %9zu %10.0f %16.2f %9.2f %7.0fx %6s\n", file.c_str(), built.indices.size() / 3, kib,
+               buildTime, cacheTime, buildTime / cacheTime, same ? "yes" : "NO");
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(cacheDir, error);
+    return 0;
+}
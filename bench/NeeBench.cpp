@@ -0,0 +1,117 @@
+/**
+ * Checks that next-event estimation is unbiased on an emissive mesh: traces
+ * the same paths with light sampling and with scattering alone and compares
+ * the mean radiance.
+ *
+ * The scene is a diffuse floor under an emissive cube against a black sky.
+ * Both runs use the --nee integrator, so diffuse surfaces scatter the same
+ * way (the default mode's Lambertian is not cosine-weighted and converges to
+ * a slightly different image). In "scatter" the cube is made of loose
+ * triangles, which cannot be sampled as lights, so paths find it only by
+ * chance; in "nee" it is one CompoundShape, sampled by area and combined
+ * with scattering by MIS. The paths start above the floor and look down at
+ * random. "z" is the difference of the means in standard errors; unbiased
+ * estimators stay within about 3. Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -D LINUX -I include bench/NeeBench.cpp $(find src -name '*.cpp' ! -name main.cpp) -o neebench -pthread
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "globals.hpp"
+#include "Integrator.hpp"
+#include "Material.hpp"
+#include "World.hpp"
+
+namespace
+{
+    const uint32_t PATHS = 1 << 21;
+    const int DEPTH = 4; // min and max depth alike, so no Russian roulette
+
+    struct Estimate
+    {
+        double mean = 0, standardError = 0, seconds = 0;
+    };
+
+    // mean luminance of PATHS paths, each with its own random numbers
+    Estimate estimate(const World &world)
+    {
+        Integrator integrator(DEPTH, DEPTH, true);
+        auto start = std::chrono::steady_clock::now();
+        double sum = 0, sumSquares = 0;
+        for (uint32_t path = 0; path < PATHS; ++path)
+        {
+            util.beginSample(0, path, 0); // the camera stream; the integrator starts a stream per bounce
+            Vec3 target(util.randomDouble(-4, 4), 0, util.randomDouble(-4, 4));
+            Vec3 origin(0, 3, 6);
+            int pathLength;
+            Vec3 color = integrator.radiance(Ray(origin, (target - origin).normalize()), world, pathLength);
+            double luminance = 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
+            sum += luminance;
+            sumSquares += luminance * luminance;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        Estimate result;
+        result.mean = sum / PATHS;
+        double variance = std::max(0.0, sumSquares / PATHS - result.mean * result.mean);
+        result.standardError = std::sqrt(variance / PATHS);
+        result.seconds = elapsed.count();
+        return result;
+    }
+}
+
+int main()
+{
+    auto floorMaterial = std::make_shared<Lambertian>(Vec3(0.8, 0.8, 0.8));
+    auto cubeLight = std::make_shared<Emissive>(Vec3(4, 3.6, 3));
+
+    // a closed cube, so light samples on its far faces are hidden behind its near ones
+    Vec3 corners[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        corners[i] = Vec3(i & 1 ? 1 : -1, (i & 2 ? 1 : -1) + 2.5, i & 4 ? 1 : -1);
+    }
+    const int faces[6][4] = {{0, 1, 3, 2}, {4, 6, 7, 5}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 5, 7, 3}};
+    std::vector<std::shared_ptr<Triangle>> triangles;
+    for (const int *face : faces)
+    {
+        triangles.push_back(std::make_shared<Triangle>(corners[face[0]], corners[face[1]], corners[face[2]], cubeLight.get()));
+        triangles.push_back(std::make_shared<Triangle>(corners[face[0]], corners[face[2]], corners[face[3]], cubeLight.get()));
+    }
+
+    auto makeWorld = [&](bool mesh) {
+        World world;
+        Sky black;
+        black.top = black.bottom = Vec3(0, 0, 0);
+        world.setSky(black);
+
+        Vec3 a(-20, 0, -20), b(20, 0, -20), c(-20, 0, 20), d(20, 0, 20);
+        world.addObject(std::make_shared<Triangle>(a, c, b, floorMaterial.get()));
+        world.addObject(std::make_shared<Triangle>(b, c, d, floorMaterial.get()));
+        if (mesh)
+        {
+            world.addObject(std::make_shared<CompoundShape>(triangles, cubeLight.get()));
+        }
+        else
+        {
+            for (const std::shared_ptr<Triangle> &triangle : triangles)
+                world.addObject(triangle);
+        }
+        world.build();
+        return world;
+    };
+
+    Estimate scatter = estimate(makeWorld(false));
+    Estimate nee = estimate(makeWorld(true));
+    double z = (nee.mean - scatter.mean) / std::sqrt(scatter.standardError * scatter.standardError + nee.standardError * nee.standardError);
+
+    printf("%-8s %10s %10s %8s\n", "", "mean", "std err", "s");
+    printf("%-8s %10.5f %10.5f %8.2f\n", "scatter", scatter.mean, scatter.standardError, scatter.seconds);
+    printf("%-8s %10.5f %10.5f %8.2f\n", "nee", nee.mean, nee.standardError, nee.seconds);
+    printf("z = %.2f (%s)\n", z, std::fabs(z) < 3 ? "consistent" : "BIASED");
+    return std::fabs(z) < 3 ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+/**
+ * Load times of every .obj file under a directory (default common/objects).
+ *
+ * "legacy" is the previous loader: std::stringstream per line and a linear
+ * scan over all vertices for every face corner. The current Object loader is
+ * timed on one thread and on one thread per hardware thread. Times are the
+ * best of a few runs, including the file read. The last column checks that
+ * both loaders produce the same triangles. Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -I include bench/ObjLoaderBench.cpp src/MappedFile.cpp src/Object.cpp src/ThreadPool.cpp -o objloaderbench -pthread
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Object.hpp"
+
+namespace
+{
+    const int RUNS = 5;
+
+    // triangle corner positions, 9 per triangle
+    using Triangles = std::vector<float>;
+
+    Triangles legacyLoad(const std::string &filename)
+    {
+        std::ifstream inFile(filename);
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<float> vec_s, vec_t, vec_nx, vec_ny, vec_nz;
+
+        auto split = [](const std::string &str, char delimiter) {
+            std::vector<std::string> tokens;
+            std::stringstream stream(str);
+            std::string value;
+            while (std::getline(stream, value, delimiter))
+            {
+                if (!value.empty())
+                    tokens.push_back(value);
+            }
+            return tokens;
+        };
+
+        auto storeOrSkip = [&](const Vertex &vToAdd) {
+            for (unsigned int i = 0; i < vertices.size(); i++)
+            {
+                if (vToAdd == vertices[i])
+                {
+                    indices.push_back(i);
+                    return;
+                }
+            }
+            vertices.push_back(vToAdd);
+            indices.push_back(vertices.size() - 1);
+        };
+
+        std::string line;
+        while (getline(inFile, line))
+        {
+            if (line.length() < 2 || line.at(0) == '#')
+                continue;
+
+            std::stringstream stream(line);
+            std::string linePrefix;
+            stream >> linePrefix;
+            if (linePrefix == "v")
+            {
+                // never equal to a face corner, so only corners are shared
+                const float nan = std::numeric_limits<float>::quiet_NaN();
+                Vertex v(0, 0, 0, 0, 0, nan, nan, nan);
+                stream >> v.x >> v.y >> v.z;
+                vertices.push_back(v);
+            }
+            else if (linePrefix == "vt")
+            {
+                float s, t;
+                stream >> s >> t;
+                vec_s.push_back(s);
+                vec_t.push_back(t);
+            }
+            else if (linePrefix == "vn")
+            {
+                float nx, ny, nz;
+                stream >> nx >> ny >> nz;
+                vec_nx.push_back(nx);
+                vec_ny.push_back(ny);
+                vec_nz.push_back(nz);
+            }
+            else if (linePrefix == "f")
+            {
+                std::string face;
+                while (stream >> face)
+                {
+                    std::vector<std::string> tokens = split(face, '/');
+                    unsigned int v_idx = stoi(tokens.at(0)) - 1;
+                    bool hasVn = face.find("//") != std::string::npos || tokens.size() > 2;
+                    bool hasVt = face.find("//") == std::string::npos && tokens.size() > 1;
+                    unsigned int vt_idx = hasVt ? stoi(tokens.at(1)) - 1 : 0;
+                    unsigned int vn_idx = hasVn ? stoi(tokens.back()) - 1 : 0;
+
+                    Vertex v = vertices.at(v_idx);
+                    storeOrSkip(Vertex(v.x, v.y, v.z,
+                                       hasVt ? vec_s.at(vt_idx) : 0, hasVt ? vec_t.at(vt_idx) : 0,
+                                       hasVn ? vec_nx.at(vn_idx) : 0, hasVn ? vec_ny.at(vn_idx) : 0, hasVn ? vec_nz.at(vn_idx) : 0));
+                }
+            }
+        }
+
+        Triangles triangles;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const Vertex &v = vertices[indices[i + k]];
+                triangles.insert(triangles.end(), {v.x, v.y, v.z});
+            }
+        }
+        return triangles;
+    }
+
+    Triangles currentLoad(const std::string &filename, size_t numThreads, size_t *numVertices = nullptr)
+    {
+        Object obj(filename, numThreads);
+        if (numVertices)
+            *numVertices = obj.vertices.size();
+
+        Triangles triangles;
+        triangles.reserve(obj.indices.size() * 3);
+        for (unsigned int index : obj.indices)
+        {
+            const Vertex &v = obj.vertices[index];
+            triangles.insert(triangles.end(), {v.x, v.y, v.z});
+        }
+        return triangles;
+    }
+
+    // best of RUNS, in milliseconds
+    double bestTime(const std::function<void()> &load)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < RUNS; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            load();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string root = argc > 1 ? argv[1] : "common/objects";
+    size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> files;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    printf("%-48s %8s %9s %9s %11s %11s %11s %8s %6s\n", "file", "KiB", "triangles", "vertices",
+           "legacy ms", "1 thread ms", "N thread ms", "MB/s", "same");
+    for (const std::string &file : files)
+    {
+        double kib = std::filesystem::file_size(file) / 1024.0;
+        size_t numVertices = 0;
+        Triangles current = currentLoad(file, 1, &numVertices);
+        Triangles legacy = legacyLoad(file);
+
+        double legacyTime = bestTime([&] { legacyLoad(file); });
+        double singleTime = bestTime([&] { currentLoad(file, 1); });
+        double parallelTime = bestTime([&] { currentLoad(file, hardwareThreads); });
+        bool same = legacy == current && currentLoad(file, hardwareThreads) == current;
+
+        printf("%-48s %8.0f %9zu %9zu %11.2f %11.2f %11.2f %8.0f %6s\n", file.c_str(), kib, current.size() / 9, numVertices,
+               legacyTime, singleTime, parallelTime, kib / 1024.0 / (parallelTime / 1000.0), same ? "yes" : "NO");
+    }
+    printf("N = %zu threads\n", hardwareThreads);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Cost of Perlin noise one point at a time and Perlin::LANES points per call,
+ * and of the marble backdrop evaluated at every hit or looked up in its baked
+ * texture.
+ *
+ * The points are random, spread over a few hundred noise cells. Times are ns
+ * per point, the best of a few runs; "max diff" compares the point and batch
+ * versions, which should agree exactly. The marble rows time
+ * MarblePattern::at per point and per batch and Texture::sample on the baked
+ * texture at the same points, and "bake ms" is the time to bake it at
+ * RESOLUTION; the image goes to a temporary directory, which is removed
+ * afterwards. Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -D LINUX -I include bench/PerlinBench.cpp src/Perlin.cpp src/Procedural.cpp src/MappedFile.cpp src/Texture.cpp -o perlinbench -pthread
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Procedural.hpp"
+
+namespace
+{
+    const int RUNS = 5;
+    const int POINTS = 1 << 18; // a multiple of Perlin::LANES
+    const int LANES = Perlin::LANES;
+    const int RESOLUTION = 1024;
+
+    // best of RUNS, in milliseconds
+    double bestTime(const std::function<void()> &run)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int i = 0; i < RUNS; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main()
+{
+    auto noise = std::make_shared<const Perlin>(1);
+
+    // one array per coordinate, as the batch versions take them
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> uniform(-40, 40);
+    std::vector<double> x(POINTS), y(POINTS), z(POINTS);
+    for (int i = 0; i < POINTS; ++i)
+    {
+        x[i] = uniform(random);
+        y[i] = uniform(random);
+        z[i] = uniform(random);
+    }
+
+    std::vector<double> pointValues(POINTS), batchValues(POINTS);
+    double toNs = 1e6 / POINTS;
+    printf("%-16s %10s %10s %8s %9s\n", "", "point ns", "batch ns", "speedup", "max diff");
+    auto compare = [&](const char *name, const std::function<double(const Vec3 &)> &point,
+                       const std::function<void(const double *, const double *, const double *, double *)> &batch) {
+        double pointTime = bestTime([&] {
+            for (int i = 0; i < POINTS; ++i)
+                pointValues[i] = point(Vec3(x[i], y[i], z[i]));
+        });
+        double batchTime = bestTime([&] {
+            for (int i = 0; i < POINTS; i += LANES)
+                batch(&x[i], &y[i], &z[i], &batchValues[i]);
+        });
+        double maxDifference = 0;
+        for (int i = 0; i < POINTS; ++i)
+        {
+            maxDifference = std::max(maxDifference, std::abs(pointValues[i] - batchValues[i]));
+        }
+        printf("%-16s %10.1f %10.1f %7.2fx %9.2g\n", name, pointTime * toNs, batchTime * toNs, pointTime / batchTime, maxDifference);
+    };
+
+    compare("noise", [&](const Vec3 &p) { return noise->noise(p); },
+            [&](const double *px, const double *py, const double *pz, double *out) { noise->noise(px, py, pz, out); });
+    compare("fbm 4", [&](const Vec3 &p) { return noise->fbm(p, 4); },
+            [&](const double *px, const double *py, const double *pz, double *out) { noise->fbm(px, py, pz, 4, out); });
+    compare("turbulence 6", [&](const Vec3 &p) { return noise->turbulence(p, 6); },
+            [&](const double *px, const double *py, const double *pz, double *out) { noise->turbulence(px, py, pz, 6, out); });
+
+    // the marble on the scene's backdrop, at points on it
+    MarblePattern marble;
+    marble.noise = noise;
+    PlanarMapping mapping = {Vec3(-40, -4, -30), Vec3(80, 0, 0), Vec3(0, 34, 0)};
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<double> u(POINTS), v(POINTS);
+    for (int i = 0; i < POINTS; ++i)
+    {
+        u[i] = unit(random);
+        v[i] = unit(random);
+        Vec3 p = mapping.point(u[i], v[i]);
+        x[i] = p.x;
+        y[i] = p.y;
+        z[i] = p.z;
+    }
+
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "perlinbench";
+    std::filesystem::create_directories(cacheDir);
+    auto cache = std::make_shared<TextureCache>(64u << 20);
+    auto bakeStart = std::chrono::steady_clock::now();
+    std::shared_ptr<Texture> baked = bakeMarble(marble, mapping, RESOLUTION, cacheDir.string(), cache);
+    std::chrono::duration<double, std::milli> bakeTime = std::chrono::steady_clock::now() - bakeStart;
+
+    Vec3 sink(0, 0, 0);
+    std::vector<Vec3> colors(LANES);
+    double pointTime = bestTime([&] {
+        for (int i = 0; i < POINTS; ++i)
+            sink += marble.at(Vec3(x[i], y[i], z[i]));
+    });
+    double batchTime = bestTime([&] {
+        for (int i = 0; i < POINTS; i += LANES)
+        {
+            marble.at(&x[i], &y[i], &z[i], colors.data());
+            sink += colors[0];
+        }
+    });
+    double footprint = 1.0 / RESOLUTION;
+    double bakedTime = bestTime([&] {
+        for (int i = 0; i < POINTS; ++i)
+            sink += baked->sample(u[i], v[i], footprint);
+    });
+
+    printf("\n%-16s %10s %10s %10s %9s\n", "", "point ns", "batch ns", "baked ns", "bake ms");
+    printf("%-16s %10.1f %10.1f %10.1f %9.1f%s\n", "marble", pointTime * toNs, batchTime * toNs, bakedTime * toNs, bakeTime.count(),
+           sink.x < 0 ? " " : "");
+
+    std::error_code error;
+    std::filesystem::remove_all(cacheDir, error);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * Cost of image textures, for every .ppm file under a directory (default
+ * common/objects).
+ *
+ * "parse ms" reads the PPM the way a texture without a cache would have to on
+ * every start; "open ms" opens the converted cache written by the first run.
+ * Lookup times are per sample() call, in ns: "flat" is a bilinear lookup in a
+ * linear float array of level 0, "fp N" goes through the tiled, mipmapped
+ * texture with a footprint of N texels, so wider footprints read coarser
+ * levels, and fp 4 and up filter two levels. "random" lookups are spread
+ * uniformly over the image, the worst case for any cache; "coherent" ones
+ * walk 16x16 blocks of points a texel apart, like the hits of neighbouring
+ * pixels. "max diff" compares flat and the texture at footprint 0, which
+ * differ only by the 8-bit storage. The caches go to a temporary directory,
+ * which is removed afterwards. Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -D LINUX -I include bench/TextureBench.cpp src/MappedFile.cpp src/Texture.cpp -o texturebench -pthread
+*/
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Texture.hpp"
+
+namespace
+{
+    const int RUNS = 5;
+    const int LOOKUPS = 1 << 20;
+    const double FOOTPRINTS[] = {1, 4, 32}; // in texels
+
+    // best of RUNS, in milliseconds
+    double bestTime(const std::function<void()> &run)
+    {
+        double best = std::numeric_limits<double>::infinity();
+        for (int i = 0; i < RUNS; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    // level 0 as linear floats, the layout a texture without tiles or mips would use
+    struct FlatImage
+    {
+        int width = 0, height = 0;
+        std::vector<float> rgb;
+
+        // false for anything but a P3 with maxval 255, which is all the repository ships
+        bool read(const std::string &path)
+        {
+            MappedFile file(path);
+            const char *p = file.data();
+            const char *end = p + file.size();
+            auto number = [&](int &value) {
+                while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' || *p == '#'))
+                {
+                    if (*p == '#')
+                        p = std::find(p, end, '\n');
+                    else
+                        p++;
+                }
+                std::from_chars_result result = std::from_chars(p, end, value);
+                p = result.ptr;
+                return result.ec == std::errc();
+            };
+
+            int maxValue;
+            if (file.size() < 2 || p[0] != 'P' || p[1] != '3')
+                return false;
+            p += 2;
+            if (!number(width) || !number(height) || !number(maxValue) || maxValue != 255)
+                return false;
+            rgb.resize((size_t)width * height * 3);
+            for (float &value : rgb)
+            {
+                int encoded;
+                if (!number(encoded))
+                    return false;
+                value = (float)(encoded / 255.0 * (encoded / 255.0));
+            }
+            return true;
+        }
+
+        Vec3 texel(int x, int y) const
+        {
+            x = ((x % width) + width) % width;
+            y = ((y % height) + height) % height;
+            const float *c = &rgb[((size_t)y * width + x) * 3];
+            return Vec3(c[0], c[1], c[2]);
+        }
+
+        Vec3 sample(double u, double v) const
+        {
+            double x = (u - std::floor(u)) * width - 0.5;
+            double y = (1 - (v - std::floor(v))) * height - 0.5;
+            int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+            double fx = x - x0, fy = y - y0;
+            Vec3 top = (1 - fx) * texel(x0, y0) + fx * texel(x0 + 1, y0);
+            Vec3 bottom = (1 - fx) * texel(x0, y0 + 1) + fx * texel(x0 + 1, y0 + 1);
+            return (1 - fy) * top + fy * bottom;
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    std::string root = argc > 1 ? argv[1] : "common/objects";
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "texturebench";
+
+    std::vector<std::string> files;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".ppm")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+
+    printf("%-44s %8s %9s %9s | %-15s | %-33s\n", "", "", "", "texcache", "random ns", "coherent ns");
+    printf("%-44s %8s %9s %9s | %6s %8s | %6s %6s %6s %6s %6s | %s\n", "file", "size", "parse ms", "open ms", "flat",
+           "fp 0", "flat", "fp 0", "fp 1", "fp 4", "fp 32", "max diff");
+    for (const std::string &file : files)
+    {
+        FlatImage flat;
+        if (!flat.read(file))
+        {
+            printf("%-48s not a P3 with maxval 255, skipped\n", file.c_str());
+            continue;
+        }
+        auto cache = std::make_shared<TextureCache>(64u << 20);
+        std::shared_ptr<Texture> texture = Texture::load(file, cacheDir.string(), cache);
+
+        double parseTime = bestTime([&] { FlatImage().read(file); });
+        double openTime = bestTime([&] { Texture::load(file, cacheDir.string(), cache); });
+
+        // the same points for every column of a pattern
+        std::mt19937_64 random(1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        std::vector<double> randomPoints(2 * LOOKUPS), coherentPoints(2 * LOOKUPS);
+        for (double &coordinate : randomPoints)
+        {
+            coordinate = uniform(random);
+        }
+        double step = 1.0 / std::max(flat.width, flat.height);
+        for (int block = 0; block < LOOKUPS / 256; ++block)
+        {
+            double u = uniform(random), v = uniform(random);
+            for (int i = 0; i < 256; ++i)
+            {
+                coherentPoints[2 * (block * 256 + i)] = u + (i % 16) * step;
+                coherentPoints[2 * (block * 256 + i) + 1] = v - (i / 16) * step;
+            }
+        }
+
+        Vec3 sink(0, 0, 0);
+        auto flatTime = [&](const std::vector<double> &points) {
+            return bestTime([&] {
+                for (int i = 0; i < LOOKUPS; ++i)
+                    sink += flat.sample(points[2 * i], points[2 * i + 1]);
+            });
+        };
+        auto textureTime = [&](const std::vector<double> &points, double texels) {
+            double footprint = texels / std::max(texture->width(), texture->height());
+            return bestTime([&] {
+                for (int i = 0; i < LOOKUPS; ++i)
+                    sink += texture->sample(points[2 * i], points[2 * i + 1], footprint);
+            });
+        };
+
+        double times[7] = {flatTime(randomPoints), textureTime(randomPoints, 0), flatTime(coherentPoints), textureTime(coherentPoints, 0)};
+        for (int f = 0; f < 3; ++f)
+        {
+            times[4 + f] = textureTime(coherentPoints, FOOTPRINTS[f]);
+        }
+
+        double maxDifference = 0;
+        for (int i = 0; i < LOOKUPS; i += 97)
+        {
+            Vec3 difference = flat.sample(randomPoints[2 * i], randomPoints[2 * i + 1]) - texture->sample(randomPoints[2 * i], randomPoints[2 * i + 1], 0);
+            maxDifference = std::max({maxDifference, std::abs(difference.x), std::abs(difference.y), std::abs(difference.z)});
+        }
+
+        std::string size = std::to_string(flat.width) + "x" + std::to_string(flat.height);
+        double toNs = 1e6 / LOOKUPS;
+        printf("%-44s %8s %9.2f %9.3f | %6.1f %8.1f | %6.1f %6.1f %6.1f %6.1f %6.1f | %.4f%s\n", file.c_str(), size.c_str(), parseTime,
+               openTime, times[0] * toNs, times[1] * toNs, times[2] * toNs, times[3] * toNs, times[4] * toNs, times[5] * toNs,
+               times[6] * toNs, maxDifference, sink.x < 0 ? " " : "");
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(cacheDir, error);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * Microbenchmark for the header-only Vec3.
+ *
+ * Runs the same Moller-Trumbore style workload (subtract, cross, dot,
+ * normalize) over a fixed set of vectors twice. The first run uses LegacyVec3,
+ * a copy of the old Vec3 whose operators are kept out of line, as they were in
+ * src/Vec3.cpp. The second run uses the inlined Vec3. Build from the repository root:
+ *
+ *   g++ -std=c++17 -O2 -I include bench/Vec3Bench.cpp -o vec3bench
+ *   g++ -std=c++17 -O2 -mavx -D VEC3_SIMD -I include bench/Vec3Bench.cpp -o vec3bench
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Vec3.hpp"
+
+#define NOINLINE __attribute__((noinline))
+
+struct LegacyVec3
+{
+    double x, y, z;
+
+    LegacyVec3() : x(0), y(0), z(0) {}
+    LegacyVec3(double x, double y, double z) : x(x), y(y), z(z) {}
+
+    NOINLINE LegacyVec3 operator-(const LegacyVec3 &other) const { return LegacyVec3(x - other.x, y - other.y, z - other.z); }
+    NOINLINE LegacyVec3 operator+(const LegacyVec3 &other) const { return LegacyVec3(x + other.x, y + other.y, z + other.z); }
+    NOINLINE double dot(const LegacyVec3 &other) const { return x * other.x + y * other.y + z * other.z; }
+    NOINLINE LegacyVec3 cross(const LegacyVec3 &other) const
+    {
+        return LegacyVec3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    }
+    NOINLINE LegacyVec3 normalize() const
+    {
+        double len = std::sqrt(x * x + y * y + z * z);
+        return LegacyVec3(x / len, y / len, z / len);
+    }
+};
+
+template <typename V>
+double workload(const std::vector<V> &points, int repeats)
+{
+    double sum = 0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        for (size_t i = 0; i + 3 < points.size(); ++i)
+        {
+            V edge1 = points[i + 1] - points[i];
+            V edge2 = points[i + 2] - points[i];
+            V pvec = points[i + 3].cross(edge2);
+            double det = edge1.dot(pvec);
+            V normal = edge1.cross(edge2).normalize();
+            sum += det + normal.dot(points[i + 3]);
+        }
+    }
+    return sum;
+}
+
+template <typename V>
+double timeWorkload(const char *name, int repeats, double &checksum)
+{
+    std::vector<V> points;
+    for (int i = 0; i < 4096; ++i)
+    {
+        points.push_back(V(std::sin(i * 0.37), std::cos(i * 0.11), std::sin(i * 0.05 + 1.0)));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    checksum = workload(points, repeats);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double nanosPerTriangle = elapsed.count() * 1e9 / (repeats * (points.size() - 3));
+    printf("%-22s: %8.3f (sec) %6.2f (ns/triangle)\n", name, elapsed.count(), nanosPerTriangle);
+    return elapsed.count();
+}
+
+int main()
+{
+    const int repeats = 5000;
+    double legacySum, inlineSum;
+
+#ifdef VEC3_SIMD
+    const char *name = "Vec3 (header, SIMD)";
+#else
+    const char *name = "Vec3 (header)";
+#endif
+
+    double legacy = timeWorkload<LegacyVec3>("Vec3 (out of line)", repeats, legacySum);
+    double inlined = timeWorkload<Vec3>(name, repeats, inlineSum);
+
+    printf("Speedup               : %8.2fx\n", legacy / inlined);
+    printf("Checksums             : %.17g %.17g\n", legacySum, inlineSum);
+    return legacySum == inlineSum ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "BoundingBox.hpp"
+#include "Ray.hpp"
+
+/**
+ * Flattened BVH node.
+ * Interior nodes store the index of their left child (the right child is stored
+ * right after it), leaves store the offset of their first primitive and a count.
+*/
+struct BVHNode
+{
+    BoundingBox bounds;
+    uint32_t leftOrFirst;
+    uint32_t count; // 0 for interior nodes
+    uint32_t axis;  // split axis of interior nodes
+
+    bool isLeaf() const { return count > 0; }
+};
+
+struct BVHStats
+{
+    size_t numNodes = 0;
+    size_t numLeaves = 0;
+    size_t maxDepth = 0;
+    size_t maxLeafSize = 0;
+    double averageLeafSize = 0;
+    double sahCost = 0;
+    double buildTime = 0; // seconds
+    size_t refits = 0;    // refits since the last build
+};
+
+/* Acceleration Structure Requirement */
+class BVH
+{
+public:
+    static const int NUM_BINS = 16;
+    static const int MAX_STACK_DEPTH = 64;
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primIndices; // leaf order -> caller's primitive index
+    BVHStats stats;
+
+    /**
+     * Builds the hierarchy with binned SAH over the given primitive bounds.
+     * Primitives are referenced by their index in primBounds.
+    */
+    void build(const std::vector<BoundingBox> &primBounds, int maxLeafSize = 2);
+
+    /**
+     * Updates the bounds after the given primitives changed, walking only from
+     * their leaves towards the root and stopping where a box no longer changes.
+     * The topology is kept, so stats.sahCost may grow; callers rebuild when it
+     * has degraded too much.
+    */
+    void refit(const std::vector<BoundingBox> &primBounds, const std::vector<uint32_t> &changedPrims);
+
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    /**
+     * Closest-hit traversal. Children are visited front to back and subtrees
+     * that start beyond the closest hit so far are skipped.
+     * intersectPrim(primIndex, tMin, closestT) must return true on a hit and
+     * shrink closestT to the hit distance.
+     * root selects the subtree to traverse.
+    */
+    template <typename PrimIntersector>
+    bool traverse(const Ray &ray, double tMin, double tMax, PrimIntersector &&intersectPrim, uint32_t root = 0) const;
+
+    /**
+     * Same traversal, but hands whole leaves to intersectLeaf(first, count,
+     * tMin, closestT), where [first, first + count) indexes primIndices. For
+     * callers that store their primitives in leaf order.
+    */
+    template <typename LeafIntersector>
+    bool traverseLeaves(const Ray &ray, double tMin, double tMax, LeafIntersector &&intersectLeaf, uint32_t root = 0) const;
+
+private:
+    void buildRecursive(uint32_t nodeIndex, const std::vector<BoundingBox> &primBounds,
+                        const std::vector<Vec3> &centroids, uint32_t first, uint32_t count,
+                        size_t depth, int maxLeafSize);
+    void computeStats(double buildTime);
+
+    std::vector<uint32_t> parents;    // per node, for refitting
+    std::vector<uint32_t> primLeaves; // caller's primitive index -> leaf node
+    double weightedArea = 0;          // SAH cost before dividing by the root area
+};
+
+template <typename PrimIntersector>
+bool BVH::traverse(const Ray &ray, double tMin, double tMax, PrimIntersector &&intersectPrim, uint32_t root) const
+{
+    return traverseLeaves(ray, tMin, tMax, [&](uint32_t first, uint32_t count, double leafTMin, double &closestT) {
+        bool hitAnything = false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (intersectPrim(primIndices[first + i], leafTMin, closestT))
+            {
+                hitAnything = true;
+            }
+        }
+        return hitAnything;
+    }, root);
+}
+
+template <typename LeafIntersector>
+bool BVH::traverseLeaves(const Ray &ray, double tMin, double tMax, LeafIntersector &&intersectLeaf, uint32_t root) const
+{
+    if (nodes.empty())
+        return false;
+
+    double rootEntry;
+    if (!nodes[root].bounds.intersect(ray, tMin, tMax, rootEntry))
+        return false;
+
+    struct StackEntry
+    {
+        uint32_t node;
+        double tEntry;
+    };
+    StackEntry stack[MAX_STACK_DEPTH];
+    int stackSize = 0;
+
+    bool hitAnything = false;
+    double closestT = tMax;
+    uint32_t current = root;
+
+    while (true)
+    {
+        const BVHNode &node = nodes[current];
+
+        if (node.isLeaf())
+        {
+            if (intersectLeaf(node.leftOrFirst, node.count, tMin, closestT))
+            {
+                hitAnything = true;
+            }
+        }
+        else
+        {
+            uint32_t nearChild = node.leftOrFirst;
+            uint32_t farChild = node.leftOrFirst + 1;
+            double tNear, tFar;
+            bool hitNear = nodes[nearChild].bounds.intersect(ray, tMin, closestT, tNear);
+            bool hitFar = nodes[farChild].bounds.intersect(ray, tMin, closestT, tFar);
+
+            if (hitNear && hitFar)
+            {
+                if (tFar < tNear)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(tNear, tFar);
+                }
+                stack[stackSize++] = {farChild, tFar};
+                current = nearChild;
+                continue;
+            }
+            if (hitNear)
+            {
+                current = nearChild;
+                continue;
+            }
+            if (hitFar)
+            {
+                current = farChild;
+                continue;
+            }
+        }
+
+        // pop the next subtree that can still contain a closer hit
+        bool found = false;
+        while (stackSize > 0)
+        {
+            StackEntry entry = stack[--stackSize];
+            if (entry.tEntry <= closestT)
+            {
+                current = entry.node;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            break;
+    }
+
+    return hitAnything;
+}
+
+#endif
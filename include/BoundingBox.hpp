@@ -2,6 +2,7 @@
 #define BOUNDINGBOX_HPP
 
 #include "Ray.hpp"
+#include "RayPacket.hpp"
 #include "Vec3.hpp"
 
 /* Bounding Volume Requirement */
@@ -15,6 +16,10 @@ public:
 
     Vec3 centroid() const;
     bool intersect(const Ray &ray, double t_min, double t_max) const;
+    bool intersect(const Ray &ray, double t_min, double t_max, double &t_entry) const;
+    // returns the active lanes whose ray enters the box before its tMax, with entry distances
+    uint32_t intersectPacket(const RayPacket &packet, double t_min, uint32_t activeMask, double *t_entry) const;
+    double surfaceArea() const;
     static BoundingBox surroundingBox(const BoundingBox &box1, const BoundingBox &box2);
 };
 
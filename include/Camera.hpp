@@ -17,6 +17,11 @@ public:
     Camera(const Vec3& origin, const Vec3& target, const Vec3& up, double verticalFOV, double aspectRatio, double aperture, double focusDistance);
 
     Ray getRay(double s, double t, double time) const;
+    // lensPoint: point in the unit disk, e.g. from Utility::pointInUnitDisk
+    Ray getRay(double s, double t, double time, const Vec3 &lensPoint) const;
+
+    // angle between the rays through neighbouring pixel rows, for ray cones
+    double pixelSpreadAngle(int imageHeight) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef DENOISER_HPP
+#define DENOISER_HPP
+
+#include <vector>
+
+#include "ThreadPool.hpp"
+#include "Vec3.hpp"
+
+// per-pixel auxiliary outputs of a frame, top row first, averaged over the pixel's samples
+struct AovBuffers
+{
+    std::vector<Vec3> albedo;
+    std::vector<Vec3> normal;
+    std::vector<double> depth;    // over the samples that hit something; infinite if none did
+    std::vector<double> variance; // of the pixel's mean luminance; infinite below 2 samples
+
+    void resize(size_t numPixels)
+    {
+        albedo.resize(numPixels);
+        normal.resize(numPixels);
+        depth.resize(numPixels);
+        variance.resize(numPixels);
+    }
+};
+
+/**
+ * Edge-aware a-trous wavelet filter in the spirit of SVGF (Schied et al.,
+ * "Spatiotemporal Variance-Guided Filtering", 2017), without the temporal part.
+ *
+ * The color is divided by the albedo first, so only lighting is blurred and
+ * texture and material edges come back untouched when it is multiplied again.
+ * Each of ITERATIONS passes applies a 5x5 B3-spline kernel whose taps are
+ * 1, 2, 4, ... pixels apart. Taps are weighted down across normal and depth
+ * discontinuities, and where the luminance differs by more than the pixel's
+ * estimated noise, which is filtered along with the color.
+*/
+class Denoiser
+{
+public:
+    static const int ITERATIONS = 5;
+    static constexpr double SIGMA_LUMINANCE = 4.0;
+    static constexpr double SIGMA_NORMAL = 128.0; // exponent on the normal cosine
+    static constexpr double SIGMA_DEPTH = 1.0;    // in units of the local depth gradient
+    static constexpr double SIGMA_ALBEDO = 0.1;
+
+    Denoiser(int width, int height);
+
+    // filters the linear colors in place; runs the passes row-parallel on pool
+    void denoise(std::vector<Vec3> &color, const AovBuffers &aovs, ThreadPool &pool);
+
+private:
+    int width, height;
+    // scratch, kept between frames
+    std::vector<Vec3> lighting[2];
+    std::vector<double> variance[2];
+    std::vector<Vec3> normals;      // unit length
+    std::vector<double> depthSlope; // depth change per pixel
+
+    void filterPass(int step, const AovBuffers &aovs, int source, ThreadPool &pool);
+};
+
+#endif
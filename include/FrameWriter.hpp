@@ -0,0 +1,130 @@
+#ifndef FRAMEWRITER_HPP
+#define FRAMEWRITER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Vec3.hpp"
+
+enum class ImageFormat
+{
+    P3,    // ASCII PPM, 8 bits per channel
+    P6,    // binary PPM, 8 bits per channel
+    PPM16, // binary PPM, 16 bits per channel
+    PFM    // binary float map, linear (no gamma)
+};
+
+namespace ImageEncoding
+{
+    ImageFormat parseFormat(const std::string &name);
+    const char *extension(ImageFormat format);
+
+    // header, payload and size of one pixel; P3 has no fixed pixel size
+    std::string header(ImageFormat format, int width, int height);
+    size_t bytesPerPixel(ImageFormat format);
+
+    /**
+     * Encodes one row segment of linear colors (gamma 2 for the integer formats,
+     * as before). Not supported for P3.
+    */
+    void encodePixels(ImageFormat format, const Vec3 *pixels, size_t count, uint8_t *out);
+
+    // full file contents; pixels are stored top row first
+    std::vector<uint8_t> encode(ImageFormat format, const std::vector<Vec3> &pixels, int width, int height);
+
+    // 16-bit binary PGM of per-pixel counts (e.g. samples), scaled so the largest count is white
+    std::vector<uint8_t> encodeCounts(const std::vector<uint32_t> &counts, int width, int height);
+}
+
+/**
+ * Writes frames from a dedicated I/O thread.
+ * The writer owns a fixed set of framebuffers (two by default): the renderer
+ * fills some while the others are encoded and flushed, so frame N + 1 renders
+ * while frame N is written.
+*/
+class FrameWriter
+{
+public:
+    FrameWriter(ImageFormat format, int width, int height, int numBuffers = 2);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    /**
+     * Returns a framebuffer that is not being written, waiting for the I/O
+     * thread if both are in flight. Returns the time spent waiting.
+    */
+    std::vector<Vec3> &acquireBuffer(double &waitTime);
+
+    // queues the acquired buffer to be written to path; the buffer must not be touched afterwards
+    void submit(std::vector<Vec3> &buffer, const std::string &path);
+
+    // waits until every submitted frame is on disk
+    void flush();
+
+private:
+    struct Job
+    {
+        int buffer;
+        std::string path;
+    };
+
+    ImageFormat format;
+    int width, height;
+    std::vector<std::vector<Vec3>> buffers;
+    std::vector<bool> bufferBusy;
+
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable freeCondition;
+    std::deque<Job> jobs;
+    bool stopping = false;
+    std::string error;
+    std::thread thread;
+
+    void ioLoop();
+    // index of a buffer that is not in flight, -1 if there is none; call with mutex held
+    int freeBuffer() const;
+};
+
+/**
+ * Tile-streaming output for very large images: the file is sized up front and
+ * every finished tile is encoded and written in place with positional writes,
+ * so no full framebuffer is needed. Safe to call from several render threads.
+*/
+class TileStreamWriter
+{
+public:
+    TileStreamWriter(ImageFormat format, const std::string &path, int width, int height);
+    ~TileStreamWriter();
+
+    TileStreamWriter(const TileStreamWriter &) = delete;
+    TileStreamWriter &operator=(const TileStreamWriter &) = delete;
+
+    // pixels: tileWidth * tileHeight colors, row by row; y counted from the top row
+    void writeTile(int x0, int y0, int tileWidth, int tileHeight, const Vec3 *pixels);
+
+    // closes the file, throwing if any tile failed to write
+    void close();
+
+private:
+    ImageFormat format;
+    int width, height;
+    size_t headerSize;
+    int fd = -1;
+    std::atomic<bool> failed{false}; // set from render threads, reported by close()
+#ifdef MINGW
+    std::mutex mutex; // no pwrite, so seek and write under a lock
+#endif
+
+    bool writeAt(const uint8_t *data, size_t size, size_t offset);
+};
+
+#endif
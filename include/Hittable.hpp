@@ -5,9 +5,14 @@
 #include <vector>
 
 #include "BoundingBox.hpp"
+#include "BVH.hpp"
 #include "Ray.hpp"
+#include "RayPacket.hpp"
+#include "TriangleStore.hpp"
+#include "WideBVH.hpp"
 #include "Vec3.hpp"
 
+class Hittable;
 class Material;
 
 struct HitRecord
@@ -15,8 +20,12 @@ struct HitRecord
     Vec3 point;
     Vec3 normal;
     const Material *material;
+    const Hittable *object = nullptr; // the top-level object hit, set by World
     double t;
     bool frontFace;
+    double u = 0, v = 0;   // texture coordinates, for meshes that keep them
+    double uvScale = 0;    // uv units per world unit around the hit
+    double footprint = 0;  // world-space width of the pixel's ray cone at the hit, set by the Integrator
 
     inline void setFaceNormal(const Ray &r, const Vec3 &outwardNormal)
     {
@@ -38,6 +47,47 @@ public:
     virtual void moveTo(const Vec3 &pos) = 0;
     virtual Vec3 normal(const Vec3 &point) const = 0;
     virtual void translate(const Vec3 &offset) = 0;
+
+    // copy to be moved or re-materialed without touching this one; shares immutable geometry
+    virtual std::shared_ptr<Hittable> clone() const = 0;
+
+    /**
+     * Light sampling: shapes that can be sampled as lights pick a point on
+     * themselves from two uniform numbers and return the direction to it from
+     * origin, its distance and the solid angle pdf. The others return false
+     * and are only found by following scattered rays. A sample counts only if
+     * the point is the first thing a ray towards it hits, so a point behind
+     * another part of the shape is dropped rather than credited to the part
+     * in front.
+    */
+    virtual bool supportsLightSampling() const { return false; }
+    virtual bool sampleDirection(const Vec3 &origin, double time, double u1, double u2, Vec3 &direction, double &distance,
+                                 double &pdf) const
+    {
+        return false;
+    }
+    // pdf of sampleDirection returning the first point direction hits on this shape; the only sample that counts there
+    virtual double directionPdf(const Vec3 &origin, double time, const Vec3 &direction) const { return 0; }
+    // solid angle the shape covers seen from origin, possibly estimated; weighs the choice between lights
+    virtual double solidAngle(const Vec3 &origin, double time) const { return 0; }
+
+    /**
+     * Intersects the active lanes of a packet, recording closer hits in
+     * packet.tMax and packet.hitObject (as id). Shapes with a vectorized kernel
+     * override this; the default traces the lanes one by one.
+    */
+    virtual void intersectPacket(RayPacket &packet, uint32_t activeMask, double t_min, int id) const
+    {
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane)
+        {
+            HitRecord rec;
+            if ((activeMask & (1u << lane)) && intersect(packet.ray(lane), t_min, packet.tMax[lane], rec))
+            {
+                packet.tMax[lane] = rec.t;
+                packet.hitObject[lane] = id;
+            }
+        }
+    }
 };
 
 class Sphere : public Hittable
@@ -55,6 +105,20 @@ public:
     void moveTo(const Vec3 &pos) override;
     Vec3 normal(const Vec3 &point) const override;
     void translate(const Vec3 &offset) override;
+    std::shared_ptr<Hittable> clone() const override;
+    void intersectPacket(RayPacket &packet, uint32_t activeMask, double t_min, int id) const override;
+
+    // uniform over the cone of directions the sphere covers, seen from outside
+    bool supportsLightSampling() const override { return true; }
+    bool sampleDirection(const Vec3 &origin, double time, double u1, double u2, Vec3 &direction, double &distance,
+                         double &pdf) const override;
+    double directionPdf(const Vec3 &origin, double time, const Vec3 &direction) const override;
+    double solidAngle(const Vec3 &origin, double time) const override;
+
+private:
+    Vec3 centerAt(double time) const { return center_start + (center_end - center_start) * time; }
+    // cosine of the cone's half angle, false from inside the sphere
+    bool coneCosine(const Vec3 &origin, double time, double &cosMax) const;
 };
 
 class Triangle : public Hittable
@@ -73,20 +137,48 @@ public:
     void moveTo(const Vec3 &pos) override;
     Vec3 normal(const Vec3 &point) const override;
     void translate(const Vec3 &offset) override;
+    std::shared_ptr<Hittable> clone() const override;
+    void intersectPacket(RayPacket &packet, uint32_t activeMask, double t_min, int id) const override;
+};
+
+/**
+ * Triangles of a CompoundShape and the BVH over them, in local space. Never
+ * changes after construction, so every copy of the shape shares one.
+*/
+struct TriangleMesh
+{
+    TriangleStore triangles; // in BVH leaf order
+    WideBVH bvh;
+    std::vector<double> areaCdf; // running sum of the triangle areas, for light sampling
+
+    // fills areaCdf once the triangles are in
+    void computeAreaCdf();
 };
 
 class CompoundShape : public Hittable
 {
 public:
-    std::vector<std::shared_ptr<Triangle>> triangles;
+    std::shared_ptr<const TriangleMesh> mesh; // in local space, i.e. where the triangles were loaded
+    Vec3 offset;                              // local space -> world space translation
 
     CompoundShape(const std::vector<std::shared_ptr<Triangle>> &triangles, const Material *material);
+    // shares a mesh built elsewhere, e.g. loaded from a MeshCache
+    CompoundShape(std::shared_ptr<const TriangleMesh> mesh, const Material *material);
 
     BoundingBox calculateBoundingBox() const override;
     bool intersect(const Ray &ray, double t_min, double t_max, HitRecord &rec) const override;
     void moveTo(const Vec3 &pos) override;
     Vec3 normal(const Vec3 &point) const override;
     void translate(const Vec3 &offset) override;
+    std::shared_ptr<Hittable> clone() const override;
+
+    // uniform over the surface area
+    bool supportsLightSampling() const override { return true; }
+    bool sampleDirection(const Vec3 &origin, double time, double u1, double u2, Vec3 &direction, double &distance,
+                         double &pdf) const override;
+    double directionPdf(const Vec3 &origin, double time, const Vec3 &direction) const override;
+    // from the area and the distance to the bounding box, as if every triangle were seen at 60 degrees
+    double solidAngle(const Vec3 &origin, double time) const override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef INTEGRATOR_HPP
+#define INTEGRATOR_HPP
+
+#include "Ray.hpp"
+#include "Vec3.hpp"
+#include "World.hpp"
+
+/**
+ * Iterative path tracer. Carries the path throughput forward instead of
+ * multiplying attenuation on the way back up a recursion.
+ * After minDepth bounces, paths are ended by Russian roulette with a survival
+ * probability that follows the throughput; survivors are reweighted by
+ * 1 / probability, so the estimate stays unbiased. Paths that reach maxDepth
+ * bounces see the top sky color, as before.
+ *
+ * With next-event estimation, every diffuse vertex also samples one of the
+ * world's lights and traces a shadow ray to it. Diffuse vertices then scatter
+ * cosine-weighted, and both estimates of a light are combined with the power
+ * heuristic. Emitters that cannot be sampled (single triangles) are still found
+ * by scattering alone.
+ *
+ * Each path also carries a ray cone that opens by the pixel spread angle, so
+ * materials know the width of the surface a pixel covers at every hit (for
+ * texture filtering). The cone is not widened at rough bounces, so the
+ * footprint after a diffuse bounce is an underestimate, never an overblur.
+*/
+// what a camera ray sees first, for the AOVs
+struct FirstHit
+{
+    Vec3 albedo; // the material's base color, or the sky color for rays that miss
+    Vec3 normal; // towards the camera; the reversed ray direction for misses
+    double depth; // distance along the ray, infinite for misses
+};
+
+class Integrator
+{
+public:
+    Integrator(int minDepth, int maxDepth, bool nextEventEstimation = false);
+
+    // angle a pixel's ray cone opens by, from Camera::pixelSpreadAngle; 0 gives point footprints
+    void setPixelSpread(double angle) { pixelSpread = angle; }
+
+    // pathLength: number of segments traced for this path; firstHit, if given, receives the AOVs
+    Vec3 radiance(const Ray &ray, const World &world, int &pathLength, FirstHit *firstHit = nullptr) const;
+
+    // continues a path whose first intersection is already known, e.g. from packet tracing
+    Vec3 radiance(const Ray &ray, const World &world, bool primaryHit, const HitRecord &primaryRec, int &pathLength,
+                  FirstHit *firstHit = nullptr) const;
+
+    // The steps radiance takes, for tracing many paths breadth-first instead (see Wavefront).
+    // Both orders draw the same random numbers, so they give the same images.
+
+    // a path between two bounces
+    struct Path
+    {
+        Ray ray; // the next segment to trace
+        Vec3 throughput = Vec3(1, 1, 1);
+        Vec3 result = Vec3(0, 0, 0); // light sampled so far; the path's radiance once it ends
+        double scatterPdf = 0; // of the last scatter if it was diffuse and lights were sampled there, else 0
+        double coneWidth = 0;  // at the last vertex
+    };
+
+    // a light sampled at a diffuse vertex; it counts once a shadow ray reaches it unoccluded
+    struct LightSample
+    {
+        Ray shadowRay;
+        double distance = 0;             // to the sampled point along shadowRay
+        const Hittable *light = nullptr; // null if no light was sampled
+        Vec3 throughput;                 // of the path at the vertex
+        Vec3 albedo;
+        double weight; // scatter pdf over light pdf, times the MIS weight
+    };
+
+    int maxBounces() const { return maxDepth; }
+
+    // the AOVs of a camera ray, from its first intersection
+    void firstHit(const Ray &ray, const World &world, bool hit, const HitRecord &rec, FirstHit &out) const;
+
+    // ends a path whose ray left the scene
+    void miss(Path &path, const World &world) const;
+    // ends a path that survived maxBounces bounces
+    void exhaust(Path &path, const World &world) const;
+
+    /**
+     * Shades the hit rec of path.ray at the given bounce, after
+     * util.beginBounce(bounce). Returns false if the path ends here; otherwise
+     * path.ray is the next segment. light.light is set if a light was sampled.
+    */
+    bool shade(const World &world, int bounce, HitRecord &rec, Path &path, LightSample &light) const;
+
+    // adds the light to path.result if the shadow ray's first hit is the sampled point
+    void traceShadow(const World &world, const LightSample &light, Path &path) const;
+
+private:
+    static constexpr double MAX_SURVIVAL_PROBABILITY = 0.95;
+    static constexpr double MIN_FOOTPRINT_COSINE = 1e-3; // caps the stretch of cones at grazing hits
+    static constexpr double SHADOW_DISTANCE_TOLERANCE = 1e-4; // relative; a shadow hit this close is the sampled point
+
+    int minDepth;
+    int maxDepth;
+    bool nextEventEstimation;
+    double pixelSpread = 0;
+
+    static Vec3 sky(const Ray &ray, const Sky &sky);
+    // width of a cone of the given width where it meets the surface; the square root of the stretch keeps its area
+    static double surfaceFootprint(double coneWidth, const HitRecord &rec, const Vec3 &direction);
+    // weight of a sample from the strategy with pdf a, combined with the one with pdf b
+    static double powerHeuristic(double a, double b);
+    // picks a light for a diffuse hit; light.light stays null if none can be seen from it
+    void sampleDirectLight(const World &world, const Ray &ray, const HitRecord &rec, const Vec3 &albedo,
+                           const Vec3 &throughput, LightSample &light) const;
+};
+
+#endif
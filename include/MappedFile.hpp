@@ -0,0 +1,57 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Read-only view of a whole file. The file is memory-mapped, so pages are only
+ * read from disk (or the page cache) when touched; on MinGW it is read into
+ * memory instead.
+*/
+class MappedFile
+{
+public:
+    // throws std::runtime_error if the file cannot be opened or mapped
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return begin; }
+    size_t size() const { return length; }
+
+    // 64-bit hash of the contents; tells an edited source from the one a cache was made of
+    uint64_t hash() const;
+
+private:
+    const char *begin = nullptr;
+    size_t length = 0;
+#ifdef MINGW
+    std::string contents;
+#endif
+};
+
+// size and modification time of a file, the cheap test of whether a cache made from it is stale
+struct FileStamp
+{
+    uint64_t size = 0;
+    int64_t time = 0; // in the file clock's native units
+
+    // false if the file does not exist
+    static bool read(const std::string &path, FileStamp &stamp);
+};
+
+// NAME.EXT.<extension> in cacheDir, or next to the source if cacheDir is empty
+std::string cachePathFor(const std::string &sourcePath, const std::string &cacheDir, const std::string &extension);
+
+/**
+ * Writes data to a temporary file next to path and renames it over path, so
+ * readers (other processes included) never see a partial file. Creates the
+ * directory if needed. Returns false on I/O errors.
+*/
+bool replaceFile(const std::string &path, const void *data, size_t size);
+
+#endif
@@ -3,17 +3,41 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 
 #include "globals.hpp"
 #include "Hittable.hpp"
+#include "Procedural.hpp"
 #include "Ray.hpp"
+#include "Texture.hpp"
 #include "Vec3.hpp"
 
+/**
+ * The materials MaterialDispatch knows, all final, so a tag always names the
+ * exact class. Materials defined elsewhere are Other and dispatched through
+ * their virtual functions.
+*/
+enum class MaterialType : uint8_t
+{
+    Lambertian,
+    TexturedLambertian,
+    Metal,
+    Dielectric,
+    Translucent,
+    Emissive,
+    Mixed,
+    Marble,
+    Ripples,
+    Other
+};
+
 class Material
 {
 public:
+    const MaterialType type;
     bool emissive = false;
 
+    explicit Material(MaterialType type = MaterialType::Other) : type(type) {}
     virtual ~Material() {}
 
     // default. overridden for emissive materials
@@ -24,6 +48,24 @@ public:
 
     virtual bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const = 0;
 
+    // the material that handles a hit: mixtures pick one of their parts, drawing the same number scatter would
+    virtual const Material *resolve() const
+    {
+        return this;
+    }
+
+    // ideal diffuse materials return their albedo at the hit, i.e. pi times the BRDF, so lights can be sampled for them
+    virtual bool diffuseAlbedo(const HitRecord &rec, Vec3 &albedo) const
+    {
+        return false;
+    }
+
+    // surface color without lighting, for the albedo AOV; never draws random numbers
+    virtual Vec3 baseColor(const HitRecord &rec) const
+    {
+        return Vec3(1, 1, 1);
+    }
+
     static Vec3 reflect(const Vec3 &v, const Vec3 &n)
     {
         return v - 2 * v.dot(n) * n;
@@ -45,7 +87,7 @@ public:
     }
 };
 
-class Dielectric : public Material
+class Dielectric final : public Material
 {
 public:
     double ref_idx; // index of refraction
@@ -58,7 +100,7 @@ public:
         diamond: 2.42
     */
 
-    explicit Dielectric(double ri) : ref_idx(ri) {}
+    explicit Dielectric(double ri) : Material(MaterialType::Dielectric), ref_idx(ri) {}
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -90,13 +132,20 @@ public:
     }
 };
 
-class Translucent : public Dielectric
+// a tinted Dielectric
+class Translucent final : public Material
 {
 public:
+    double ref_idx; // index of refraction
     Vec3 tint;
 
     Translucent(double ri, const Vec3 &color)
-        : Dielectric(ri), tint(color) {}
+        : Material(MaterialType::Translucent), ref_idx(ri), tint(color) {}
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return tint;
+    }
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -120,12 +169,12 @@ public:
     }
 };
 
-class Emissive : public Material
+class Emissive final : public Material
 {
 public:
     Vec3 emit;
 
-    explicit Emissive(const Vec3 &color) : Material(), emit(color) { emissive = true; }
+    explicit Emissive(const Vec3 &color) : Material(MaterialType::Emissive), emit(color) { emissive = true; }
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -138,12 +187,12 @@ public:
     }
 };
 
-class Lambertian : public Material
+class Lambertian final : public Material
 {
 public:
     Vec3 albedo;
 
-    explicit Lambertian(const Vec3 &a) : albedo(a) {}
+    explicit Lambertian(const Vec3 &a) : Material(MaterialType::Lambertian), albedo(a) {}
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -152,15 +201,127 @@ public:
         attenuation = albedo;
         return true;
     }
+
+    bool diffuseAlbedo(const HitRecord &rec, Vec3 &albedo) const override
+    {
+        albedo = this->albedo;
+        return true;
+    }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return albedo;
+    }
+};
+
+// Lambertian whose albedo is an image texture times a tint, filtered over the pixel's footprint
+class TexturedLambertian final : public Material
+{
+public:
+    std::shared_ptr<const Texture> texture;
+    Vec3 tint;
+
+    TexturedLambertian(std::shared_ptr<const Texture> texture, const Vec3 &tint = Vec3(1, 1, 1))
+        : Material(MaterialType::TexturedLambertian), texture(std::move(texture)), tint(tint) {}
+
+    Vec3 albedoAt(const HitRecord &rec) const
+    {
+        return tint * texture->sample(rec.u, rec.v, rec.footprint * rec.uvScale);
+    }
+
+    bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
+    {
+        Vec3 scatter_direction = rec.normal + util.randomUnitSphere();
+        scattered = Ray(rec.point, scatter_direction);
+        attenuation = albedoAt(rec);
+        return true;
+    }
+
+    bool diffuseAlbedo(const HitRecord &rec, Vec3 &albedo) const override
+    {
+        albedo = albedoAt(rec);
+        return true;
+    }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return albedoAt(rec);
+    }
+};
+
+// Lambertian with a marble albedo, evaluated at the hit or looked up in a bake of it (see bakeMarble)
+class Marble final : public Material
+{
+public:
+    MarblePattern pattern;
+    std::shared_ptr<const Texture> baked; // the pattern over mapping, or null
+    PlanarMapping mapping;
+
+    explicit Marble(const MarblePattern &pattern) : Material(MaterialType::Marble), pattern(pattern) {}
+
+    Marble(const MarblePattern &pattern, std::shared_ptr<const Texture> baked, const PlanarMapping &mapping)
+        : Material(MaterialType::Marble), pattern(pattern), baked(std::move(baked)), mapping(mapping) {}
+
+    Vec3 albedoAt(const HitRecord &rec) const
+    {
+        if (!baked)
+            return pattern.at(rec.point);
+        double u, v;
+        mapping.uv(rec.point, u, v);
+        return baked->sample(u, v, rec.footprint * mapping.uvScale());
+    }
+
+    bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
+    {
+        Vec3 scatter_direction = rec.normal + util.randomUnitSphere();
+        scattered = Ray(rec.point, scatter_direction);
+        attenuation = albedoAt(rec);
+        return true;
+    }
+
+    bool diffuseAlbedo(const HitRecord &rec, Vec3 &albedo) const override
+    {
+        albedo = albedoAt(rec);
+        return true;
+    }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return albedoAt(rec);
+    }
+};
+
+// water whose surface is bent by waves frozen at the given time; reflects and refracts like a Translucent
+class Ripples final : public Material
+{
+public:
+    RipplePattern waves;
+    double time;
+    Translucent water;
+
+    Ripples(const RipplePattern &waves, double time, double ri, const Vec3 &tint)
+        : Material(MaterialType::Ripples), waves(waves), time(time), water(ri, tint) {}
+
+    bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
+    {
+        HitRecord bent = rec;
+        bent.normal = waves.bend(rec.normal, rec.point, time);
+        return water.Translucent::scatter(r_in, bent, attenuation, scattered);
+    }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return water.tint;
+    }
 };
 
-class Metal : public Material
+class Metal final : public Material
 {
 public:
     Vec3 albedo;
     double fuzz;
 
-    Metal(const Vec3 &a, double f) : albedo(a), fuzz(std::min(f, 1.0)) {}
+    Metal(const Vec3 &a, double f) : Material(MaterialType::Metal), albedo(a), fuzz(std::min(f, 1.0)) {}
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -169,16 +330,22 @@ public:
         attenuation = albedo;
         return scattered.direction.dot(rec.normal) > 0;
     }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return albedo;
+    }
 };
 
-class MixedMaterial : public Material
+class MixedMaterial final : public Material
 {
 public:
     std::shared_ptr<Material> mat1;
     std::shared_ptr<Material> mat2;
     double blend; // range: [0 (full mat1), 1 (full mat2)]
 
-    MixedMaterial(std::shared_ptr<Material> m1, std::shared_ptr<Material> m2, double factor) : mat1(m1), mat2(m2), blend(factor) {}
+    MixedMaterial(std::shared_ptr<Material> m1, std::shared_ptr<Material> m2, double factor)
+        : Material(MaterialType::Mixed), mat1(m1), mat2(m2), blend(factor) {}
 
     bool scatter(const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered) const override
     {
@@ -196,6 +363,133 @@ public:
     {
         return (1.0 - blend) * mat1->emitted(point) + blend * mat2->emitted(point);
     }
+
+    const Material *resolve() const override
+    {
+        return (util.randomDouble() < blend ? mat2 : mat1)->resolve();
+    }
+
+    Vec3 baseColor(const HitRecord &rec) const override
+    {
+        return (1.0 - blend) * mat1->baseColor(rec) + blend * mat2->baseColor(rec);
+    }
 };
 
-#endif
\ No newline at end of file
+/**
+ * Material evaluation by a switch over Material::type instead of virtual
+ * calls. Each case calls the exact class's function by its qualified name, so
+ * it can be inlined, and mixtures resolve their parts the same way. Results,
+ * including the random numbers drawn, are those of the virtual functions;
+ * Other materials fall back to them.
+*/
+namespace MaterialDispatch
+{
+    inline bool scatter(const Material *material, const Ray &r_in, const HitRecord &rec, Vec3 &attenuation, Ray &scattered)
+    {
+        switch (material->type)
+        {
+        case MaterialType::Lambertian:
+            return static_cast<const Lambertian *>(material)->Lambertian::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::TexturedLambertian:
+            return static_cast<const TexturedLambertian *>(material)->TexturedLambertian::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Metal:
+            return static_cast<const Metal *>(material)->Metal::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Dielectric:
+            return static_cast<const Dielectric *>(material)->Dielectric::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Translucent:
+            return static_cast<const Translucent *>(material)->Translucent::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Emissive:
+            return false;
+        case MaterialType::Marble:
+            return static_cast<const Marble *>(material)->Marble::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Ripples:
+            return static_cast<const Ripples *>(material)->Ripples::scatter(r_in, rec, attenuation, scattered);
+        case MaterialType::Mixed:
+        {
+            const MixedMaterial *mixed = static_cast<const MixedMaterial *>(material);
+            const Material *part = util.randomDouble() < mixed->blend ? mixed->mat2.get() : mixed->mat1.get();
+            return scatter(part, r_in, rec, attenuation, scattered);
+        }
+        default:
+            return material->scatter(r_in, rec, attenuation, scattered);
+        }
+    }
+
+    inline Vec3 emitted(const Material *material, const Vec3 &point)
+    {
+        switch (material->type)
+        {
+        case MaterialType::Emissive:
+            return static_cast<const Emissive *>(material)->emit;
+        case MaterialType::Mixed:
+        {
+            const MixedMaterial *mixed = static_cast<const MixedMaterial *>(material);
+            return (1.0 - mixed->blend) * emitted(mixed->mat1.get(), point) + mixed->blend * emitted(mixed->mat2.get(), point);
+        }
+        case MaterialType::Other:
+            return material->emitted(point);
+        default:
+            return Vec3(0, 0, 0);
+        }
+    }
+
+    inline const Material *resolve(const Material *material)
+    {
+        while (material->type == MaterialType::Mixed)
+        {
+            const MixedMaterial *mixed = static_cast<const MixedMaterial *>(material);
+            material = util.randomDouble() < mixed->blend ? mixed->mat2.get() : mixed->mat1.get();
+        }
+        return material->type == MaterialType::Other ? material->resolve() : material;
+    }
+
+    inline bool diffuseAlbedo(const Material *material, const HitRecord &rec, Vec3 &albedo)
+    {
+        switch (material->type)
+        {
+        case MaterialType::Lambertian:
+            albedo = static_cast<const Lambertian *>(material)->albedo;
+            return true;
+        case MaterialType::TexturedLambertian:
+            albedo = static_cast<const TexturedLambertian *>(material)->albedoAt(rec);
+            return true;
+        case MaterialType::Marble:
+            albedo = static_cast<const Marble *>(material)->albedoAt(rec);
+            return true;
+        case MaterialType::Other:
+            return material->diffuseAlbedo(rec, albedo);
+        default:
+            return false;
+        }
+    }
+
+    inline Vec3 baseColor(const Material *material, const HitRecord &rec)
+    {
+        switch (material->type)
+        {
+        case MaterialType::Lambertian:
+            return static_cast<const Lambertian *>(material)->albedo;
+        case MaterialType::TexturedLambertian:
+            return static_cast<const TexturedLambertian *>(material)->albedoAt(rec);
+        case MaterialType::Metal:
+            return static_cast<const Metal *>(material)->albedo;
+        case MaterialType::Translucent:
+            return static_cast<const Translucent *>(material)->tint;
+        case MaterialType::Marble:
+            return static_cast<const Marble *>(material)->albedoAt(rec);
+        case MaterialType::Ripples:
+            return static_cast<const Ripples *>(material)->water.tint;
+        case MaterialType::Mixed:
+        {
+            const MixedMaterial *mixed = static_cast<const MixedMaterial *>(material);
+            return (1.0 - mixed->blend) * baseColor(mixed->mat1.get(), rec) + mixed->blend * baseColor(mixed->mat2.get(), rec);
+        }
+        case MaterialType::Other:
+            return material->baseColor(rec);
+        default:
+            return Vec3(1, 1, 1);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Hittable.hpp"
+#include "Object.hpp"
+#include "WideBVH.hpp"
+
+/**
+ * A mesh ready to render: flat vertex and index buffers, with the triangles in
+ * the leaf order of the BVH built over them.
+*/
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices; // 3 per triangle, in bvh leaf order
+    WideBVH bvh;
+    std::string diffuseMap;      // map_Kd of the mesh's .mtl file, empty if none
+    std::string materialLibrary; // the .mtl file diffuseMap comes from, empty if the source names none
+
+    // builds the BVH over the triangles of a parsed file
+    static MeshData build(const Object &object);
+
+    // the triangles and BVH a CompoundShape renders, all with the given material; textured meshes keep their uvs
+    std::shared_ptr<TriangleMesh> toTriangleMesh(const Material *material, bool textured = false) const;
+};
+
+/**
+ * Binary cache of MeshData, so a mesh is parsed and its BVH built once rather
+ * than on every start. One file per source mesh, in native byte order:
+ *
+ *   Header
+ *   Vertex vertices[numVertices]
+ *   uint32_t indices[numIndices]
+ *   WideBVHNode nodes[numNodes]
+ *   char diffuseMap[diffuseMapLength] (relative to the source's directory)
+ *   char materialLibrary[materialLibraryLength] (likewise)
+ *
+ * with every section 64-byte aligned, so a mapped cache is copied out without
+ * any parsing. The header holds the format VERSION and the layout of this
+ * build (struct sizes, BVH_WIDTH, TRIANGLE_LANES), which must all match, and
+ * the size, modification time and hash of the source and of its material
+ * library. A cache whose files have the recorded size and time is used as is;
+ * if only a time differs, the contents are hashed and a match rewrites the
+ * cache with the new time.
+*/
+namespace MeshCache
+{
+    const uint32_t VERSION = 3;
+
+    // NAME.obj.meshcache in cacheDir, or next to the source if cacheDir is empty
+    std::string pathFor(const std::string &sourcePath, const std::string &cacheDir);
+
+    // false if the cache is missing, stale, damaged or written by an incompatible build
+    bool load(const std::string &sourcePath, const std::string &cachePath, MeshData &mesh);
+
+    /**
+     * Writes a temporary file and renames it over cachePath, so readers (other
+     * processes included) never see a partial cache. Creates cacheDir if
+     * needed. Returns false on I/O errors, including a material library the
+     * source names but that cannot be read.
+    */
+    bool save(const std::string &sourcePath, const std::string &cachePath, const MeshData &mesh);
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "BVH.hpp"
+
+/**
+ * Per-thread counters. Each thread increments only its own cache line with
+ * relaxed loads/stores; the shards are summed once per frame.
+*/
+struct alignas(64) MetricsShard
+{
+    std::atomic<uint64_t> rays{0};
+    std::atomic<uint64_t> bvIntersections{0};
+    std::atomic<uint64_t> objectIntersections{0};
+    std::atomic<uint64_t> pathSegments{0};
+};
+
+struct MetricsTotals
+{
+    uint64_t rays = 0;
+    uint64_t bvIntersections = 0;
+    uint64_t objectIntersections = 0;
+    uint64_t pathSegments = 0;
+};
+
+namespace Metrics
+{
+    // the calling thread's shard, registered on first use and never freed
+    MetricsShard &localShard();
+
+    MetricsTotals collect();
+    // only call while no thread is counting, i.e. between frames
+    void reset();
+
+    inline void increment(std::atomic<uint64_t> &counter, uint64_t amount = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    inline void countRay() { increment(localShard().rays); }
+    inline void countBVIntersection() { increment(localShard().bvIntersections); }
+    inline void countObjectIntersection() { increment(localShard().objectIntersections); }
+    inline void countPathSegments(uint64_t segments) { increment(localShard().pathSegments, segments); }
+}
+
+/* Wall-clock timer */
+class Stopwatch
+{
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void restart() { start = std::chrono::steady_clock::now(); }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+/* Per-frame timings (wall-clock seconds) and counters */
+struct FrameReport
+{
+    int frame = 0;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int samplesPerPixel = 0;    // --spp, the cap when sampling adaptively
+    int maxSamplesPerPixel = 0; // the most samples any pixel took
+    size_t numThreads = 0;
+
+    double loadTime = 0;   // scene loading, attributed to the frame during which it happened
+    double buildTime = 0;  // scene update and acceleration structure build
+    double renderTime = 0;
+    double writeTime = 0;
+
+    int passes = 1;    // progressive passes
+    int batchFrames = 1; // frames rendered concurrently with this one; render time and counters cover all of them
+    double noise = 0;  // progressive image noise estimate, 0 if not measured
+
+    MetricsTotals counters;
+    BVHStats bvhStats;
+
+    double totalTime() const { return loadTime + buildTime + renderTime + writeTime; }
+    double megaRaysPerSecond() const { return renderTime > 0 ? counters.rays / renderTime / 1e6 : 0.0; }
+    double averagePathLength() const { return counters.rays > 0 ? (double)counters.pathSegments / counters.rays : 0.0; }
+    // below samplesPerPixel when sampling adaptively
+    double averageSamplesPerPixel() const
+    {
+        return imageWidth > 0 && imageHeight > 0 ? (double)counters.rays / ((double)imageWidth * imageHeight * batchFrames) : 0.0;
+    }
+
+    // human readable metrics on stdout
+    void print() const;
+};
+
+/**
+ * Appends one machine-readable record per frame: JSON Lines or CSV with a header.
+*/
+class ReportWriter
+{
+public:
+    enum class Format
+    {
+        None,
+        Json,
+        Csv
+    };
+
+    static Format parseFormat(const std::string &name);
+
+    ReportWriter(Format format, const std::string &path);
+
+    void write(const FrameReport &report);
+
+private:
+    Format format;
+    std::ofstream file;
+};
+
+#endif
@@ -1,7 +1,6 @@
 #ifndef OBJECT_HPP
 #define OBJECT_HPP
 
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -23,33 +22,46 @@ struct Vertex {
         nx(_nx), ny(_ny), nz(_nz) { }
 
     // Determing equality of vertices based on all fields
-    bool operator== (const Vertex &rhs) {
+    bool operator== (const Vertex &rhs) const {
         return
             (x == rhs.x) && 
             (y == rhs.y) && 
+            (z == rhs.z) && 
+            (s == rhs.s) && 
+            (t == rhs.t) &&
             (nx == rhs.nx) && 
             (ny == rhs.ny) && 
             (nz == rhs.nz);
-
-            /* Textures are out of scope for this assignment
-            (z == rhs.z) && 
-            (s == rhs.s) && 
-            (t == rhs.t);
-            */
     }
 };
 
+/**
+ * Triangle mesh read from a Wavefront .obj file.
+ *
+ * The file is memory-mapped and split at line boundaries into chunks that are
+ * parsed in parallel with std::from_chars. Polygons are triangulated as fans.
+ * Every distinct (position, texture coordinate, normal) index triple of a face
+ * corner becomes one vertex, found through a hash table, so vertices and
+ * indices come out as flat buffers in the order the corners appear in the file,
+ * whatever the number of threads.
+*/
 struct Object {
     std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices; // faces
+    std::vector<unsigned int> indices; // 3 per triangle
     std::string mtlFilePath; // path to material file
     std::string mapKdPPMFilePath; // path to diffuse color map file
 
-    // Constructor
-    Object(std::string filename);
+    /**
+     * Constructor
+     * Parses the file on numThreads threads (0: one per hardware thread).
+     * Throws std::runtime_error if the file cannot be read or is malformed.
+    */
+    Object(std::string filename, size_t numThreads = 0);
     // Destructor
     ~Object();
 
+    size_t numTriangles() const { return indices.size() / 3; }
+
     /**
      * Converts vector of Vertex to vector of float vertex positions.
      * Facilitates conversion of Vertex struct to GUfloat.
@@ -68,40 +80,12 @@ struct Object {
     */
     void parseMtl(std::string dir, std::string mtlFileName);
 
-    /**
-     * Searches for matching vertex in existing vector to determine whether to add
-     * the given vertex or use an existing one.
-    */
-   void storeOrSkip(Vertex vToAdd);
-
     /**
      * Saves Object data to file.
      * For testing purposes only.
     */
     void saveObj(std::string outputFileName);
 
-    /**
-     * Returns list of triangles (sets of 3 vertices).
-    */
-    std::vector<std::vector<Vertex>> getFaces() const;
-
-    /**
-     * Tokenizes given string using given delimiter.
-    */
-    inline std::vector<std::string> split(const std::string& str, const std::string& delimiter) {
-        std::vector<std::string> tokens;
-        std::stringstream stream(str);
-        std::string value;
-
-        while (std::getline(stream, value, delimiter[0])) {
-            if (!value.empty()){
-                tokens.push_back(value);
-            }
-        }
-
-        return tokens;
-    }
-
     inline std::string getDirectory(std::string filepath) {
         std::string dir = "";
         size_t lastSlashPos = filepath.find_last_of("/");
@@ -113,4 +97,4 @@ struct Object {
     }
 };
 
-#endif
\ No newline at end of file
+#endif
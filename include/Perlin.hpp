@@ -1,96 +1,53 @@
 #ifndef PERLIN_HPP
 #define PERLIN_HPP
 
-#include <algorithm>
-#include <random>
-#include <vector>
+#include <cstdint>
 
 #include "Vec3.hpp"
 
+/**
+ * Gradient noise over a lattice of 256 random unit gradients, picked per
+ * lattice point by three permutation tables (one per axis), all drawn from a
+ * seed so every run produces the same noise. Values lie roughly in [-1, 1].
+ *
+ * The batch versions evaluate LANES points per call, given as one array per
+ * coordinate. Like the RayPacket kernels they run fixed-trip loops over all
+ * lanes, so the compiler maps the arithmetic onto vector instructions; only
+ * the table lookups stay scalar. They return the same values as the point
+ * versions.
+*/
 class Perlin
 {
 public:
-    Perlin()
-    {
-        ranvec.reserve(256);
-        for (int i = 0; i < 256; ++i)
-        {
-            ranvec.push_back(Vec3::random(-1, 1).normalize());
-        }
-        p = perlinGeneratePerm();
-    }
+    static const int LANES = 8;
 
-    double noise(const Vec3 &point) const
-    {
-        double u = point.x - floor(point.x);
-        double v = point.y - floor(point.y);
-        double w = point.z - floor(point.z);
+    explicit Perlin(uint64_t seed = 0);
 
-        int i = floor(point.x);
-        int j = floor(point.y);
-        int k = floor(point.z);
+    uint64_t seed() const { return noiseSeed; }
 
-        Vec3 c[2][2][2];
+    double noise(const Vec3 &point) const;
+    void noise(const double *x, const double *y, const double *z, double *out) const;
 
-        for (int di = 0; di < 2; di++)
-            for (int dj = 0; dj < 2; dj++)
-                for (int dk = 0; dk < 2; dk++)
-                    c[di][dj][dk] = ranvec[p[(i + di) & 255] ^ p[(j + dj) & 255] ^ p[(k + dk) & 255]];
+    // fractal Brownian motion: octaves of noise, each at twice the frequency and half the amplitude of the last
+    double fbm(const Vec3 &point, int octaves) const;
+    void fbm(const double *x, const double *y, const double *z, int octaves, double *out) const;
 
-        return perlinInterp(c, u, v, w);
-    }
+    // fbm of the absolute noise, for creases and veins
+    double turbulence(const Vec3 &point, int octaves) const;
+    void turbulence(const double *x, const double *y, const double *z, int octaves, double *out) const;
 
 private:
-    std::vector<int> p;
-    std::vector<Vec3> ranvec;
+    static const int SIZE = 256;
 
-    static std::vector<int> perlinGeneratePerm()
-    {
-        std::vector<int> p(256);
-        for (int i = 0; i < 256; ++i)
-        {
-            p[i] = i;
-        }
+    uint64_t noiseSeed;
+    alignas(64) double gradientX[SIZE], gradientY[SIZE], gradientZ[SIZE];
+    uint8_t permX[SIZE], permY[SIZE], permZ[SIZE];
 
-        permute(p, 256);
-        return p;
-    }
-
-    static void permute(std::vector<int> &p, int n)
-    {
-        std::random_device rd;
-        std::mt19937 g(rd());
-
-        for (int i = n - 1; i > 0; i--)
-        {
-            int target = int(g() % (i + 1));
-            int tmp = p[i];
-            p[i] = p[target];
-            p[target] = tmp;
-        }
-    }
-
-    double perlinInterp(Vec3 c[2][2][2], double u, double v, double w) const
-    {
-        double uu = u * u * (3 - 2 * u);
-        double vv = v * v * (3 - 2 * v);
-        double ww = w * w * (3 - 2 * w);
-
-        double accum = 0;
-        for (int i = 0; i < 2; i++)
-            for (int j = 0; j < 2; j++)
-                for (int k = 0; k < 2; k++)
-                {
-                    Vec3 weight(u - i, v - j, w - k);
-                    accum += (i * uu + (1 - i) * (1 - uu)) * (j * vv + (1 - j) * (1 - vv)) * (k * ww + (1 - k) * (1 - ww)) * dot(c[i][j][k], weight);
-                }
-        return accum;
-    }
-
-    double dot(const Vec3 &v1, const Vec3 &v2) const
-    {
-        return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
-    }
+    // the kernels behind both versions, over N lanes
+    template <int N>
+    void noiseLanes(const double *x, const double *y, const double *z, double *out) const;
+    template <int N, bool ABSOLUTE>
+    void octaveLanes(const double *x, const double *y, const double *z, int octaves, double *out) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,74 @@
+#ifndef PROCEDURAL_HPP
+#define PROCEDURAL_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Perlin.hpp"
+#include "Texture.hpp"
+#include "Vec3.hpp"
+
+// marble: bands across axis, bent by turbulence into veins
+struct MarblePattern
+{
+    std::shared_ptr<const Perlin> noise;
+    Vec3 light = Vec3(0.93, 0.92, 0.88); // linear colors
+    Vec3 dark = Vec3(0.32, 0.3, 0.34);
+    Vec3 axis = Vec3(0.8, 0.6, 0); // unit length
+    double bandScale = 0.5;  // radians of the bands' sine per world unit along axis
+    double noiseScale = 0.25; // noise cells per world unit
+    double distortion = 6.0; // radians the turbulence moves the bands by
+    int octaves = 6;
+
+    Vec3 at(const Vec3 &point) const;
+    // Perlin::LANES points
+    void at(const double *x, const double *y, const double *z, Vec3 *out) const;
+    // of the parameters and the noise seed, e.g. to name baked textures
+    uint64_t key() const;
+};
+
+/**
+ * Animated waves: a height field of fBm over x and z that drifts through the
+ * noise's third dimension with time. For horizontal surfaces.
+*/
+struct RipplePattern
+{
+    std::shared_ptr<const Perlin> noise;
+    double scale = 2.0;      // noise cells per world unit
+    double amplitude = 0.04; // height of the waves, in world units
+    double speed = 0.6;      // noise cells per unit of time
+    int octaves = 4;
+
+    // the surface normal bent by the slope of the waves at point; normal must point up or down
+    Vec3 bend(const Vec3 &normal, const Vec3 &point, double time) const;
+};
+
+// a rectangle origin + u edgeU + v edgeV, u and v in [0, 1], for baking onto flat surfaces
+struct PlanarMapping
+{
+    Vec3 origin;
+    Vec3 edgeU, edgeV; // perpendicular
+
+    void uv(const Vec3 &point, double &u, double &v) const;
+    Vec3 point(double u, double v) const { return origin + u * edgeU + v * edgeV; }
+    // uv units per world unit, the coarser of the two axes
+    double uvScale() const;
+};
+
+/**
+ * Bakes pattern over mapping into a resolution x resolution texture, so static
+ * surfaces look the pattern up, filtered over their footprint, instead of
+ * evaluating the noise at every hit. The texels are evaluated LANES at a time
+ * and written as marble-KEY-RESOLUTION.ppm, KEY covering the pattern and the
+ * mapping, in cacheDir, where later runs with the same pattern and mapping
+ * find them; the texture cache file goes next to it. If cacheDir is empty the
+ * image goes to raytracer-bake-USER in the system's temporary directory,
+ * created readable by its owner only. Throws std::runtime_error if the image
+ * can be neither written nor loaded, or if that directory is not the user's
+ * own.
+*/
+std::shared_ptr<Texture> bakeMarble(const MarblePattern &pattern, const PlanarMapping &mapping, int resolution,
+                                    const std::string &cacheDir, std::shared_ptr<TextureCache> cache);
+
+#endif
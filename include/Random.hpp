@@ -0,0 +1,107 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+ * Numbers: As Easy as 1, 2, 3"). Maps a 128-bit counter and a 64-bit key to
+ * four random 32-bit words without any state, so any thread can draw the
+ * numbers for any (frame, pixel, sample, bounce) in any order.
+*/
+namespace Philox
+{
+    struct Key
+    {
+        uint32_t k0, k1;
+    };
+
+    const uint32_t M0 = 0xD2511F53;
+    const uint32_t M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9;
+    const uint32_t W1 = 0xBB67AE85;
+    const int ROUNDS = 10;
+
+    inline void generate(const uint32_t counter[4], Key key, uint32_t out[4])
+    {
+        uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+        uint32_t k0 = key.k0, k1 = key.k1;
+
+        for (int round = 0; round < ROUNDS; ++round)
+        {
+            uint64_t p0 = (uint64_t)M0 * c0;
+            uint64_t p1 = (uint64_t)M1 * c2;
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            c1 = (uint32_t)p1;
+            c3 = (uint32_t)p0;
+            c0 = n0;
+            c2 = n2;
+            k0 += W0;
+            k1 += W1;
+        }
+
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    /**
+     * Batch path: generates the blocks for counters
+     * (c0, c1Begin + i, c2, c3) for i in [0, count). Lanes are independent and
+     * processed in groups of BATCH_WIDTH so the rounds vectorize.
+     * Word w of block i is written to out[w * count + i].
+    */
+    const size_t BATCH_WIDTH = 8;
+    void generateBatch(Key key, uint32_t c0, uint32_t c1Begin, uint32_t c2, uint32_t c3, size_t count, uint32_t *out);
+
+    // maps 32 random bits to [0, 1)
+    inline double toUnitDouble(uint32_t bits)
+    {
+        return bits * (1.0 / 4294967296.0);
+    }
+}
+
+/**
+ * Sequential view over the blocks of one (key, c0, c1, c2) counter prefix.
+ * The last counter word indexes the block, so a stream yields 2^32 * 4 words.
+*/
+class RandomStream
+{
+public:
+    void reset(Philox::Key key, uint32_t c0, uint32_t c1, uint32_t c2)
+    {
+        this->key = key;
+        counter[0] = c0;
+        counter[1] = c1;
+        counter[2] = c2;
+        counter[3] = 0;
+        available = 0;
+    }
+
+    uint32_t nextUint()
+    {
+        if (available == 0)
+        {
+            Philox::generate(counter, key, buffer);
+            counter[3]++;
+            available = 4;
+        }
+        return buffer[4 - available--];
+    }
+
+    double nextDouble()
+    {
+        return Philox::toUnitDouble(nextUint());
+    }
+
+private:
+    Philox::Key key = {0, 0};
+    uint32_t counter[4] = {0, 0, 0, 0};
+    uint32_t buffer[4];
+    int available = 0;
+};
+
+#endif
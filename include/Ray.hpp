@@ -7,6 +7,7 @@ class Ray
 {
 public:
     Vec3 origin, direction;
+    Vec3 invDirection; // 1 / direction per axis, for slab tests; set by the constructors
     double time;
 
     Ray();
@@ -15,10 +16,10 @@ public:
     Vec3 at(double t) const;
 };
 
-inline Ray::Ray() : origin(Vec3()), direction(Vec3()), time(0.0) {}
+inline Ray::Ray() : origin(Vec3()), direction(Vec3()), invDirection(direction.reciprocal()), time(0.0) {}
 
 inline Ray::Ray(const Vec3 &origin, const Vec3 &direction, double time) 
-    : origin(origin), direction(direction), time(time) {}
+    : origin(origin), direction(direction), invDirection(direction.reciprocal()), time(time) {}
 
 inline Vec3 Ray::at(double t) const 
 {
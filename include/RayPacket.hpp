@@ -0,0 +1,92 @@
+#ifndef RAYPACKET_HPP
+#define RAYPACKET_HPP
+
+#include <cstdint>
+#include <limits>
+
+#include "Ray.hpp"
+
+// rays per packet; 4, 8 or 16 map onto SSE, AVX2 and AVX-512 registers of doubles
+#ifndef PACKET_SIZE
+#define PACKET_SIZE 8
+#endif
+
+static_assert(PACKET_SIZE == 4 || PACKET_SIZE == 8 || PACKET_SIZE == 16, "PACKET_SIZE must be 4, 8 or 16");
+
+/**
+ * Structure-of-arrays bundle of coherent rays, e.g. primary rays of
+ * neighbouring pixels. Kernels run over all lanes with fixed trip counts and
+ * no early exits so the compiler can map each loop onto vector instructions;
+ * activeMask selects the lanes that hold a ray.
+*/
+struct RayPacket
+{
+    static const int SIZE = PACKET_SIZE;
+    // pixel footprint of a packet of primary rays
+    static const int WIDTH = SIZE == 4 ? 2 : 4;
+    static const int HEIGHT = SIZE / WIDTH;
+
+    alignas(64) double ox[SIZE], oy[SIZE], oz[SIZE];
+    alignas(64) double dx[SIZE], dy[SIZE], dz[SIZE];
+    alignas(64) double invDx[SIZE], invDy[SIZE], invDz[SIZE];
+    alignas(64) double time[SIZE];
+    alignas(64) double tMax[SIZE]; // closest hit so far
+    int hitObject[SIZE];           // index of the closest object hit so far, -1 if none
+    uint32_t activeMask = 0;
+
+    void clear()
+    {
+        activeMask = 0;
+        for (int lane = 0; lane < SIZE; ++lane)
+        {
+            ox[lane] = oy[lane] = oz[lane] = 0;
+            dx[lane] = dy[lane] = dz[lane] = 1;
+            invDx[lane] = invDy[lane] = invDz[lane] = 1;
+            time[lane] = 0;
+            tMax[lane] = std::numeric_limits<double>::infinity();
+            hitObject[lane] = -1;
+        }
+    }
+
+    void setRay(int lane, const Ray &ray, double tMaxLane)
+    {
+        ox[lane] = ray.origin.x;
+        oy[lane] = ray.origin.y;
+        oz[lane] = ray.origin.z;
+        dx[lane] = ray.direction.x;
+        dy[lane] = ray.direction.y;
+        dz[lane] = ray.direction.z;
+        invDx[lane] = ray.invDirection.x;
+        invDy[lane] = ray.invDirection.y;
+        invDz[lane] = ray.invDirection.z;
+        time[lane] = ray.time;
+        tMax[lane] = tMaxLane;
+        hitObject[lane] = -1;
+        activeMask |= 1u << lane;
+    }
+
+    Ray ray(int lane) const
+    {
+        return Ray(Vec3(ox[lane], oy[lane], oz[lane]), Vec3(dx[lane], dy[lane], dz[lane]), time[lane]);
+    }
+
+    // records a closer hit on the lanes in hitMask; tHit holds one distance per lane
+    void recordHits(uint32_t hitMask, const double *tHit, int object)
+    {
+        for (int lane = 0; lane < SIZE; ++lane)
+        {
+            if (hitMask & (1u << lane))
+            {
+                tMax[lane] = tHit[lane];
+                hitObject[lane] = object;
+            }
+        }
+    }
+};
+
+inline int popcount(uint32_t mask)
+{
+    return __builtin_popcount(mask);
+}
+
+#endif
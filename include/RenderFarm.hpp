@@ -0,0 +1,108 @@
+#ifndef RENDERFARM_HPP
+#define RENDERFARM_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Metrics.hpp"
+#include "Renderer.hpp"
+#include "RenderSettings.hpp"
+#include "Vec3.hpp"
+#include "World.hpp"
+
+/**
+ * Local render farm. The coordinator forks worker processes and hands out
+ * (frame, tile) jobs to them over Unix domain sockets, assembling every frame
+ * as its tiles come back. Workers are forked after the scene snapshots of all
+ * frames exist, so they share the coordinator's memory copy-on-write and never
+ * load or build anything themselves.
+ *
+ * A worker that dies (crash, kill) is replaced, and the jobs it had not
+ * finished go back to the front of the queue. Only the job it was rendering,
+ * the oldest one it had been sent, is blamed; a job that has taken down
+ * MAX_ATTEMPTS workers is considered broken and stops the farm.
+ *
+ * Random numbers are keyed on (frame, pixel, sample, bounce), so the frames are
+ * the same as when rendered in one process. POSIX only.
+*/
+class RenderFarm
+{
+public:
+    // pixels: the whole frame, top row first; may be swapped out
+    using FrameCallback = std::function<void(int frame, std::vector<Vec3> &pixels, const MetricsTotals &counters, uint32_t maxSamples, double renderTime)>;
+
+    static const int JOBS_PER_WORKER = 2; // queued on each worker, so it never waits for the coordinator
+    static const int MAX_ATTEMPTS = 3;
+
+    // frames[f] is the scene of frame f; settings.farmWorkers processes are started by run
+    RenderFarm(const RenderSettings &settings, const Camera &camera, std::vector<std::shared_ptr<const World>> frames);
+    ~RenderFarm();
+
+    RenderFarm(const RenderFarm &) = delete;
+    RenderFarm &operator=(const RenderFarm &) = delete;
+
+    /**
+     * Renders every frame, calling onFrame on the coordinator as soon as all
+     * tiles of a frame are in; frames complete roughly, not strictly, in order.
+     * Throws std::runtime_error if workers cannot be started or a job keeps
+     * crashing them.
+    */
+    void run(const FrameCallback &onFrame);
+
+    size_t crashedWorkers() const { return numCrashes; }
+
+private:
+    struct Job
+    {
+        int32_t frame; // -1 tells the worker to exit
+        int32_t tile;
+    };
+
+    struct ResultHeader
+    {
+        int32_t frame;
+        int32_t tile;
+        MetricsTotals counters;
+        uint32_t maxSamples; // the most samples a pixel of the tile took
+    };
+
+    struct Worker
+    {
+        int pid = -1;
+        int fd = -1;
+        std::deque<Job> assigned; // sent, result not yet received, oldest first
+    };
+
+    struct FrameState
+    {
+        std::vector<Vec3> pixels;
+        size_t tilesDone = 0;
+        MetricsTotals counters;
+        uint32_t maxSamples = 0;
+        Stopwatch timer; // from the first job handed out
+        bool started = false;
+    };
+
+    RenderSettings settings;
+    Camera camera;
+    std::vector<std::shared_ptr<const World>> frames;
+    Renderer renderer; // single-threaded; workers inherit it
+    std::vector<Worker> workers;
+    std::deque<Job> pending;
+    std::vector<int> attempts; // per job, frame-major
+    size_t numCrashes = 0;
+
+    void spawn(Worker &worker);
+    void stop(Worker &worker);
+    // requeues the worker's jobs and replaces it
+    void replace(Worker &worker);
+    bool receive(Worker &worker, std::vector<FrameState> &states, std::vector<double> &packed);
+
+    [[noreturn]] void workerMain(int fd);
+};
+
+#endif
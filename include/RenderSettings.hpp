@@ -0,0 +1,65 @@
+#ifndef RENDERSETTINGS_HPP
+#define RENDERSETTINGS_HPP
+
+#include <cstdint>
+#include <string>
+
+struct RenderSettings
+{
+    int numFrames = 2;
+    int imageWidth = 640;
+    int imageHeight = 480;
+    int samplesPerPixel = 100; // the cap per pixel when sampling adaptively
+    bool adaptive = false;     // stop sampling pixels once their noise estimate is low enough
+    int minSamples = 16;       // samples every pixel gets before the noise test
+    double noiseThreshold = 0.015; // standard error of a pixel's gamma-encoded luminance
+    bool sampleCountAov = false;  // also write frames/samples_N.pgm with the samples per pixel
+    bool writeAovs = false; // also write frames/albedo_N.pfm, normal_N.pfm and depth_N.pfm
+    bool denoise = false;   // filter every frame, guided by the AOVs, before it is written
+    double timeBudget = 0;  // progressive: seconds of rendering per frame, 0 for none
+    double noiseTarget = 0; // progressive: stop once the image noise estimate is this low, 0 for none
+    bool writePasses = false; // progressive: rewrite the frame file after every pass
+    int minDepth = 3;  // bounces before Russian roulette may end a path
+    int maxDepth = 50;
+    int numThreads = 0; // 0: one per hardware thread
+    int tileSize = 16;
+    bool packets = false; // trace primary rays in SIMD packets
+    bool wavefront = false; // trace the paths of a tile breadth-first, stage by stage
+    bool nextEventEstimation = false; // sample lights directly at diffuse hits, combined by MIS
+    double rebuildThreshold = 1.3; // rebuild the scene BVH once refitting has grown its SAH cost by this factor
+    int framesInFlight = 1; // frames rendered concurrently, each from its own scene snapshot
+    int farmWorkers = 0;    // render farm worker processes; 0 renders in this process
+    uint64_t seed = 0;
+    std::string sampler = "random"; // random, stratified, sobol or bluenoise
+    std::string imageFormat = "p6"; // p3, p6, ppm16 or pfm
+    bool streamTiles = false;       // write tiles straight to disk as they finish
+    std::string reportFormat = "none"; // none, json or csv
+    std::string reportFile;            // defaults to frames/report.jsonl or frames/report.csv
+    bool meshCache = true;    // load meshes from, and save them to, binary caches
+    std::string meshCacheDir; // where the mesh and texture caches live; empty: next to each source file
+    std::string texturedMesh; // .obj shown with its image texture, in front of the floating objects; empty for none
+    std::string texture;      // PPM for texturedMesh; empty: the map_Kd of its .mtl file
+    int textureCacheMb = 64;  // texture tiles held in memory, shared by all threads
+    bool procedural = false;  // rippling water and a marble backdrop, from noise seeded with seed
+    int bakeResolution = 0;   // texels per side of the baked marble; 0 evaluates the noise at every hit
+
+    /**
+     * Parses command line arguments:
+     *   project [number_of_frames] [--threads N] [--width W] [--height H] [--spp N] [--tile-size N]
+     *           [--min-depth N] [--max-depth N] [--packets] [--wavefront] [--nee] [--rebuild-threshold X] [--frames-in-flight N] [--workers N]
+     *           [--adaptive] [--min-spp N] [--noise-threshold X] [--sample-aov] [--aovs] [--denoise]
+     *           [--time-budget SECONDS] [--noise-target X] [--write-passes]
+     *           [--seed N] [--sampler random|stratified|sobol|bluenoise] [--report none|json|csv] [--report-file PATH]
+     *           [--format p3|p6|ppm16|pfm] [--stream-tiles] [--mesh-cache DIR] [--no-mesh-cache]
+     *           [--textured-mesh OBJ] [--texture PPM] [--texture-cache-mb N] [--procedural] [--bake-procedural N]
+     * Invalid values are reported and replaced by their defaults.
+    */
+    static RenderSettings fromArgs(int argc, char *argv[]);
+
+    // progressive passes replace the single pass when a budget or noise target is set
+    bool progressive() const { return timeBudget > 0 || noiseTarget > 0; }
+
+    bool collectAovs() const { return writeAovs || denoise; }
+};
+
+#endif
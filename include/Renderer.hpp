@@ -0,0 +1,137 @@
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Denoiser.hpp"
+#include "Integrator.hpp"
+#include "RenderSettings.hpp"
+#include "ThreadPool.hpp"
+#include "Vec3.hpp"
+#include "World.hpp"
+
+/* Multithreading Requirement */
+class Renderer
+{
+public:
+    struct Tile
+    {
+        int x0, y0; // top left pixel, y counted from the top row
+        int x1, y1; // exclusive
+    };
+
+    // pixels: the tile's averaged linear colors, row by row; called from render threads
+    using TileCallback = std::function<void(const Tile &tile, const Vec3 *pixels)>;
+
+    // called after every progressive pass with the total samples per pixel so far
+    using PassCallback = std::function<void(int pass, int samples, double noise)>;
+
+    // one frame of a renderFrames call
+    struct FrameJob
+    {
+        std::shared_ptr<const World> world; // the frame's scene snapshot
+        int frame = 0;
+        std::vector<Vec3> *framebuffer = nullptr; // set by the caller before rendering
+        std::vector<uint32_t> sampleCounts;       // filled with the samples taken per pixel
+        AovBuffers aovs;                          // filled if the settings ask for AOVs or denoising
+    };
+
+    explicit Renderer(const RenderSettings &settings);
+
+    /**
+     * Renders one frame into framebuffer: imageWidth * imageHeight averaged
+     * linear colors, top row first. Tiles are spread across the thread pool;
+     * random numbers are keyed on (frame, pixel, sample, bounce), so the image
+     * only depends on the seed. With settings.denoise the frame is denoised
+     * before this returns.
+    */
+    void render(const Camera &camera, const World &world, int frame, std::vector<Vec3> &framebuffer);
+
+    /**
+     * Renders one frame without a framebuffer, handing every finished tile to onTile.
+     * Tiles of one call may complete concurrently and in any order.
+    */
+    void renderTiles(const Camera &camera, const World &world, int frame, const TileCallback &onTile);
+
+    /**
+     * Renders one frame in passes of doubling sample counts into an
+     * accumulation buffer, resolving framebuffer after each pass so onPass can
+     * write the partial image. Stops at samplesPerPixel, once the time budget is
+     * spent (tiles not started by the deadline keep their previous samples) or
+     * once noise, the RMS of the per-pixel error estimates, is below the noise
+     * target. Returns the number of passes.
+    */
+    int renderProgressive(const Camera &camera, const World &world, int frame, std::vector<Vec3> &framebuffer,
+                          double &noise, const PassCallback &onPass = PassCallback());
+
+    /**
+     * Renders several frames at once. The tiles of all of them go to the pool
+     * as one batch, so workers done with one frame carry on with the next
+     * instead of waiting for its last tiles. Every frame reads only its own
+     * snapshot, and the images are the same as when rendered one by one.
+    */
+    void renderFrames(const Camera &camera, std::vector<FrameJob> &jobs);
+
+    /**
+     * Renders one tile of a frame on the calling thread, for callers that
+     * hand out tiles themselves: pixels receives the tile's colors row by row.
+    */
+    void renderSingleTile(const Camera &camera, const World &world, int frame, size_t tileIndex, std::vector<Vec3> &pixels);
+
+    // the tiles of every frame, in Morton order
+    const std::vector<Tile> &tileLayout() const { return tiles; }
+
+    size_t numThreads() const { return pool.size(); }
+
+    // samples taken per pixel in the last frame, top row first
+    const std::vector<uint32_t> &sampleCounts() const { return pixelSamples; }
+
+    // AOVs of the last frame rendered by render, if the settings ask for them
+    const AovBuffers &aovBuffers() const { return aovs; }
+
+private:
+    // with adaptive sampling, pixel blocks are checked for convergence every ADAPTIVE_BATCH samples
+    static const int ADAPTIVE_BATCH = 8;
+    // floor on the mean luminance in the relative error, so near-black pixels can converge
+    static constexpr double MIN_LUMINANCE = 0.01;
+    // paths per wave of the wavefront engine: enough for long runs of each stage, few enough to stay in cache
+    static const int WAVE_PATHS = 1 << 12;
+
+    // samples of one pixel so far
+    struct PixelState
+    {
+        Vec3 sum;
+        double meanLuminance = 0;
+        double squaredDeviations = 0; // of the luminance, from the mean
+        uint32_t numSamples = 0;
+    };
+
+    // standard error of the pixel's gamma-encoded luminance; infinite below 2 samples
+    static double displayError(const PixelState &state);
+
+    RenderSettings settings;
+    Integrator integrator;
+    ThreadPool pool;
+    std::vector<Tile> tiles;                    // in Morton order
+    std::vector<std::vector<Vec3>> tileBuffers; // one per worker
+    std::vector<uint32_t> pixelSamples;         // written tile by tile
+    std::vector<PixelState> accumulation;       // whole image, only while rendering progressively
+    AovBuffers aovs;
+    Denoiser denoiser;
+
+    // renders samples [sampleBegin, sampleEnd) of every pixel in the tile, on top of the accumulation if any;
+    // fills the tile's pixels of frameAovs unless it is null
+    void renderTile(const Camera &camera, const World &world, int frame, size_t tileIndex,
+                    int sampleBegin, int sampleEnd, std::vector<Vec3> &tileBuffer, std::vector<uint32_t> &sampleCounts,
+                    AovBuffers *frameAovs = nullptr);
+    // renderTile for settings.wavefront: the tile's samples are traced breadth-first, a wave of them at a time
+    void renderTileWavefront(const Camera &camera, const World &world, int frame, size_t tileIndex,
+                             int sampleBegin, int sampleEnd, std::vector<Vec3> &tileBuffer, std::vector<uint32_t> &sampleCounts,
+                             AovBuffers *frameAovs);
+    void copyTile(const Tile &tile, const Vec3 *pixels, std::vector<Vec3> &framebuffer) const;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Where each random number of a path sample lives. A sample is a point in a
+ * high dimensional cube: the camera takes the first CAMERA_DIMENSIONS
+ * coordinates, and bounce b owns the BOUNCE_DIMENSIONS that follow
+ * CAMERA_DIMENSIONS + b * BOUNCE_DIMENSIONS. Within a bounce every decision has
+ * a fixed range, so the same coordinate drives the same decision in all
+ * samples of a pixel whatever the path did before. Pairs that are warped
+ * together (pixel, lens, directions) start on even dimensions, where the
+ * samplers stratify them jointly.
+*/
+struct DimensionRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+namespace SampleLayout
+{
+    // camera
+    const uint32_t PIXEL_X = 0;
+    const uint32_t PIXEL_Y = 1;
+    const uint32_t LENS_U = 2;
+    const uint32_t LENS_V = 3;
+    const uint32_t TIME = 4;
+    const uint32_t CAMERA_DIMENSIONS = 6; // keeps bounces on even dimensions
+
+    // per bounce, relative to its first dimension
+    const DimensionRange LOBE = {0, 1};     // part of a mixed material
+    const DimensionRange LIGHT = {1, 3};    // light choice, then a direction pair
+    const DimensionRange SCATTER = {4, 3};  // direction pair, then a radius or a reflection choice
+    const DimensionRange ROULETTE = {7, 1};
+    const uint32_t BOUNCE_DIMENSIONS = 8;
+}
+
+/**
+ * Source of the sample coordinates. getPair must be a pure function of its
+ * arguments, so pixels can be rendered on any thread, in any order and in any
+ * process. Utility falls back to its Philox stream for draws outside a range.
+*/
+class Sampler
+{
+public:
+    virtual ~Sampler() {}
+
+    // everything get needs to know about a pixel (row-major) in frame; computed once per pixel or sample
+    virtual uint64_t pixelKey(uint32_t frame, uint32_t pixel) const = 0;
+
+    // coordinates 2 * pair and 2 * pair + 1 of sample `sample` of the pixel, in [0, 1)
+    virtual void getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const = 0;
+
+    double get(uint64_t pixelKey, uint32_t sample, uint32_t dimension) const
+    {
+        double first, second;
+        getPair(pixelKey, sample, dimension / 2, first, second);
+        return dimension % 2 == 0 ? first : second;
+    }
+
+    /**
+     * name is random, stratified, sobol or bluenoise. Returns nullptr for
+     * random, which is Utility's own independent Philox numbers.
+     * samplesPerPixel sizes the strata; imageWidth locates pixels for blue noise.
+     * Throws std::invalid_argument for unknown names.
+    */
+    static std::shared_ptr<const Sampler> create(const std::string &name, uint64_t seed, int samplesPerPixel, int imageWidth);
+    static bool isValidName(const std::string &name);
+};
+
+/**
+ * Jittered grid per dimension pair: sample i of each generation of
+ * samplesPerPixel samples falls into its own cell of an n x n grid,
+ * n = floor(sqrt(samplesPerPixel)), with the cell order shuffled per pair.
+ * Samples beyond n * n in a generation are uniform.
+*/
+class StratifiedSampler : public Sampler
+{
+public:
+    StratifiedSampler(uint64_t seed, int samplesPerPixel);
+
+    uint64_t pixelKey(uint32_t frame, uint32_t pixel) const override;
+    void getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const override;
+
+private:
+    uint32_t seed;
+    uint32_t samplesPerPixel;
+    uint32_t gridSize;
+};
+
+/**
+ * Owen-scrambled Sobol' points (Burley, "Practical Hash-based Owen
+ * Scrambling", 2020). Every dimension pair is the first two Sobol' dimensions,
+ * a (0, 2)-sequence, with its own scramble and its own Owen-scrambled index
+ * order, so pairs are well stratified and different pairs are decorrelated.
+ * Any prefix of 2^k samples is stratified, which suits adaptive sampling.
+*/
+class SobolSampler : public Sampler
+{
+public:
+    explicit SobolSampler(uint64_t seed);
+
+    uint64_t pixelKey(uint32_t frame, uint32_t pixel) const override;
+    void getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const override;
+
+    // unscrambled Sobol' coordinate as 32 fraction bits: dimension 0 or 1 of point index
+    static uint32_t sobol(uint32_t index, int dimension);
+    static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+    // point index of the sequence scrambled by pairHash
+    static void scrambledPair(uint32_t index, uint32_t pairHash, double &first, double &second);
+
+private:
+    uint32_t seed;
+};
+
+/**
+ * Owen-scrambled Sobol' points spread over the screen so that the error is
+ * blue noise (after Ahmed and Wonka, "Screen-Space Blue-Noise Diffusion of
+ * Monte Carlo Sampling Error via Hierarchical Ordering of Pixels", 2020).
+ * Pixels of a TILE_SIZE tile are visited in a randomly scrambled Morton order
+ * and pixel k takes the k-th block of samplesPerPixel consecutive points of one
+ * sequence. Every 2x2, 4x4, ... block of pixels then holds a stratified set, so
+ * the errors of neighbours partly cancel. The effect is strongest in the first
+ * dimensions (pixel, lens, first bounce); per pixel it converges like SobolSampler.
+*/
+class BlueNoiseSampler : public Sampler
+{
+public:
+    static const int TILE_BITS = 6;
+    static const uint32_t TILE_SIZE = 1u << TILE_BITS;
+
+    BlueNoiseSampler(uint64_t seed, int samplesPerPixel, int imageWidth);
+
+    uint64_t pixelKey(uint32_t frame, uint32_t pixel) const override;
+    void getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const override;
+
+private:
+    uint32_t seed;
+    uint32_t imageWidth;
+    uint32_t blockSize; // samples per pixel, rounded up to a power of two
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Vec3.hpp"
+
+/**
+ * Bounded LRU of texture tiles shared by all textures and render threads.
+ * Tiles are split over SHARDS by key, each with its own lock and LRU list, so
+ * threads missing on different tiles rarely wait for each other. A tile is
+ * read outside the lock; if two threads miss on the same tile both read it
+ * and the first to finish wins. Evicted tiles stay alive for as long as some
+ * thread still holds them.
+*/
+class TextureCache
+{
+public:
+    static const int TILE_BITS = 5;
+    static const int TILE_SIZE = 1 << TILE_BITS; // texels per side
+    static const size_t TILE_BYTES = (size_t)TILE_SIZE * TILE_SIZE * 4;
+
+    using Tile = std::array<uint8_t, TILE_BYTES>; // RGBA8, gamma 2 encoded, texels in Morton order
+    using TilePtr = std::shared_ptr<const Tile>;
+    // reads a tile; false on I/O errors
+    using TileLoader = std::function<bool(Tile &tile)>;
+
+    // lookups that miss a thread's front cache of recent tiles (see Texture), i.e. reach the shared cache
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    // capacityBytes is split evenly over the shards, at least one tile each
+    explicit TextureCache(size_t capacityBytes);
+
+    // the cached tile, or the one load reads on a miss; null if load fails
+    TilePtr get(uint64_t key, const TileLoader &load);
+
+    Stats stats() const;
+    size_t capacityTiles() const { return SHARDS * tilesPerShard; }
+
+private:
+    static const int SHARDS = 16;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<std::pair<uint64_t, TilePtr>> lru; // most recently used first
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, TilePtr>>::iterator> index;
+    };
+
+    Shard shards[SHARDS];
+    size_t tilesPerShard;
+    std::atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+};
+
+/**
+ * Image texture read from a PPM (P3 or P6), converted once into a binary cache
+ * file NAME.ppm.texcache of 32x32 tiles with the whole mip chain:
+ *
+ *   Header
+ *   Level levels[numLevels]
+ *   Tile tiles[] (at dataOffset, 4 KiB aligned; level 0 first, tiles row-major per level)
+ *
+ * Texels are stored gamma 2 encoded, like the PPM, and decoded to linear when
+ * sampled; mip levels are 2x2 box filtered in linear space. The cache is
+ * checked against the source's size, time and hash like a MeshCache.
+ * Rendering reads tiles through a TextureCache on demand, so a texture costs
+ * memory only for the tiles and levels rays actually touch.
+*/
+class Texture
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Opens the texture cache of ppmPath in cacheDir (next to the PPM if empty),
+     * converting the PPM first if the cache is missing or stale. If the cache
+     * cannot be written the tiles are kept in memory instead. Throws
+     * std::runtime_error if the PPM cannot be read.
+    */
+    static std::shared_ptr<Texture> load(const std::string &ppmPath, const std::string &cacheDir,
+                                         std::shared_ptr<TextureCache> cache);
+
+    ~Texture();
+    Texture(const Texture &) = delete;
+    Texture &operator=(const Texture &) = delete;
+
+    int width() const { return levels[0].width; }
+    int height() const { return levels[0].height; }
+    int numLevels() const { return (int)levels.size(); }
+    bool wasConverted() const { return converted; } // false if an up to date cache file was found
+
+    /**
+     * Linear color at (u, v), repeating outside [0, 1]; v runs up the image.
+     * Trilinear between the two mip levels whose texels are closest in size
+     * to footprint, in uv units; a footprint of 0 filters level 0 bilinearly.
+    */
+    Vec3 sample(double u, double v, double footprint) const;
+
+    // linear color of one texel, x and y wrapped
+    Vec3 texel(int level, int x, int y) const;
+
+    // one mip level, as stored in the cache file
+    struct Level
+    {
+        uint32_t width, height;
+        uint32_t tilesX, tilesY;
+        uint64_t firstTile; // of all the texture's tiles
+    };
+
+private:
+    std::vector<Level> levels;
+    std::shared_ptr<TextureCache> cache;
+    uint64_t id; // unique per texture, the high bits of its tile keys
+    int fd = -1;
+    uint64_t dataOffset = 0;
+    std::vector<uint8_t> resident; // all tiles, when the cache file could not be written
+    bool converted = false;        // the cache was (re)built by this load
+    mutable std::mutex fileMutex;  // MinGW has no pread
+
+    Texture() = default;
+
+    bool openCache(const std::string &cachePath, const std::string &ppmPath, const FileStamp &source);
+    bool readLayout(const uint8_t *header, size_t available, uint64_t fileSize);
+    bool readAt(uint64_t offset, size_t size, void *out) const;
+    bool readTile(uint64_t tileIndex, TextureCache::Tile &out) const;
+    // through this thread's front cache; valid until its next call. Null on I/O errors
+    const TextureCache::Tile *tileAt(uint64_t tileIndex) const;
+    Vec3 bilinear(int level, double u, double v) const;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed-size pool of worker threads with one task queue per worker.
+ * Workers take tasks from the front of their own queue and, once it is empty,
+ * steal from the back of the other queues, i.e. the work furthest away from
+ * what the victim is currently doing.
+*/
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t task, size_t worker)>;
+
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return numWorkers; }
+
+    /**
+     * Runs fn(task, worker) for every task in [0, numTasks) and returns once all
+     * of them are done. Tasks are handed out in contiguous chunks, so neighbouring
+     * task indices tend to run on the same worker. The calling thread is worker 0.
+     * If a task throws, the tasks not yet started are skipped and the first
+     * exception is rethrown here once every worker has stopped.
+    */
+    void parallelFor(size_t numTasks, const Task &fn);
+
+private:
+    struct alignas(64) WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    size_t numWorkers;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const Task *currentTask = nullptr;
+    size_t generation = 0;
+    size_t busyWorkers = 0;
+    bool stopping = false;
+    std::exception_ptr error; // the first exception thrown by a task of this run
+    std::atomic<bool> failed{false};
+
+    void workerLoop(size_t worker);
+    void drain(size_t worker);
+    bool popOrSteal(size_t worker, size_t &task);
+};
+
+#endif
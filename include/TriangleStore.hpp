@@ -0,0 +1,73 @@
+#ifndef TRIANGLESTORE_HPP
+#define TRIANGLESTORE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "BoundingBox.hpp"
+#include "Ray.hpp"
+#include "Vec3.hpp"
+
+class Material;
+class Triangle;
+struct HitRecord;
+
+#ifndef TRIANGLE_LANES
+#define TRIANGLE_LANES 4
+#endif
+
+/**
+ * Mesh triangles in structure-of-arrays layout. Each triangle is stored as its
+ * first vertex and the two edges leaving it, one array per coordinate, so the
+ * intersection kernel tests LANES neighbouring triangles per pass over
+ * contiguous memory instead of chasing one pointer per triangle.
+ * Motion (end - start) is only stored when some triangle actually moves.
+*/
+class TriangleStore
+{
+public:
+    static const int LANES = TRIANGLE_LANES;
+    static_assert(LANES == 4 || LANES == 8, "TRIANGLE_LANES must be 4 or 8");
+
+    void clear();
+    void reserve(size_t count);
+    void add(const Triangle &triangle);
+    // a triangle that does not move, with the texture coordinates (s, t) of its corners if given
+    void add(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2, const Material *material, const float *texcoords = nullptr);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /**
+     * Closest hit among triangles [first, first + num), using the same
+     * Moller-Trumbore test as Triangle::intersect. On a hit closestT shrinks to
+     * the hit distance and the triangle index is returned, otherwise -1.
+    */
+    int intersect(const Ray &ray, uint32_t first, uint32_t num, double tMin, double &closestT) const;
+
+    // fills rec for a hit returned by intersect, including the interpolated uvs if the store has them
+    void fillHitRecord(const Ray &ray, int index, double t, HitRecord &rec) const;
+
+    // first vertex and edges of a triangle at the given time
+    void vertexAt(size_t index, double time, Vec3 &v0, Vec3 &e1, Vec3 &e2) const;
+
+private:
+    size_t count = 0;
+    bool moving = false;
+
+    // first vertex and edges at time 0, padded with degenerate triangles to a multiple of LANES
+    std::vector<double> v0x, v0y, v0z, e1x, e1y, e1z, e2x, e2y, e2z;
+    // change of the above over the shutter interval; empty unless moving
+    std::vector<double> dv0x, dv0y, dv0z, de1x, de1y, de1z, de2x, de2y, de2z;
+    std::vector<const Material *> materials;
+    // 6 per triangle and one scale each; empty unless some triangle has texture coordinates
+    std::vector<float> texcoords;
+    std::vector<float> uvScales;
+
+    template <bool Moving>
+    int intersectRange(const Ray &ray, uint32_t first, uint32_t num, double tMin, double &closestT) const;
+
+    void resizeArrays(size_t capacity);
+};
+
+#endif
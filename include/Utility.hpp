@@ -1,18 +1,69 @@
 #ifndef UTILITY_HPP
 #define UTILITY_HPP
 
-#include <random>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 
+#include "Random.hpp"
+#include "Sampler.hpp"
 #include "Vec3.hpp"
 
+/**
+ * Random numbers are drawn from a counter-based generator keyed on
+ * (seed, frame, pixel, sample, bounce), so they do not depend on which thread
+ * renders a pixel or in which order. Each thread keeps its own position in
+ * the stream; beginSample/beginBounce select the stream for the calling thread.
+ *
+ * With a Sampler set, the numbers of a sample come from its coordinates
+ * instead: beginBounce moves to the bounce's dimensions and useDimensions to
+ * the range of one decision (see SampleLayout). Draws past the end of the
+ * range, or outside any range, still come from the stream.
+*/
 class Utility {
 public:
     Utility();
 
+    void setSeed(uint64_t seed);
+
+    void beginSample(uint32_t frame, uint32_t pixel, uint32_t sample);
+    void beginBounce(uint32_t bounce);
+    // range relative to the current bounce; nothing changes without a sampler
+    void useDimensions(DimensionRange range);
+
+    // nullptr for independent random numbers
+    void setSampler(std::shared_ptr<const Sampler> sampler);
+
+    /**
+     * Batch path for per-sample dimensions of consecutive samples of one pixel:
+     * fills out[d * count + i] with dimension d in [0, 4) of sample firstSample + i.
+     * block selects another 4 dimensions of the same samples.
+    */
+    void sampleBatch(uint32_t frame, uint32_t pixel, uint32_t firstSample, size_t count, uint32_t block, double *out) const;
+
+    /**
+     * Camera dimensions of consecutive samples of one pixel: out[d * count + i]
+     * for sample firstSample + i, with d = 0 pixel x, 1 pixel y, 2 time, 3 and 4
+     * lens. out must hold 8 * count values.
+    */
+    void cameraSamples(uint32_t frame, uint32_t pixel, uint32_t firstSample, size_t count, double *out) const;
+
     double randomDouble();
     double randomDouble(double min, double max);
     Vec3 randomPointInUnitDisk();
     Vec3 randomUnitSphere();
+    Vec3 randomUnitVector(); // on the unit sphere
+
+    // warp uniform numbers in [0, 1) to uniformly distributed points
+    static Vec3 pointInUnitDisk(double u1, double u2);
+    static Vec3 pointInUnitSphere(double u1, double u2, double u3);
+    static Vec3 pointOnUnitSphere(double u1, double u2);
+
+private:
+    uint64_t seed = 0;
+    std::shared_ptr<const Sampler> sampler;
+
+    Philox::Key frameKey(uint32_t frame) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,32 +1,149 @@
 #ifndef VEC3_HPP
 #define VEC3_HPP
 
+#include <cmath>
+
+/**
+ * Header-only so every operator inlines into the intersection and scattering
+ * loops. The default representation is three plain doubles and everything is
+ * constexpr.
+ *
+ * Building with -D VEC3_SIMD (plus -mavx, or plain SSE2) switches to a padded
+ * 4-wide representation: x, y, z share storage with a vector register and the
+ * component-wise operators become single SIMD instructions. Those operators
+ * are then no longer constexpr. Results are the same either way: the extra
+ * lane is padding and every reduction still adds x, y, z in order.
+*/
+
+#if defined(VEC3_SIMD) && (defined(__AVX__) || defined(__SSE2__))
+#include <immintrin.h>
+#define VEC3_USE_SIMD 1
+#define VEC3_CONSTEXPR inline
+#else
+#define VEC3_USE_SIMD 0
+#define VEC3_CONSTEXPR constexpr
+#endif
+
+#if VEC3_USE_SIMD
+namespace Vec3Lanes
+{
+#ifdef __AVX__
+    typedef __m256d Lanes;
+
+    inline Lanes add(Lanes a, Lanes b) { return _mm256_add_pd(a, b); }
+    inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_pd(a, b); }
+    inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_pd(a, b); }
+    inline Lanes div(Lanes a, Lanes b) { return _mm256_div_pd(a, b); }
+    inline Lanes broadcast(double value) { return _mm256_set1_pd(value); }
+#else
+    struct Lanes
+    {
+        __m128d xy, zw;
+    };
+
+    inline Lanes add(Lanes a, Lanes b) { return {_mm_add_pd(a.xy, b.xy), _mm_add_pd(a.zw, b.zw)}; }
+    inline Lanes sub(Lanes a, Lanes b) { return {_mm_sub_pd(a.xy, b.xy), _mm_sub_pd(a.zw, b.zw)}; }
+    inline Lanes mul(Lanes a, Lanes b) { return {_mm_mul_pd(a.xy, b.xy), _mm_mul_pd(a.zw, b.zw)}; }
+    inline Lanes div(Lanes a, Lanes b) { return {_mm_div_pd(a.xy, b.xy), _mm_div_pd(a.zw, b.zw)}; }
+    inline Lanes broadcast(double value) { return {_mm_set1_pd(value), _mm_set1_pd(value)}; }
+#endif
+}
+#endif
+
 class Vec3
 {
 public:
-    double x, y, z; // r, g, b in context of colors 
-
-    Vec3();
-    Vec3(double x, double y, double z);
-
-    Vec3 operator+(const Vec3 &other) const;
-    Vec3 operator-() const;
-    Vec3 operator-(const Vec3 &other) const;
-    Vec3 operator*(double scalar) const;
-    Vec3 operator*(const Vec3 &other) const;
-    Vec3 operator/(double scalar) const;
-    Vec3 &operator+=(const Vec3 &other);
-    Vec3 &operator/=(double scalar);
-    double& operator[](int i);
-    const double& operator[](int i) const;
-
-    double length() const;
-    double lengthSquared() const;
-    double dot(const Vec3 &other) const;
-    Vec3 cross(const Vec3 &other) const;
-    Vec3 normalize() const;
+#if VEC3_USE_SIMD
+    union
+    {
+        struct
+        {
+            double x, y, z; // r, g, b in context of colors
+            double w;       // padding, kept at 0 by the constructors
+        };
+        Vec3Lanes::Lanes lanes;
+    };
+
+    constexpr Vec3() : x(0), y(0), z(0), w(0) {}
+    constexpr Vec3(double x, double y, double z) : x(x), y(y), z(z), w(0) {}
+    Vec3(Vec3Lanes::Lanes lanes) : lanes(lanes) {}
+
+    Vec3 operator+(const Vec3 &other) const { return Vec3Lanes::add(lanes, other.lanes); }
+    Vec3 operator-(const Vec3 &other) const { return Vec3Lanes::sub(lanes, other.lanes); }
+    Vec3 operator*(double scalar) const { return Vec3Lanes::mul(lanes, Vec3Lanes::broadcast(scalar)); }
+    Vec3 operator*(const Vec3 &other) const { return Vec3Lanes::mul(lanes, other.lanes); }
+    Vec3 operator/(double scalar) const { return Vec3Lanes::div(lanes, Vec3Lanes::broadcast(scalar)); }
+    Vec3 &operator+=(const Vec3 &other)
+    {
+        lanes = Vec3Lanes::add(lanes, other.lanes);
+        return *this;
+    }
+    Vec3 &operator/=(double scalar)
+    {
+        lanes = Vec3Lanes::div(lanes, Vec3Lanes::broadcast(scalar));
+        return *this;
+    }
+#else
+    double x, y, z; // r, g, b in context of colors
+
+    constexpr Vec3() : x(0), y(0), z(0) {}
+    constexpr Vec3(double x, double y, double z) : x(x), y(y), z(z) {}
+
+    constexpr Vec3 operator+(const Vec3 &other) const { return Vec3(x + other.x, y + other.y, z + other.z); }
+    constexpr Vec3 operator-(const Vec3 &other) const { return Vec3(x - other.x, y - other.y, z - other.z); }
+    constexpr Vec3 operator*(double scalar) const { return Vec3(x * scalar, y * scalar, z * scalar); }
+    constexpr Vec3 operator*(const Vec3 &other) const { return Vec3(x * other.x, y * other.y, z * other.z); }
+    constexpr Vec3 operator/(double scalar) const { return Vec3(x / scalar, y / scalar, z / scalar); }
+    constexpr Vec3 &operator+=(const Vec3 &other)
+    {
+        x += other.x;
+        y += other.y;
+        z += other.z;
+        return *this;
+    }
+    constexpr Vec3 &operator/=(double scalar)
+    {
+        x /= scalar;
+        y /= scalar;
+        z /= scalar;
+        return *this;
+    }
+#endif
+
+    constexpr Vec3 operator-() const { return Vec3(-x, -y, -z); }
+
+    constexpr double &operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
+    constexpr const double &operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+
+    double length() const { return std::sqrt(lengthSquared()); }
+    constexpr double lengthSquared() const { return x * x + y * y + z * z; }
+    constexpr double dot(const Vec3 &other) const { return x * other.x + y * other.y + z * other.z; }
+
+    constexpr Vec3 cross(const Vec3 &other) const
+    {
+        return Vec3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    }
+
+    Vec3 normalize() const
+    {
+        double len = length();
+        return Vec3(x / len, y / len, z / len);
+    }
+
+    // component-wise 1 / v, e.g. for slab tests
+    VEC3_CONSTEXPR Vec3 reciprocal() const
+    {
+#if VEC3_USE_SIMD
+        return Vec3Lanes::div(Vec3Lanes::broadcast(1.0), lanes);
+#else
+        return Vec3(1 / x, 1 / y, 1 / z);
+#endif
+    }
 };
 
-Vec3 operator*(double scalar, const Vec3 &vec);
+VEC3_CONSTEXPR Vec3 operator*(double scalar, const Vec3 &vec)
+{
+    return vec * scalar;
+}
 
-#endif
\ No newline at end of file
+#endif
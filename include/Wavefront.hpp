@@ -0,0 +1,78 @@
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "Integrator.hpp"
+#include "World.hpp"
+
+/**
+ * Breadth-first path tracer: instead of following one path to its end before
+ * starting the next, every bounce of a whole batch of paths runs as a series
+ * of stages over queues of path indices:
+ *
+ *   extend  intersects the next segment of every live path
+ *   sort    ends the paths that missed and orders the hits by material type
+ *   shade   scatters every hit, one material type after the other, and
+ *           queues a shadow ray for every light sampled
+ *   shadow  traces the queued shadow rays
+ *   compact keeps the paths still alive, in order, for the next bounce
+ *
+ * so each stage runs the same code over many rays in a row instead of
+ * alternating between traversal and five scatter functions. The paths are
+ * generated by the caller (addPath) and their radiance is read back once
+ * trace returns. Shading goes through the Integrator's own steps, with every
+ * path's random numbers selected by its (frame, pixel, sample, bounce), so
+ * the radiance is exactly what Integrator::radiance returns for the same path.
+ * The queues keep their memory between batches; one Wavefront per thread.
+*/
+class Wavefront
+{
+public:
+    // forgets all paths, keeping the queues' memory
+    void clear();
+
+    // queues a camera ray; returns the path's index
+    size_t addPath(const Ray &ray, uint32_t pixel, uint32_t sample);
+
+    size_t size() const { return paths.size(); }
+
+    /**
+     * Traces every queued path to its end. With packets, the camera rays are
+     * intersected in packets of RayPacket::SIZE consecutive paths, so paths
+     * should be added pixel block by pixel block. With firstHits, firstHit
+     * returns the AOVs of every path.
+    */
+    void trace(const Integrator &integrator, const World &world, uint32_t frame, bool packets, bool firstHits);
+
+    const Vec3 &radiance(size_t path) const { return paths[path].result; }
+    int pathLength(size_t path) const { return pathLengths[path]; }
+    const FirstHit &firstHit(size_t path) const { return firstHitAovs[path]; }
+
+private:
+    // per path
+    std::vector<Integrator::Path> paths;
+    std::vector<HitRecord> recs;
+    std::vector<uint32_t> pixels, samples;
+    std::vector<uint16_t> pathLengths;
+    std::vector<FirstHit> firstHitAovs;
+
+    // queues of path indices
+    std::vector<uint32_t> active;    // live paths, the extend queue
+    std::vector<uint32_t> hits;      // the shade queue, by material type after sorting
+    std::vector<uint32_t> survivors; // alive after shading
+    std::vector<uint32_t> sorted;    // scratch for the sort
+    std::vector<uint8_t> hitFlags;   // per entry of active
+
+    // the shadow queue, per light sampled
+    std::vector<uint32_t> shadowPaths;
+    std::vector<Integrator::LightSample> shadowRays;
+
+    void extend(const World &world, int bounce, bool packets);
+    void sortHits(const Integrator &integrator, const World &world);
+    void shade(const Integrator &integrator, const World &world, uint32_t frame, int bounce);
+    void traceShadows(const Integrator &integrator, const World &world);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef WIDEBVH_HPP
+#define WIDEBVH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "BVH.hpp"
+#include "BoundingBox.hpp"
+#include "Metrics.hpp"
+#include "Ray.hpp"
+
+// children per node; 4 fits a node in one 64-byte cache line
+#ifndef BVH_WIDTH
+#define BVH_WIDTH 4
+#endif
+
+static_assert(BVH_WIDTH == 4 || BVH_WIDTH == 8, "BVH_WIDTH must be 4 or 8");
+
+/**
+ * Node of a collapsed BVH. Child boxes are quantized to 8 bits per plane
+ * relative to the node's own box: plane q on an axis lies at
+ * origin + q * 2^exponent, rounded outwards so the decoded box always
+ * contains the child.
+*/
+struct WideBVHNode
+{
+    static const int WIDTH = BVH_WIDTH;
+
+    float origin[3];    // node box min, rounded down
+    int8_t exponent[3]; // per-axis step between quantized planes
+    uint8_t numChildren;
+    uint8_t qlo[3][WIDTH];
+    uint8_t qhi[3][WIDTH];
+    uint32_t child[WIDTH]; // node index, or first primitive of a leaf
+    uint16_t count[WIDTH]; // primitives in a leaf child, 0 for interior children
+};
+
+/**
+ * BVH4/BVH8 collapsed from a binary SAH BVH. Leaves keep the binary leaf
+ * ranges, so primitives stored in BVH::primIndices order stay valid. All
+ * children of a node are tested in one branchless slab test with the ray's
+ * precomputed reciprocal direction.
+*/
+class WideBVH
+{
+public:
+    static const int WIDTH = BVH_WIDTH;
+    // a node pushes at most WIDTH - 1 entries on top of the one it replaces, and no node is more than
+    // BVH::MAX_STACK_DEPTH levels deep
+    static const int MAX_STACK_SIZE = (WIDTH - 1) * BVH::MAX_STACK_DEPTH + 1;
+
+    std::vector<WideBVHNode> nodes;
+    BoundingBox bounds; // exact bounds of the root
+
+    // throws std::length_error if a binary leaf holds more than 65535 primitives
+    void build(const BVH &bvh);
+
+    void clear();
+    bool empty() const { return nodes.empty(); }
+    size_t memoryUsage() const { return nodes.size() * sizeof(WideBVHNode); }
+
+    /**
+     * Closest-hit traversal with the same contract as BVH::traverseLeaves:
+     * intersectLeaf(first, count, tMin, closestT) tests primitives
+     * [first, first + count) of BVH::primIndices order.
+    */
+    template <typename LeafIntersector>
+    bool traverseLeaves(const Ray &ray, double tMin, double tMax, LeafIntersector &&intersectLeaf) const;
+
+private:
+    uint32_t collapse(const BVH &bvh, uint32_t binaryNode);
+
+    static double stepSize(int8_t exponent)
+    {
+        // 2^exponent, built directly from the IEEE bits
+        uint64_t bits = (uint64_t)(exponent + 1023) << 52;
+        double step;
+        std::memcpy(&step, &bits, sizeof(step));
+        return step;
+    }
+
+    // returns the children hit within [tMin, tMax], with their entry distances
+    static uint32_t intersectChildren(const WideBVHNode &node, const Ray &ray, double tMin, double tMax, double *tEntry);
+};
+
+inline uint32_t WideBVH::intersectChildren(const WideBVHNode &node, const Ray &ray, double tMin, double tMax, double *tEntry)
+{
+    // near and far planes per axis as doubles (SoA), picked by the direction's sign like BoundingBox::intersect
+    alignas(64) double nearQ[3][WIDTH], farQ[3][WIDTH];
+    alignas(64) double hit[WIDTH];
+    const double rayOrigin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const double invD[3] = {ray.invDirection.x, ray.invDirection.y, ray.invDirection.z};
+    double origin[3], step[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis] = node.origin[axis];
+        step[axis] = stepSize(node.exponent[axis]);
+        const uint8_t *nearPlanes = invD[axis] < 0.0 ? node.qhi[axis] : node.qlo[axis];
+        const uint8_t *farPlanes = invD[axis] < 0.0 ? node.qlo[axis] : node.qhi[axis];
+        for (int lane = 0; lane < WIDTH; ++lane)
+        {
+            nearQ[axis][lane] = nearPlanes[lane];
+            farQ[axis][lane] = farPlanes[lane];
+        }
+    }
+
+    // all three slabs of every child in one branch-free pass, so it vectorizes
+    for (int lane = 0; lane < WIDTH; ++lane)
+    {
+        double nearX = (origin[0] + nearQ[0][lane] * step[0] - rayOrigin[0]) * invD[0];
+        double farX = (origin[0] + farQ[0][lane] * step[0] - rayOrigin[0]) * invD[0];
+        double nearY = (origin[1] + nearQ[1][lane] * step[1] - rayOrigin[1]) * invD[1];
+        double farY = (origin[1] + farQ[1][lane] * step[1] - rayOrigin[1]) * invD[1];
+        double nearZ = (origin[2] + nearQ[2][lane] * step[2] - rayOrigin[2]) * invD[2];
+        double farZ = (origin[2] + farQ[2][lane] * step[2] - rayOrigin[2]) * invD[2];
+
+        double lo = nearX > tMin ? nearX : tMin;
+        lo = nearY > lo ? nearY : lo;
+        lo = nearZ > lo ? nearZ : lo;
+        double hi = farX < tMax ? farX : tMax;
+        hi = farY < hi ? farY : hi;
+        hi = farZ < hi ? farZ : hi;
+        tEntry[lane] = lo;
+        hit[lane] = lo <= hi ? 1.0 : 0.0;
+    }
+
+    uint32_t hitMask = 0;
+    for (int lane = 0; lane < WIDTH; ++lane)
+    {
+        hitMask |= (uint32_t)(hit[lane] != 0) << lane;
+    }
+    hitMask &= (1u << node.numChildren) - 1;
+
+    Metrics::increment(Metrics::localShard().bvIntersections, popcount(hitMask));
+    return hitMask;
+}
+
+template <typename LeafIntersector>
+bool WideBVH::traverseLeaves(const Ray &ray, double tMin, double tMax, LeafIntersector &&intersectLeaf) const
+{
+    if (nodes.empty())
+        return false;
+
+    struct StackEntry
+    {
+        uint32_t child;
+        uint32_t count; // 0 for nodes
+        double tEntry;
+    };
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, tMin};
+
+    bool hitAnything = false;
+    double closestT = tMax;
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        if (entry.tEntry > closestT)
+            continue; // starts beyond the closest hit so far
+
+        if (entry.count > 0)
+        {
+            if (intersectLeaf(entry.child, entry.count, tMin, closestT))
+            {
+                hitAnything = true;
+            }
+            continue;
+        }
+
+        const WideBVHNode &node = nodes[entry.child];
+        alignas(64) double tEntry[WIDTH];
+        uint32_t hitMask = intersectChildren(node, ray, tMin, closestT, tEntry);
+
+        // sort the hit children far to near, so the nearest is popped first
+        int order[WIDTH];
+        int numHits = 0;
+        for (int lane = 0; lane < WIDTH; ++lane)
+        {
+            if (!(hitMask & (1u << lane)))
+                continue;
+            int i = numHits++;
+            while (i > 0 && tEntry[order[i - 1]] < tEntry[lane])
+            {
+                order[i] = order[i - 1];
+                --i;
+            }
+            order[i] = lane;
+        }
+
+        // skips the farthest children if they do not fit; never happens for trees from build() or a validated
+        // cache, but dropping them beats writing past the stack
+        int first = std::max(0, stackSize + numHits - MAX_STACK_SIZE);
+        for (int i = first; i < numHits; ++i)
+        {
+            int lane = order[i];
+            stack[stackSize++] = {node.child[lane], node.count[lane], tEntry[lane]};
+        }
+    }
+
+    return hitAnything;
+}
+
+#endif
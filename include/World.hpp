@@ -4,15 +4,98 @@
 #include <memory>
 #include <vector>
 
+#include "BVH.hpp"
 #include "Hittable.hpp"
 
+class Material;
+
+// sky gradient, seen by rays that leave the scene
+struct Sky {
+    Vec3 top = Vec3(0.53, 0.81, 0.98);
+    Vec3 bottom = Vec3(0.53, 0.81, 0.98);
+};
+
+/**
+ * One snapshot of the scene. Objects, the materials set through setMaterial
+ * and the BVH are immutable and shared between copies: changing a World
+ * replaces them with modified clones (copy-on-write), so copying one is cheap
+ * and a copy keeps rendering its frame while the original moves on to the next.
+ * Copies are independent, but a single World must not be changed while it is
+ * being rendered.
+*/
 class World {
 private:
-    std::vector<std::shared_ptr<Hittable>> objects;
+    std::vector<std::shared_ptr<const Hittable>> objects;
+    std::vector<std::shared_ptr<const Material>> objectMaterials; // set through setMaterial, kept alive here
+    std::vector<BoundingBox> objectBounds; // as of the last build or refit
+    std::vector<uint32_t> movedObjects;    // ids moved since then
+    std::vector<uint32_t> lights;          // emissive objects that support light sampling
+    std::shared_ptr<const BVH> bvh = std::make_shared<BVH>();
+    Sky currentSky;
+    double builtSahCost = 0;
+    double rebuildThreshold = 1.3;
+
+    void collectLights();
+    // how likely sampleLight is to pick each light from origin, unnormalized; returns the sum
+    double lightWeight(const Hittable& light, const Vec3& origin, double time) const;
+    double totalLightWeight(const Vec3& origin, double time) const;
 
 public:
-    void addObject(std::shared_ptr<Hittable> object);
+    // returns the object's id, used to move it later
+    size_t addObject(std::shared_ptr<const Hittable> object);
+
+    /**
+     * Builds the acceleration structure over the current objects.
+     * Until then, intersect falls back to testing every object.
+    */
+    void build();
+
+    // moves a copy of an object in its place and marks it for the next update
+    void moveObject(size_t id, const Vec3& pos);
+
+    // gives the object (not the triangles of a CompoundShape) another material, in a copy of it
+    void setMaterial(size_t id, std::shared_ptr<const Material> material);
+
+    void setSky(const Sky& sky) { currentSky = sky; }
+    const Sky& sky() const { return currentSky; }
+
+    /**
+     * Brings the acceleration structure up to date for the next frame. The
+     * first call builds it; later calls only refit the objects moved through
+     * moveObject, leaving everything else untouched, and rebuild once the
+     * refitted SAH cost exceeds rebuildThreshold times that of the last build.
+     * Returns true if it (re)built.
+    */
+    bool update();
+
+    void setRebuildThreshold(double threshold) { rebuildThreshold = threshold; }
+
+    // fills rec.object with the object hit
     bool intersect(const Ray& ray, double t_min, double t_max, HitRecord& rec) const;
+
+    size_t numLights() const { return lights.size(); }
+
+    /**
+     * Next-event estimation: picks a light with u0, in proportion to its
+     * emitted luminance times the solid angle it covers from origin, and a
+     * point on it with u1, u2, returned as a direction and distance from
+     * origin. pdf is per solid angle and includes the pick. Returns false if
+     * there is no light to sample from origin.
+    */
+    bool sampleLight(const Vec3& origin, double time, double u0, double u1, double u2,
+                     Vec3& direction, double& distance, double& pdf, const Hittable*& light) const;
+
+    // pdf of sampleLight producing a direction that hits object first; 0 if object is not a light
+    double lightPdf(const Hittable* object, const Vec3& origin, double time, const Vec3& direction) const;
+
+    /**
+     * Packet version of intersect for coherent rays: the packet shares one BVH
+     * traversal. Packets whose directions disagree in sign, and subtrees that only
+     * one ray still reaches, are traced ray by ray instead.
+     * Fills recs for the returned lanes, which hit something.
+    */
+    uint32_t intersectPacket(RayPacket& packet, double t_min, HitRecord* recs) const;
+    const BVHStats& bvhStats() const;
 };
 
 #endif
@@ -1,14 +1,9 @@
 #ifndef GLOBALS_HPP
 #define GLOBALS_HPP
 
-#include <atomic>
-
 #include "Utility.hpp"
+#include "Vec3.hpp"
 
 extern Utility util;
 
-extern std::atomic<uint64_t> numRays;
-extern std::atomic<uint64_t> numBVIntersections;
-extern std::atomic<uint64_t> numObjectIntersections;
-
 #endif
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+#include "BVH.hpp"
+
+namespace
+{
+    const double TRAVERSAL_COST = 1.0;
+    const double INTERSECTION_COST = 1.0;
+
+    BoundingBox emptyBox()
+    {
+        const double inf = std::numeric_limits<double>::infinity();
+        return BoundingBox(Vec3(inf, inf, inf), Vec3(-inf, -inf, -inf));
+    }
+
+    void grow(BoundingBox &box, const BoundingBox &other)
+    {
+        box.min = Vec3(std::min(box.min.x, other.min.x), std::min(box.min.y, other.min.y), std::min(box.min.z, other.min.z));
+        box.max = Vec3(std::max(box.max.x, other.max.x), std::max(box.max.y, other.max.y), std::max(box.max.z, other.max.z));
+    }
+
+    void grow(BoundingBox &box, const Vec3 &point)
+    {
+        box.min = Vec3(std::min(box.min.x, point.x), std::min(box.min.y, point.y), std::min(box.min.z, point.z));
+        box.max = Vec3(std::max(box.max.x, point.x), std::max(box.max.y, point.y), std::max(box.max.z, point.z));
+    }
+
+    double safeArea(const BoundingBox &box)
+    {
+        return box.min.x > box.max.x ? 0.0 : box.surfaceArea();
+    }
+}
+
+void BVH::clear()
+{
+    nodes.clear();
+    primIndices.clear();
+    parents.clear();
+    primLeaves.clear();
+    weightedArea = 0;
+    stats = BVHStats();
+}
+
+void BVH::build(const std::vector<BoundingBox> &primBounds, int maxLeafSize)
+{
+    auto timeStart = std::chrono::steady_clock::now();
+    clear();
+
+    if (primBounds.empty())
+        return;
+
+    primIndices.resize(primBounds.size());
+    std::iota(primIndices.begin(), primIndices.end(), 0);
+
+    std::vector<Vec3> centroids;
+    centroids.reserve(primBounds.size());
+    for (const BoundingBox &box : primBounds)
+    {
+        centroids.push_back(box.centroid());
+    }
+
+    nodes.reserve(2 * primBounds.size());
+    nodes.emplace_back();
+    buildRecursive(0, primBounds, centroids, 0, (uint32_t)primBounds.size(), 1, maxLeafSize);
+
+    parents.assign(nodes.size(), 0);
+    primLeaves.assign(primBounds.size(), 0);
+    for (uint32_t i = 0; i < nodes.size(); ++i)
+    {
+        const BVHNode &node = nodes[i];
+        if (node.isLeaf())
+        {
+            for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; ++p)
+            {
+                primLeaves[primIndices[p]] = i;
+            }
+        }
+        else
+        {
+            parents[node.leftOrFirst] = i;
+            parents[node.leftOrFirst + 1] = i;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - timeStart;
+    computeStats(elapsed.count());
+}
+
+void BVH::refit(const std::vector<BoundingBox> &primBounds, const std::vector<uint32_t> &changedPrims)
+{
+    if (nodes.empty())
+        return;
+
+    for (uint32_t prim : changedPrims)
+    {
+        uint32_t current = primLeaves[prim];
+        while (true)
+        {
+            BVHNode &node = nodes[current];
+            BoundingBox box = emptyBox();
+            if (node.isLeaf())
+            {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                {
+                    grow(box, primBounds[primIndices[i]]);
+                }
+            }
+            else
+            {
+                grow(box, nodes[node.leftOrFirst].bounds);
+                grow(box, nodes[node.leftOrFirst + 1].bounds);
+            }
+
+            // unchanged box: nothing above it changes either
+            if (box.min.x == node.bounds.min.x && box.min.y == node.bounds.min.y && box.min.z == node.bounds.min.z &&
+                box.max.x == node.bounds.max.x && box.max.y == node.bounds.max.y && box.max.z == node.bounds.max.z)
+                break;
+
+            double cost = node.isLeaf() ? INTERSECTION_COST * node.count : TRAVERSAL_COST;
+            weightedArea += cost * (safeArea(box) - safeArea(node.bounds));
+            node.bounds = box;
+
+            if (current == 0)
+                break;
+            current = parents[current];
+        }
+    }
+
+    double rootArea = safeArea(nodes[0].bounds);
+    stats.sahCost = rootArea > 0 ? weightedArea / rootArea : weightedArea;
+    stats.refits++;
+}
+
+void BVH::buildRecursive(uint32_t nodeIndex, const std::vector<BoundingBox> &primBounds,
+                         const std::vector<Vec3> &centroids, uint32_t first, uint32_t count,
+                         size_t depth, int maxLeafSize)
+{
+    BoundingBox bounds = emptyBox();
+    BoundingBox centroidBounds = emptyBox();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        grow(bounds, primBounds[primIndices[i]]);
+        grow(centroidBounds, centroids[primIndices[i]]);
+    }
+
+    nodes[nodeIndex].bounds = bounds;
+    nodes[nodeIndex].leftOrFirst = first;
+    nodes[nodeIndex].count = count;
+    nodes[nodeIndex].axis = 0;
+
+    // the traversal stack holds at most one entry per level
+    if (count <= (uint32_t)maxLeafSize || depth >= MAX_STACK_DEPTH - 1)
+        return;
+
+    // binned SAH: evaluate NUM_BINS - 1 candidate planes on every axis
+    int bestAxis = -1;
+    int bestSplit = 0;
+    double bestCost = std::numeric_limits<double>::infinity();
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double lo = centroidBounds.min[axis];
+        double extent = centroidBounds.max[axis] - lo;
+        if (extent <= 0)
+            continue;
+
+        BoundingBox binBounds[NUM_BINS];
+        uint32_t binCounts[NUM_BINS] = {0};
+        for (int b = 0; b < NUM_BINS; ++b)
+        {
+            binBounds[b] = emptyBox();
+        }
+
+        double scale = NUM_BINS / extent;
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            uint32_t prim = primIndices[i];
+            int b = std::min(NUM_BINS - 1, (int)((centroids[prim][axis] - lo) * scale));
+            binCounts[b]++;
+            grow(binBounds[b], primBounds[prim]);
+        }
+
+        // sweep from the right to get the cost of every right partition
+        double rightArea[NUM_BINS];
+        uint32_t rightCount[NUM_BINS];
+        BoundingBox accum = emptyBox();
+        uint32_t accumCount = 0;
+        for (int b = NUM_BINS - 1; b > 0; --b)
+        {
+            grow(accum, binBounds[b]);
+            accumCount += binCounts[b];
+            rightArea[b] = safeArea(accum);
+            rightCount[b] = accumCount;
+        }
+
+        accum = emptyBox();
+        accumCount = 0;
+        for (int b = 0; b < NUM_BINS - 1; ++b)
+        {
+            grow(accum, binBounds[b]);
+            accumCount += binCounts[b];
+            if (accumCount == 0 || rightCount[b + 1] == 0)
+                continue;
+
+            double cost = safeArea(accum) * accumCount + rightArea[b + 1] * rightCount[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    uint32_t mid;
+    double parentArea = safeArea(bounds);
+
+    if (bestAxis >= 0)
+    {
+        double splitCost = TRAVERSAL_COST + INTERSECTION_COST * (parentArea > 0 ? bestCost / parentArea : count);
+        if (splitCost >= INTERSECTION_COST * count)
+            return; // cheaper as a leaf
+
+        double lo = centroidBounds.min[bestAxis];
+        double scale = NUM_BINS / (centroidBounds.max[bestAxis] - lo);
+        uint32_t *begin = primIndices.data() + first;
+        uint32_t *split = std::partition(begin, begin + count, [&](uint32_t prim) {
+            int b = std::min(NUM_BINS - 1, (int)((centroids[prim][bestAxis] - lo) * scale));
+            return b <= bestSplit;
+        });
+        mid = first + (uint32_t)(split - begin);
+    }
+    else
+    {
+        // all centroids coincide, so split by count to keep leaves small
+        mid = first + count / 2;
+    }
+
+    uint32_t leftIndex = (uint32_t)nodes.size();
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    nodes[nodeIndex].leftOrFirst = leftIndex;
+    nodes[nodeIndex].count = 0;
+    nodes[nodeIndex].axis = bestAxis >= 0 ? bestAxis : 0;
+
+    buildRecursive(leftIndex, primBounds, centroids, first, mid - first, depth + 1, maxLeafSize);
+    buildRecursive(leftIndex + 1, primBounds, centroids, mid, first + count - mid, depth + 1, maxLeafSize);
+}
+
+void BVH::computeStats(double buildTime)
+{
+    stats = BVHStats();
+    stats.numNodes = nodes.size();
+    stats.buildTime = buildTime;
+
+    double rootArea = safeArea(nodes[0].bounds);
+    size_t totalLeafPrims = 0;
+
+    struct Entry
+    {
+        uint32_t node;
+        size_t depth;
+    };
+    std::vector<Entry> stack = {{0, 1}};
+
+    while (!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const BVHNode &node = nodes[entry.node];
+        double relativeArea = rootArea > 0 ? safeArea(node.bounds) / rootArea : 1.0;
+
+        stats.maxDepth = std::max(stats.maxDepth, entry.depth);
+        if (node.isLeaf())
+        {
+            stats.numLeaves++;
+            stats.maxLeafSize = std::max(stats.maxLeafSize, (size_t)node.count);
+            stats.sahCost += INTERSECTION_COST * relativeArea * node.count;
+            totalLeafPrims += node.count;
+        }
+        else
+        {
+            stats.sahCost += TRAVERSAL_COST * relativeArea;
+            stack.push_back({node.leftOrFirst, entry.depth + 1});
+            stack.push_back({node.leftOrFirst + 1, entry.depth + 1});
+        }
+    }
+
+    stats.averageLeafSize = stats.numLeaves > 0 ? (double)totalLeafPrims / stats.numLeaves : 0.0;
+    weightedArea = rootArea > 0 ? stats.sahCost * rootArea : stats.sahCost;
+}
@@ -1,7 +1,7 @@
 #include <algorithm>
 
 #include "BoundingBox.hpp"
-#include "globals.hpp"
+#include "Metrics.hpp"
 
 BoundingBox::BoundingBox() {}
 
@@ -13,10 +13,17 @@ Vec3 BoundingBox::centroid() const
 }
 
 bool BoundingBox::intersect(const Ray &ray, double t_min, double t_max) const
+{
+    double t_entry;
+    return intersect(ray, t_min, t_max, t_entry);
+}
+
+// also reports the distance at which the ray enters the box, for front-to-back traversal
+bool BoundingBox::intersect(const Ray &ray, double t_min, double t_max, double &t_entry) const
 {
     for (int axis = 0; axis < 3; axis++)
     {
-        double invD = 1.0f / ray.direction[axis];
+        double invD = ray.invDirection[axis];
         double t0 = (min[axis] - ray.origin[axis]) * invD;
         double t1 = (max[axis] - ray.origin[axis]) * invD;
         if (invD < 0.0f)
@@ -30,10 +37,60 @@ bool BoundingBox::intersect(const Ray &ray, double t_min, double t_max) const
             return false;
         }
     }
-    numBVIntersections.fetch_add(1);
+    Metrics::countBVIntersection();
+    t_entry = t_min;
     return true;
 }
 
+uint32_t BoundingBox::intersectPacket(const RayPacket &packet, double t_min, uint32_t activeMask, double *t_entry) const
+{
+    // same slab test as intersect, written without branches so it runs on all lanes at once
+    alignas(64) double lo[RayPacket::SIZE], hi[RayPacket::SIZE];
+    const double *origins[3] = {packet.ox, packet.oy, packet.oz};
+    const double *invDirections[3] = {packet.invDx, packet.invDy, packet.invDz};
+
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane)
+    {
+        lo[lane] = t_min;
+        hi[lane] = packet.tMax[lane];
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const double *origin = origins[axis];
+        const double *invD = invDirections[axis];
+        double boxMin = min[axis];
+        double boxMax = max[axis];
+
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane)
+        {
+            double t0 = (boxMin - origin[lane]) * invD[lane];
+            double t1 = (boxMax - origin[lane]) * invD[lane];
+            double tNear = invD[lane] < 0.0 ? t1 : t0;
+            double tFar = invD[lane] < 0.0 ? t0 : t1;
+            lo[lane] = tNear > lo[lane] ? tNear : lo[lane];
+            hi[lane] = tFar < hi[lane] ? tFar : hi[lane];
+        }
+    }
+
+    uint32_t hitMask = 0;
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane)
+    {
+        t_entry[lane] = lo[lane];
+        hitMask |= (uint32_t)(lo[lane] <= hi[lane]) << lane;
+    }
+    hitMask &= activeMask;
+
+    Metrics::increment(Metrics::localShard().bvIntersections, popcount(hitMask));
+    return hitMask;
+}
+
+double BoundingBox::surfaceArea() const
+{
+    Vec3 extent = max - min;
+    return 2.0 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
 BoundingBox BoundingBox::surroundingBox(const BoundingBox &box1, const BoundingBox &box2)
 {
     Vec3 small(
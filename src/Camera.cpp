@@ -30,7 +30,17 @@ Camera::Camera(const Vec3 &origin, const Vec3 &target, const Vec3 &up, double ve
 
 Ray Camera::getRay(double s, double t, double time) const
 {
-    Vec3 rd = lensRadius * util.randomPointInUnitDisk();
+    return getRay(s, t, time, util.randomPointInUnitDisk());
+}
+
+Ray Camera::getRay(double s, double t, double time, const Vec3 &lensPoint) const
+{
+    Vec3 rd = lensRadius * lensPoint;
     Vec3 offset = u * rd.x + v * rd.y;
     return Ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset, time);
-}
\ No newline at end of file
+}
+double Camera::pixelSpreadAngle(int imageHeight) const
+{
+    double focusDistance = (origin - lowerLeftCorner).dot(w);
+    return vertical.length() / (focusDistance * imageHeight);
+}
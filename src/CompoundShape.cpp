@@ -1,42 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "Hittable.hpp"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 CompoundShape::CompoundShape(const std::vector<std::shared_ptr<Triangle>> &tris, const Material *material) : Hittable(material)
 {
+    std::vector<BoundingBox> triangleBounds;
+    triangleBounds.reserve(tris.size());
+
     for (const std::shared_ptr<Triangle> &tri_ptr : tris)
     {
-        triangles.push_back(std::make_shared<Triangle>(*tri_ptr));
+        triangleBounds.push_back(tri_ptr->boundingBox);
     }
+
+    auto localMesh = std::make_shared<TriangleMesh>();
+    BVH binaryBvh;
+    binaryBvh.build(triangleBounds, TriangleStore::LANES);
+    localMesh->bvh.build(binaryBvh);
+
+    // store the triangles in leaf order so every leaf is one contiguous range
+    localMesh->triangles.reserve(tris.size());
+    for (uint32_t index : binaryBvh.primIndices)
+    {
+        localMesh->triangles.add(*tris[index]);
+    }
+
+    localMesh->computeAreaCdf();
+    mesh = localMesh;
     boundingBox = this->calculateBoundingBox();
 }
 
-BoundingBox CompoundShape::calculateBoundingBox() const
+CompoundShape::CompoundShape(std::shared_ptr<const TriangleMesh> sharedMesh, const Material *material) : Hittable(material), mesh(std::move(sharedMesh))
 {
-    if (triangles.empty())
-        return BoundingBox();
+    boundingBox = this->calculateBoundingBox();
+}
 
-    BoundingBox box = triangles[0]->calculateBoundingBox();
-    for (const auto &tri : triangles)
+void TriangleMesh::computeAreaCdf()
+{
+    double area = 0;
+    areaCdf.clear();
+    areaCdf.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
     {
-        box = BoundingBox::surroundingBox(box, tri->calculateBoundingBox());
+        Vec3 v0, e1, e2;
+        triangles.vertexAt(i, 0.0, v0, e1, e2);
+        area += 0.5 * e1.cross(e2).length();
+        areaCdf.push_back(area);
     }
-    return box;
+}
+
+BoundingBox CompoundShape::calculateBoundingBox() const
+{
+    if (mesh->bvh.empty())
+        return BoundingBox();
+
+    return BoundingBox(mesh->bvh.bounds.min + offset, mesh->bvh.bounds.max + offset);
 }
 
 bool CompoundShape::intersect(const Ray &ray, double t_min, double t_max, HitRecord &rec) const
 {
-    bool hitAnything = false;
+    if (!boundingBox.intersect(ray, t_min, t_max))
+        return false;
+
+    // triangles never move, so intersect in local space instead
+    Ray localRay(ray.origin - offset, ray.direction, ray.time);
+    const TriangleStore &triangles = mesh->triangles;
+    int closestIndex = -1;
     double closestT = t_max;
 
-    for (const auto &tri : triangles)
-    {
-        if (tri->intersect(ray, t_min, closestT, rec))
-        {
-            hitAnything = true;
-            closestT = rec.t;
-        }
-    }
+    mesh->bvh.traverseLeaves(localRay, t_min, t_max, [&](uint32_t first, uint32_t count, double tMin, double &leafClosestT) {
+        int index = triangles.intersect(localRay, first, count, tMin, leafClosestT);
+        if (index < 0)
+            return false;
+        closestIndex = index;
+        closestT = leafClosestT;
+        return true;
+    });
 
-    return hitAnything;
+    if (closestIndex < 0)
+        return false;
+
+    triangles.fillHitRecord(localRay, closestIndex, closestT, rec);
+    rec.point += offset;
+    return true;
 }
 
 void CompoundShape::moveTo(const Vec3 &pos)
@@ -53,11 +104,68 @@ Vec3 CompoundShape::normal(const Vec3 &point) const
 
 void CompoundShape::translate(const Vec3 &offset)
 {
-    for (auto &tri : triangles)
-    {
-        tri->translate(offset);
-    }
+    this->offset += offset;
 
     boundingBox.min += offset;
     boundingBox.max += offset;
-}
\ No newline at end of file
+}
+
+std::shared_ptr<Hittable> CompoundShape::clone() const
+{
+    return std::make_shared<CompoundShape>(*this);
+}
+
+bool CompoundShape::sampleDirection(const Vec3 &origin, double time, double u1, double u2, Vec3 &direction, double &distance,
+                                    double &pdf) const
+{
+    const std::vector<double> &cdf = mesh->areaCdf;
+    if (cdf.empty() || cdf.back() <= 0)
+        return false;
+
+    // pick a triangle by area, then reuse what is left of u1 within it
+    double totalArea = cdf.back();
+    double target = u1 * totalArea;
+    size_t index = std::min(cdf.size() - 1, (size_t)(std::upper_bound(cdf.begin(), cdf.end(), target) - cdf.begin()));
+    double start = index > 0 ? cdf[index - 1] : 0.0;
+    double remapped = cdf[index] > start ? (target - start) / (cdf[index] - start) : 0.0;
+
+    Vec3 v0, e1, e2;
+    mesh->triangles.vertexAt(index, time, v0, e1, e2);
+    double s = std::sqrt(remapped);
+    Vec3 point = v0 + e1 * (s * (1.0 - u2)) + e2 * (s * u2) + offset;
+
+    Vec3 toPoint = point - origin;
+    double distanceSquared = toPoint.lengthSquared();
+    distance = std::sqrt(distanceSquared);
+    direction = toPoint / distance;
+    Vec3 normal = e1.cross(e2);
+    double cosine = std::fabs(normal.dot(direction)) / normal.length();
+    if (!(cosine > 1e-8))
+        return false;
+
+    // area pdf 1 / totalArea, converted to solid angle; points hidden behind other faces fail the shadow test,
+    // so directionPdf only has to account for the first face a direction hits
+    pdf = distanceSquared / (cosine * totalArea);
+    return true;
+}
+
+double CompoundShape::directionPdf(const Vec3 &origin, double time, const Vec3 &direction) const
+{
+    const std::vector<double> &cdf = mesh->areaCdf;
+    HitRecord rec;
+    if (cdf.empty() || cdf.back() <= 0 || !intersect(Ray(origin, direction, time), 0.001, std::numeric_limits<double>::infinity(), rec))
+        return 0;
+
+    Vec3 toPoint = rec.point - origin;
+    double distanceSquared = toPoint.lengthSquared();
+    double cosine = std::fabs(rec.normal.dot(toPoint)) / std::sqrt(distanceSquared);
+    return cosine > 1e-8 ? distanceSquared / (cosine * cdf.back()) : 0.0;
+}
+
+double CompoundShape::solidAngle(const Vec3 &origin, double time) const
+{
+    if (mesh->areaCdf.empty())
+        return 0;
+    double distanceSquared = (boundingBox.centroid() - origin).lengthSquared();
+    return std::min(2.0 * M_PI, 0.5 * mesh->areaCdf.back() / std::max(distanceSquared, 1e-12));
+}
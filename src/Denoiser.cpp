@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Denoiser.hpp"
+
+namespace
+{
+    const double KERNEL[3] = {3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0}; // B3 spline, by distance from the center
+    const double MIN_ALBEDO = 0.01; // below this a channel is not divided out, the lighting would blow up
+
+    double luminance(const Vec3 &color)
+    {
+        return 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
+    }
+
+    double channelOrOne(double albedo)
+    {
+        return albedo < MIN_ALBEDO ? 1.0 : albedo;
+    }
+
+    Vec3 clampedAlbedo(const Vec3 &albedo)
+    {
+        return Vec3(channelOrOne(albedo.x), channelOrOne(albedo.y), channelOrOne(albedo.z));
+    }
+}
+
+Denoiser::Denoiser(int width, int height) : width(width), height(height)
+{
+}
+
+void Denoiser::denoise(std::vector<Vec3> &color, const AovBuffers &aovs, ThreadPool &pool)
+{
+    size_t numPixels = (size_t)width * height;
+    for (int i = 0; i < 2; ++i)
+    {
+        lighting[i].resize(numPixels);
+        variance[i].resize(numPixels);
+    }
+    normals.resize(numPixels);
+    depthSlope.resize(numPixels);
+
+    // split off the albedo, and scale the noise estimate the same way
+    pool.parallelFor(height, [&](size_t y, size_t worker) {
+        for (int x = 0; x < width; ++x)
+        {
+            size_t p = y * width + x;
+            Vec3 albedo = clampedAlbedo(aovs.albedo[p]);
+            Vec3 light(color[p].x / albedo.x, color[p].y / albedo.y, color[p].z / albedo.z);
+            lighting[0][p] = light;
+
+            double scale = luminance(color[p]) > 0 ? luminance(light) / luminance(color[p]) : 1.0;
+            double noise = aovs.variance[p];
+            variance[0][p] = std::isfinite(noise) ? noise * scale * scale : noise;
+
+            double length = aovs.normal[p].length();
+            normals[p] = length > 0 ? aovs.normal[p] / length : Vec3(0, 0, 0);
+
+            // largest depth change towards a neighbour on the same surface side
+            double slope = 0;
+            double depth = aovs.depth[p];
+            if (std::isfinite(depth))
+            {
+                const int dx[4] = {-1, 1, 0, 0};
+                const int dy[4] = {0, 0, -1, 1};
+                for (int k = 0; k < 4; ++k)
+                {
+                    int nx = x + dx[k], ny = (int)y + dy[k];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+                    double neighbour = aovs.depth[(size_t)ny * width + nx];
+                    if (std::isfinite(neighbour))
+                        slope = std::max(slope, std::abs(neighbour - depth));
+                }
+            }
+            depthSlope[p] = slope;
+        }
+    });
+
+    int source = 0;
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+    {
+        filterPass(1 << iteration, aovs, source, pool);
+        source = 1 - source;
+    }
+
+    pool.parallelFor(height, [&](size_t y, size_t worker) {
+        for (int x = 0; x < width; ++x)
+        {
+            size_t p = y * width + x;
+            color[p] = lighting[source][p] * clampedAlbedo(aovs.albedo[p]);
+        }
+    });
+}
+
+void Denoiser::filterPass(int step, const AovBuffers &aovs, int source, ThreadPool &pool)
+{
+    const std::vector<Vec3> &in = lighting[source];
+    const std::vector<double> &inVariance = variance[source];
+    std::vector<Vec3> &out = lighting[1 - source];
+    std::vector<double> &outVariance = variance[1 - source];
+
+    pool.parallelFor(height, [&](size_t row, size_t worker) {
+        int y = (int)row;
+        for (int x = 0; x < width; ++x)
+        {
+            size_t p = (size_t)y * width + x;
+
+            // the luminance test uses a 3x3 Gaussian of the noise estimate, one pixel alone is too noisy
+            double blurredVariance = 0, varianceWeight = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qy < 0 || qx >= width || qy >= height)
+                        continue;
+                    double w = (dx == 0 ? 0.5 : 0.25) * (dy == 0 ? 0.5 : 0.25);
+                    blurredVariance += w * inVariance[(size_t)qy * width + qx];
+                    varianceWeight += w;
+                }
+            }
+            double luminanceScale = SIGMA_LUMINANCE * std::sqrt(blurredVariance / varianceWeight) + 1e-10;
+
+            double luminanceP = luminance(in[p]);
+            double depthP = aovs.depth[p];
+            const Vec3 &normalP = normals[p];
+            const Vec3 &albedoP = aovs.albedo[p];
+
+            Vec3 sum(0, 0, 0);
+            double weightSum = 0, varianceSum = 0;
+            for (int dy = -2; dy <= 2; ++dy)
+            {
+                int qy = y + dy * step;
+                if (qy < 0 || qy >= height)
+                    continue;
+                for (int dx = -2; dx <= 2; ++dx)
+                {
+                    int qx = x + dx * step;
+                    if (qx < 0 || qx >= width)
+                        continue;
+                    size_t q = (size_t)qy * width + qx;
+
+                    double weight = KERNEL[std::abs(dx)] * KERNEL[std::abs(dy)];
+                    if (q != p)
+                    {
+                        double depthQ = aovs.depth[q];
+                        double depthWeight;
+                        if (std::isinf(depthP) || std::isinf(depthQ))
+                        {
+                            depthWeight = std::isinf(depthP) && std::isinf(depthQ) ? 1.0 : 0.0;
+                        }
+                        else
+                        {
+                            double distance = step * std::sqrt((double)(dx * dx + dy * dy));
+                            depthWeight = std::exp(-std::abs(depthP - depthQ) / (SIGMA_DEPTH * depthSlope[p] * distance + 1e-3 * depthP));
+                        }
+
+                        double normalWeight = std::pow(std::max(0.0, normalP.dot(normals[q])), SIGMA_NORMAL);
+                        Vec3 albedoDifference = albedoP - aovs.albedo[q];
+                        double albedoWeight = std::exp(-albedoDifference.lengthSquared() / (SIGMA_ALBEDO * SIGMA_ALBEDO));
+                        double luminanceWeight = std::exp(-std::abs(luminanceP - luminance(in[q])) / luminanceScale);
+                        weight *= depthWeight * normalWeight * albedoWeight * luminanceWeight;
+                        if (!(weight > 0))
+                            continue; // also keeps infinite variances out of the sums
+                    }
+
+                    sum += weight * in[q];
+                    weightSum += weight;
+                    varianceSum += weight * weight * inVariance[q];
+                }
+            }
+
+            // the center tap always counts, so weightSum > 0
+            out[p] = sum / weightSum;
+            outVariance[p] = varianceSum / (weightSum * weightSum);
+        }
+    });
+}
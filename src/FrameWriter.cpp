@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef MINGW
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "FrameWriter.hpp"
+#include "Metrics.hpp"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+namespace
+{
+    double clamp(double value, double min, double max)
+    {
+        if (value < min)
+            return min;
+        if (value > max)
+            return max;
+        return value;
+    }
+
+    bool isLittleEndian()
+    {
+        uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+}
+
+ImageFormat ImageEncoding::parseFormat(const std::string &name)
+{
+    if (name == "p3")
+        return ImageFormat::P3;
+    if (name == "p6")
+        return ImageFormat::P6;
+    if (name == "ppm16")
+        return ImageFormat::PPM16;
+    if (name == "pfm")
+        return ImageFormat::PFM;
+    throw std::invalid_argument("Unknown image format: " + name);
+}
+
+const char *ImageEncoding::extension(ImageFormat format)
+{
+    return format == ImageFormat::PFM ? ".pfm" : ".ppm";
+}
+
+std::string ImageEncoding::header(ImageFormat format, int width, int height)
+{
+    std::ostringstream stream;
+    switch (format)
+    {
+    case ImageFormat::P3:
+        stream << "P3\n" << width << " " << height << "\n255\n";
+        break;
+    case ImageFormat::P6:
+        stream << "P6\n" << width << " " << height << "\n255\n";
+        break;
+    case ImageFormat::PPM16:
+        stream << "P6\n" << width << " " << height << "\n65535\n";
+        break;
+    case ImageFormat::PFM:
+        // a negative scale marks little-endian data
+        stream << "PF\n" << width << " " << height << "\n" << (isLittleEndian() ? "-1.0" : "1.0") << "\n";
+        break;
+    }
+    return stream.str();
+}
+
+size_t ImageEncoding::bytesPerPixel(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::P6:
+        return 3;
+    case ImageFormat::PPM16:
+        return 6;
+    case ImageFormat::PFM:
+        return 12;
+    default:
+        return 0;
+    }
+}
+
+void ImageEncoding::encodePixels(ImageFormat format, const Vec3 *pixels, size_t count, uint8_t *out)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vec3 &color = pixels[i];
+
+        if (format == ImageFormat::P6)
+        {
+            out[3 * i + 0] = static_cast<uint8_t>(255.99 * clamp(std::sqrt(color.x), 0.0, 1.0));
+            out[3 * i + 1] = static_cast<uint8_t>(255.99 * clamp(std::sqrt(color.y), 0.0, 1.0));
+            out[3 * i + 2] = static_cast<uint8_t>(255.99 * clamp(std::sqrt(color.z), 0.0, 1.0));
+        }
+        else if (format == ImageFormat::PPM16)
+        {
+            // 16-bit samples are big-endian
+            double channels[3] = {color.x, color.y, color.z};
+            for (int c = 0; c < 3; ++c)
+            {
+                uint16_t value = static_cast<uint16_t>(65535.99 * clamp(std::sqrt(channels[c]), 0.0, 1.0));
+                out[6 * i + 2 * c] = static_cast<uint8_t>(value >> 8);
+                out[6 * i + 2 * c + 1] = static_cast<uint8_t>(value & 0xff);
+            }
+        }
+        else if (format == ImageFormat::PFM)
+        {
+            float channels[3] = {(float)color.x, (float)color.y, (float)color.z};
+            std::memcpy(out + 12 * i, channels, sizeof(channels));
+        }
+    }
+}
+
+std::vector<uint8_t> ImageEncoding::encode(ImageFormat format, const std::vector<Vec3> &pixels, int width, int height)
+{
+    std::string head = header(format, width, height);
+    std::vector<uint8_t> bytes(head.begin(), head.end());
+
+    if (format == ImageFormat::P3)
+    {
+        std::string body;
+        body.reserve(pixels.size() * 12);
+        char line[32];
+        for (const Vec3 &color : pixels)
+        {
+            int ir = static_cast<int>(255.99 * clamp(std::sqrt(color.x), 0.0, 1.0));
+            int ig = static_cast<int>(255.99 * clamp(std::sqrt(color.y), 0.0, 1.0));
+            int ib = static_cast<int>(255.99 * clamp(std::sqrt(color.z), 0.0, 1.0));
+            int length = snprintf(line, sizeof(line), "%d %d %d\n", ir, ig, ib);
+            body.append(line, length);
+        }
+        bytes.insert(bytes.end(), body.begin(), body.end());
+        return bytes;
+    }
+
+    size_t rowBytes = bytesPerPixel(format) * width;
+    bytes.resize(head.size() + rowBytes * height);
+    for (int y = 0; y < height; ++y)
+    {
+        // PFM stores the bottom row first
+        int fileRow = format == ImageFormat::PFM ? height - 1 - y : y;
+        encodePixels(format, &pixels[(size_t)y * width], width, &bytes[head.size() + rowBytes * fileRow]);
+    }
+    return bytes;
+}
+
+std::vector<uint8_t> ImageEncoding::encodeCounts(const std::vector<uint32_t> &counts, int width, int height)
+{
+    uint32_t maxCount = 1;
+    for (uint32_t count : counts)
+    {
+        maxCount = std::max(maxCount, count);
+    }
+    // counts are stored as-is when they fit in 16 bits
+    uint32_t maxValue = std::min<uint32_t>(maxCount, 65535);
+
+    std::ostringstream stream;
+    stream << "P5\n" << width << " " << height << "\n" << maxValue << "\n";
+    std::string head = stream.str();
+    std::vector<uint8_t> bytes(head.begin(), head.end());
+    bytes.reserve(head.size() + 2 * counts.size());
+
+    for (size_t i = 0; i < (size_t)width * height; ++i)
+    {
+        uint32_t value = maxCount <= 65535 ? counts[i] : (uint32_t)((uint64_t)counts[i] * 65535 / maxCount);
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+        bytes.push_back(static_cast<uint8_t>(value & 0xff));
+    }
+    return bytes;
+}
+
+FrameWriter::FrameWriter(ImageFormat format, int width, int height, int numBuffers)
+    : format(format), width(width), height(height), buffers(numBuffers), bufferBusy(numBuffers, false)
+{
+    for (auto &buffer : buffers)
+    {
+        buffer.resize((size_t)width * height);
+    }
+    thread = std::thread(&FrameWriter::ioLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobCondition.notify_all();
+    thread.join();
+}
+
+std::vector<Vec3> &FrameWriter::acquireBuffer(double &waitTime)
+{
+    Stopwatch timer;
+    std::unique_lock<std::mutex> lock(mutex);
+    freeCondition.wait(lock, [this] { return freeBuffer() >= 0 || !error.empty(); });
+    if (!error.empty())
+        throw std::runtime_error(error);
+
+    int index = freeBuffer();
+    bufferBusy[index] = true;
+    waitTime = timer.elapsed();
+    return buffers[index];
+}
+
+void FrameWriter::submit(std::vector<Vec3> &buffer, const std::string &path)
+{
+    int index = (int)(&buffer - buffers.data());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({index, path});
+    }
+    jobCondition.notify_one();
+}
+
+void FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    freeCondition.wait(lock, [this] {
+        return (jobs.empty() && std::find(bufferBusy.begin(), bufferBusy.end(), true) == bufferBusy.end()) || !error.empty();
+    });
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
+
+int FrameWriter::freeBuffer() const
+{
+    for (size_t i = 0; i < bufferBusy.size(); ++i)
+    {
+        if (!bufferBusy[i])
+            return (int)i;
+    }
+    return -1;
+}
+
+void FrameWriter::ioLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return; // stopping, and everything has been written
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        std::vector<uint8_t> bytes = ImageEncoding::encode(format, buffers[job.buffer], width, height);
+        std::ofstream file(job.path, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        file.close();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!file)
+                error = "Could not write frame: " + job.path;
+            bufferBusy[job.buffer] = false;
+        }
+        freeCondition.notify_all();
+    }
+}
+
+TileStreamWriter::TileStreamWriter(ImageFormat format, const std::string &path, int width, int height)
+    : format(format), width(width), height(height)
+{
+    if (format == ImageFormat::P3)
+        throw std::invalid_argument("Tile streaming needs a fixed-size binary format (p6, ppm16 or pfm)");
+
+    std::string head = ImageEncoding::header(format, width, height);
+    headerSize = head.size();
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    if (fd < 0)
+        throw std::runtime_error("Could not open frame: " + path);
+
+    // size the file up front so tiles can land anywhere in it
+    size_t fileSize = headerSize + ImageEncoding::bytesPerPixel(format) * width * height;
+    if (ftruncate(fd, (off_t)fileSize) != 0 || !writeAt(reinterpret_cast<const uint8_t *>(head.data()), head.size(), 0))
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not allocate frame: " + path);
+    }
+}
+
+TileStreamWriter::~TileStreamWriter()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+void TileStreamWriter::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    if (failed)
+        throw std::runtime_error("Could not write every tile of the frame");
+}
+
+void TileStreamWriter::writeTile(int x0, int y0, int tileWidth, int tileHeight, const Vec3 *pixels)
+{
+    size_t pixelBytes = ImageEncoding::bytesPerPixel(format);
+    std::vector<uint8_t> row(pixelBytes * tileWidth);
+
+    for (int y = y0; y < y0 + tileHeight; ++y)
+    {
+        ImageEncoding::encodePixels(format, pixels + (size_t)(y - y0) * tileWidth, tileWidth, row.data());
+        int fileRow = format == ImageFormat::PFM ? height - 1 - y : y;
+        if (!writeAt(row.data(), row.size(), headerSize + pixelBytes * ((size_t)fileRow * width + x0)))
+            failed = true;
+    }
+}
+
+bool TileStreamWriter::writeAt(const uint8_t *data, size_t size, size_t offset)
+{
+#ifdef MINGW
+    std::lock_guard<std::mutex> lock(mutex);
+    return lseek(fd, (off_t)offset, SEEK_SET) >= 0 && write(fd, data, size) == (int)size;
+#else
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, data, size, (off_t)offset);
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "globals.hpp"
+#include "Integrator.hpp"
+#include "Material.hpp"
+#include "Metrics.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+Integrator::Integrator(int minDepth, int maxDepth, bool nextEventEstimation)
+    : minDepth(minDepth), maxDepth(maxDepth), nextEventEstimation(nextEventEstimation) {}
+
+Vec3 Integrator::radiance(const Ray &ray, const World &world, int &pathLength, FirstHit *firstHit) const
+{
+    HitRecord rec;
+    bool hit = world.intersect(ray, 0.001, std::numeric_limits<double>::infinity(), rec);
+    return radiance(ray, world, hit, rec, pathLength, firstHit);
+}
+
+Vec3 Integrator::radiance(const Ray &ray, const World &world, bool primaryHit, const HitRecord &primaryRec, int &pathLength,
+                          FirstHit *firstHit) const
+{
+    if (firstHit)
+        this->firstHit(ray, world, primaryHit, primaryRec, *firstHit);
+
+    Path path;
+    path.ray = ray;
+    pathLength = 0;
+
+    for (int bounce = 0; bounce < maxDepth; ++bounce)
+    {
+        util.beginBounce(bounce);
+        pathLength++;
+
+        HitRecord rec = primaryRec;
+        bool hit = bounce == 0 ? primaryHit : world.intersect(path.ray, 0.001, std::numeric_limits<double>::infinity(), rec);
+        if (!hit)
+        {
+            miss(path, world);
+            return path.result;
+        }
+
+        LightSample light;
+        bool alive = shade(world, bounce, rec, path, light);
+        if (light.light)
+            traceShadow(world, light, path);
+        if (!alive)
+            return path.result;
+    }
+
+    exhaust(path, world);
+    return path.result;
+}
+
+void Integrator::firstHit(const Ray &ray, const World &world, bool hit, const HitRecord &rec, FirstHit &out) const
+{
+    if (hit)
+    {
+        HitRecord firstRec = rec;
+        firstRec.footprint = surfaceFootprint(pixelSpread * rec.t * ray.direction.length(), rec, ray.direction);
+        out.albedo = MaterialDispatch::baseColor(rec.material, firstRec);
+        out.normal = rec.normal;
+        out.depth = rec.t * ray.direction.length();
+    }
+    else
+    {
+        out.albedo = sky(ray, world.sky());
+        out.normal = -ray.direction.normalize();
+        out.depth = std::numeric_limits<double>::infinity();
+    }
+}
+
+void Integrator::miss(Path &path, const World &world) const
+{
+    path.result = path.result + path.throughput * sky(path.ray, world.sky());
+}
+
+void Integrator::exhaust(Path &path, const World &world) const
+{
+    // paths that reach maxDepth see the top sky color
+    path.result = path.result + path.throughput * world.sky().top;
+}
+
+bool Integrator::shade(const World &world, int bounce, HitRecord &rec, Path &path, LightSample &light) const
+{
+    const Ray &current = path.ray;
+    Metrics::countObjectIntersection();
+    path.coneWidth += pixelSpread * rec.t * current.direction.length();
+    rec.footprint = surfaceFootprint(path.coneWidth, rec, current.direction);
+
+    if (rec.material->emissive)
+    {
+        // a light that was also sampled at the previous vertex only gets its MIS share
+        double weight = 1.0;
+        if (path.scatterPdf > 0)
+            weight = powerHeuristic(path.scatterPdf, world.lightPdf(rec.object, current.origin, current.time, current.direction));
+        path.result = path.result + path.throughput * MaterialDispatch::emitted(rec.material, rec.point) * weight;
+        return false;
+    }
+
+    util.useDimensions(SampleLayout::LOBE);
+    const Material *material = MaterialDispatch::resolve(rec.material);
+    Vec3 attenuation;
+    Ray scattered;
+    Vec3 albedo;
+    if (nextEventEstimation && MaterialDispatch::diffuseAlbedo(material, rec, albedo))
+    {
+        util.useDimensions(SampleLayout::LIGHT);
+        sampleDirectLight(world, current, rec, albedo, path.throughput, light);
+
+        // cosine-weighted, so the pdf is known for MIS; f * cos / pdf is the albedo
+        util.useDimensions(SampleLayout::SCATTER);
+        Vec3 direction = rec.normal + util.randomUnitVector();
+        direction = direction.lengthSquared() > 1e-12 ? direction.normalize() : rec.normal;
+        scattered = Ray(rec.point, direction, current.time);
+        attenuation = albedo;
+        path.scatterPdf = rec.normal.dot(direction) / M_PI;
+    }
+    else
+    {
+        util.useDimensions(SampleLayout::SCATTER);
+        if (!MaterialDispatch::scatter(material, current, rec, attenuation, scattered))
+        {
+            return false; // no scattering or emission
+        }
+        path.scatterPdf = 0;
+    }
+
+    path.throughput = path.throughput * attenuation;
+    path.ray = scattered;
+
+    // not on the last bounce: the path ends there anyway, so minDepth == maxDepth turns roulette off
+    if (bounce + 1 >= minDepth && bounce + 1 < maxDepth)
+    {
+        double survival = std::min(MAX_SURVIVAL_PROBABILITY, std::max({path.throughput.x, path.throughput.y, path.throughput.z}));
+        util.useDimensions(SampleLayout::ROULETTE);
+        if (util.randomDouble() >= survival)
+        {
+            return false;
+        }
+        path.throughput = path.throughput / survival;
+    }
+    return true;
+}
+
+void Integrator::sampleDirectLight(const World &world, const Ray &ray, const HitRecord &rec, const Vec3 &albedo,
+                                   const Vec3 &throughput, LightSample &light) const
+{
+    double u0 = util.randomDouble();
+    double u1 = util.randomDouble();
+    double u2 = util.randomDouble();
+
+    Vec3 direction;
+    double distance, lightPdf;
+    const Hittable *sampled;
+    if (!world.sampleLight(rec.point, ray.time, u0, u1, u2, direction, distance, lightPdf, sampled))
+        return;
+
+    double cosine = rec.normal.dot(direction);
+    if (cosine <= 0)
+        return;
+
+    double scatterPdf = cosine / M_PI;
+    light.shadowRay = Ray(rec.point, direction, ray.time);
+    light.distance = distance;
+    light.light = sampled;
+    light.throughput = throughput;
+    light.albedo = albedo;
+    light.weight = scatterPdf / lightPdf * powerHeuristic(lightPdf, scatterPdf);
+}
+
+void Integrator::traceShadow(const World &world, const LightSample &light, Path &path) const
+{
+    // the light counts only if nothing, including another light or another part of it, is in front of the
+    // sampled point; anything else would count the light at a point whose pdf lightPdf does not describe
+    HitRecord shadowRec;
+    double tolerance = SHADOW_DISTANCE_TOLERANCE * light.distance;
+    if (!world.intersect(light.shadowRay, 0.001, light.distance + tolerance, shadowRec) || shadowRec.object != light.light ||
+        shadowRec.t < light.distance - tolerance)
+        return;
+
+    // f * cos / pdf with the Lambertian f = albedo / pi
+    path.result += light.throughput * (light.albedo * MaterialDispatch::emitted(shadowRec.material, shadowRec.point) * light.weight);
+}
+
+double Integrator::powerHeuristic(double a, double b)
+{
+    return a * a / (a * a + b * b);
+}
+
+double Integrator::surfaceFootprint(double coneWidth, const HitRecord &rec, const Vec3 &direction)
+{
+    double cosine = std::abs(rec.normal.dot(direction)) / direction.length();
+    return coneWidth / std::sqrt(std::max(cosine, MIN_FOOTPRINT_COSINE));
+}
+
+Vec3 Integrator::sky(const Ray &ray, const Sky &sky)
+{
+    // gradient sky
+    Vec3 unitDirection = ray.direction.normalize();
+    double t = 0.5 * (unitDirection.y + 1.0);
+    return (1.0 - t) * sky.bottom + t * sky.top;
+}
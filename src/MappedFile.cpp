@@ -0,0 +1,158 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef MINGW
+#include <iterator>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.hpp"
+
+namespace
+{
+    [[noreturn]] void fail(const std::string &filename)
+    {
+        std::stringstream errorMsg;
+        errorMsg << "Filepath does not exist: " << filename << ". Please ensure given path is relative to program execution location.";
+        throw std::runtime_error(errorMsg.str());
+    }
+
+    uint64_t fmix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    int processId()
+    {
+#ifdef MINGW
+        return _getpid();
+#else
+        return (int)getpid();
+#endif
+    }
+}
+
+MappedFile::MappedFile(const std::string &filename)
+{
+#ifdef MINGW
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile.is_open())
+        fail(filename);
+    contents.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+    begin = contents.data();
+    length = contents.size();
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        fail(filename);
+    }
+
+    length = (size_t)info.st_size;
+    if (length > 0)
+    {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Could not map " + filename);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char *>(mapping);
+    }
+    close(fd); // the mapping stays valid
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef MINGW
+    if (begin)
+        munmap(const_cast<char *>(begin), length);
+#endif
+}
+
+uint64_t MappedFile::hash() const
+{
+    // one multiply-rotate step per 8-byte word
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, begin + i, sizeof(word));
+        h ^= word * 0x87c37b91114253d5ull;
+        h = ((h << 31) | (h >> 33)) * 0x4cf5ad432745937full;
+    }
+    uint64_t tail = 0;
+    if (i < length)
+        std::memcpy(&tail, begin + i, length - i);
+    return fmix(h ^ tail * 0x87c37b91114253d5ull);
+}
+
+bool FileStamp::read(const std::string &path, FileStamp &stamp)
+{
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    if (error)
+        return false;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+    stamp.size = size;
+    stamp.time = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+std::string cachePathFor(const std::string &sourcePath, const std::string &cacheDir, const std::string &extension)
+{
+    std::filesystem::path source(sourcePath);
+    std::string name = source.filename().string() + "." + extension;
+    if (cacheDir.empty())
+        return (source.parent_path() / name).string();
+    return (std::filesystem::path(cacheDir) / name).string();
+}
+
+bool replaceFile(const std::string &path, const void *data, size_t size)
+{
+    std::error_code error;
+    std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), error);
+
+    std::string temporaryPath = path + ".tmp" + std::to_string(processId());
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write(static_cast<const char *>(data), size);
+        if (!out)
+        {
+            out.close();
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, target, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "BVH.hpp"
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "TriangleStore.hpp"
+
+namespace
+{
+    const char MAGIC[8] = {'R', 'T', 'M', 'E', 'S', 'H', 0, 0};
+    const uint32_t BYTE_ORDER_MARK = 0x01020304u;
+    const size_t SECTION_ALIGNMENT = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        // layout of the build that wrote the file
+        uint32_t vertexSize;
+        uint32_t nodeSize;
+        uint32_t bvhWidth;
+        uint32_t triangleLanes;
+        // source mesh
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        // its material library, all 0 if it names none
+        uint64_t materialSize;
+        int64_t materialTime;
+        uint64_t materialHash;
+        // sections, offsets from the start of the file
+        uint64_t numVertices, verticesOffset;
+        uint64_t numIndices, indicesOffset;
+        uint64_t numNodes, nodesOffset;
+        uint64_t diffuseMapLength, diffuseMapOffset;
+        uint64_t materialLibraryLength, materialLibraryOffset;
+        double boundsMin[3], boundsMax[3]; // exact root bounds
+    };
+
+    uint64_t alignUp(uint64_t offset)
+    {
+        return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+
+    bool sectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize)
+    {
+        return offset % SECTION_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+    }
+
+    /**
+     * Whether the file at path is the one recorded by size, time and hash.
+     * Sets refresh if only its time changed, so the cache should be rewritten
+     * with the new one.
+    */
+    bool sameFile(const std::string &path, uint64_t size, int64_t time, uint64_t hash, bool &refresh)
+    {
+        FileStamp stamp;
+        if (!FileStamp::read(path, stamp) || stamp.size != size)
+            return false;
+        if (stamp.time == time)
+            return true;
+        // touched or checked out again; the contents decide
+        if (MappedFile(path).hash() != hash)
+            return false;
+        refresh = true;
+        return true;
+    }
+
+    // path relative to the source's directory, so the cache stays valid from any working directory
+    std::string relativeToSource(const std::string &path, const std::string &sourcePath)
+    {
+        if (path.empty())
+            return path;
+        return std::filesystem::path(path).lexically_relative(std::filesystem::path(sourcePath).parent_path()).string();
+    }
+
+    std::string fromSource(const char *relative, uint64_t length, const std::string &sourcePath)
+    {
+        if (length == 0)
+            return std::string();
+        return (std::filesystem::path(sourcePath).parent_path() / std::string(relative, length)).string();
+    }
+
+    /**
+     * Every index and child reference stays inside its buffer, so a damaged
+     * cache cannot be read out of bounds. Interior children must come after
+     * their parent, as collapse() writes them, which rules out cycles, and no
+     * node may be deeper than the traversal stack allows.
+    */
+    bool referencesValid(const MeshData &mesh)
+    {
+        size_t numVertices = mesh.vertices.size();
+        for (uint32_t index : mesh.indices)
+        {
+            if (index >= numVertices)
+                return false;
+        }
+
+        size_t numNodes = mesh.bvh.nodes.size();
+        size_t numTriangles = mesh.indices.size() / 3;
+        // depth of each node, the root being 1; final by the time a node is reached since all its parents come first
+        std::vector<int> depth(numNodes, 0);
+        if (numNodes > 0)
+            depth[0] = 1;
+        for (size_t index = 0; index < numNodes; ++index)
+        {
+            const WideBVHNode &node = mesh.bvh.nodes[index];
+            if (node.numChildren > WideBVHNode::WIDTH || depth[index] == 0 || depth[index] > BVH::MAX_STACK_DEPTH)
+                return false;
+            for (int i = 0; i < node.numChildren; ++i)
+            {
+                if (node.count[i] > 0)
+                {
+                    if ((size_t)node.child[i] + node.count[i] > numTriangles)
+                        return false;
+                    continue;
+                }
+                if (node.child[i] <= index || node.child[i] >= numNodes)
+                    return false;
+                depth[node.child[i]] = std::max(depth[node.child[i]], depth[index] + 1);
+            }
+        }
+        return true;
+    }
+}
+
+MeshData MeshData::build(const Object &object)
+{
+    MeshData mesh;
+    mesh.vertices = object.vertices;
+    mesh.diffuseMap = object.mapKdPPMFilePath;
+    mesh.materialLibrary = object.mtlFilePath;
+
+    size_t numTriangles = object.numTriangles();
+    auto position = [&](unsigned int index) {
+        const Vertex &v = object.vertices[index];
+        return Vec3(v.x, v.y, v.z);
+    };
+
+    std::vector<BoundingBox> triangleBounds;
+    triangleBounds.reserve(numTriangles);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        Vec3 a = position(object.indices[3 * i]);
+        Vec3 b = position(object.indices[3 * i + 1]);
+        Vec3 c = position(object.indices[3 * i + 2]);
+        triangleBounds.emplace_back(Vec3(std::min({a.x, b.x, c.x}), std::min({a.y, b.y, c.y}), std::min({a.z, b.z, c.z})),
+                                    Vec3(std::max({a.x, b.x, c.x}), std::max({a.y, b.y, c.y}), std::max({a.z, b.z, c.z})));
+    }
+
+    BVH binaryBvh;
+    binaryBvh.build(triangleBounds, TriangleStore::LANES);
+    mesh.bvh.build(binaryBvh);
+
+    // triangles in leaf order, so every leaf is one contiguous range
+    mesh.indices.reserve(3 * numTriangles);
+    for (uint32_t triangle : binaryBvh.primIndices)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            mesh.indices.push_back(object.indices[3 * triangle + k]);
+        }
+    }
+    return mesh;
+}
+
+std::shared_ptr<TriangleMesh> MeshData::toTriangleMesh(const Material *material, bool textured) const
+{
+    auto mesh = std::make_shared<TriangleMesh>();
+    size_t numTriangles = indices.size() / 3;
+    mesh->triangles.reserve(numTriangles);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        const Vertex &a = vertices[indices[3 * i]];
+        const Vertex &b = vertices[indices[3 * i + 1]];
+        const Vertex &c = vertices[indices[3 * i + 2]];
+        if (textured)
+        {
+            const float texcoords[6] = {a.s, a.t, b.s, b.t, c.s, c.t};
+            mesh->triangles.add(Vec3(a.x, a.y, a.z), Vec3(b.x, b.y, b.z), Vec3(c.x, c.y, c.z), material, texcoords);
+        }
+        else
+        {
+            mesh->triangles.add(Vec3(a.x, a.y, a.z), Vec3(b.x, b.y, b.z), Vec3(c.x, c.y, c.z), material);
+        }
+    }
+    mesh->bvh = bvh;
+    mesh->computeAreaCdf();
+    return mesh;
+}
+
+std::string MeshCache::pathFor(const std::string &sourcePath, const std::string &cacheDir)
+{
+    return cachePathFor(sourcePath, cacheDir, "meshcache");
+}
+
+bool MeshCache::load(const std::string &sourcePath, const std::string &cachePath, MeshData &mesh)
+{
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cachePath, error))
+        return false;
+
+    bool refresh = false;
+    try
+    {
+        MappedFile file(cachePath);
+        Header header;
+        if (file.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+            header.byteOrder != BYTE_ORDER_MARK || header.vertexSize != sizeof(Vertex) ||
+            header.nodeSize != sizeof(WideBVHNode) || header.bvhWidth != WideBVH::WIDTH ||
+            header.triangleLanes != TriangleStore::LANES)
+            return false;
+        if (!sameFile(sourcePath, header.sourceSize, header.sourceTime, header.sourceHash, refresh))
+            return false;
+
+        if (header.numIndices % 3 != 0 ||
+            !sectionFits(header.verticesOffset, header.numVertices, sizeof(Vertex), file.size()) ||
+            !sectionFits(header.indicesOffset, header.numIndices, sizeof(uint32_t), file.size()) ||
+            !sectionFits(header.nodesOffset, header.numNodes, sizeof(WideBVHNode), file.size()) ||
+            !sectionFits(header.diffuseMapOffset, header.diffuseMapLength, 1, file.size()) ||
+            !sectionFits(header.materialLibraryOffset, header.materialLibraryLength, 1, file.size()))
+            return false;
+
+        // the diffuse map comes from the material library, so a changed library is a changed mesh
+        const char *data = file.data();
+        std::string materialLibrary = fromSource(data + header.materialLibraryOffset, header.materialLibraryLength, sourcePath);
+        if (!materialLibrary.empty() &&
+            !sameFile(materialLibrary, header.materialSize, header.materialTime, header.materialHash, refresh))
+            return false;
+
+        const Vertex *vertices = reinterpret_cast<const Vertex *>(data + header.verticesOffset);
+        const uint32_t *indices = reinterpret_cast<const uint32_t *>(data + header.indicesOffset);
+        const WideBVHNode *nodes = reinterpret_cast<const WideBVHNode *>(data + header.nodesOffset);
+        mesh.vertices.assign(vertices, vertices + header.numVertices);
+        mesh.indices.assign(indices, indices + header.numIndices);
+        mesh.bvh.nodes.assign(nodes, nodes + header.numNodes);
+        mesh.diffuseMap = fromSource(data + header.diffuseMapOffset, header.diffuseMapLength, sourcePath);
+        mesh.materialLibrary = materialLibrary;
+        mesh.bvh.bounds = BoundingBox(Vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                                      Vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+    }
+    catch (const std::runtime_error &e)
+    {
+        return false;
+    }
+
+    if (!referencesValid(mesh))
+    {
+        mesh = MeshData();
+        return false;
+    }
+    if (refresh)
+        save(sourcePath, cachePath, mesh);
+    return true;
+}
+
+bool MeshCache::save(const std::string &sourcePath, const std::string &cachePath, const MeshData &mesh)
+{
+    FileStamp source;
+    if (!FileStamp::read(sourcePath, source))
+        return false;
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.vertexSize = sizeof(Vertex);
+    header.nodeSize = sizeof(WideBVHNode);
+    header.bvhWidth = WideBVH::WIDTH;
+    header.triangleLanes = TriangleStore::LANES;
+    header.sourceSize = source.size;
+    header.sourceTime = source.time;
+    try
+    {
+        header.sourceHash = MappedFile(sourcePath).hash();
+        FileStamp material;
+        if (!mesh.materialLibrary.empty())
+        {
+            if (!FileStamp::read(mesh.materialLibrary, material))
+                return false;
+            header.materialSize = material.size;
+            header.materialTime = material.time;
+            header.materialHash = MappedFile(mesh.materialLibrary).hash();
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        return false;
+    }
+
+    header.numVertices = mesh.vertices.size();
+    header.verticesOffset = alignUp(sizeof(Header));
+    header.numIndices = mesh.indices.size();
+    header.indicesOffset = alignUp(header.verticesOffset + header.numVertices * sizeof(Vertex));
+    header.numNodes = mesh.bvh.nodes.size();
+    header.nodesOffset = alignUp(header.indicesOffset + header.numIndices * sizeof(uint32_t));
+    std::string diffuseMap = relativeToSource(mesh.diffuseMap, sourcePath);
+    header.diffuseMapLength = diffuseMap.size();
+    header.diffuseMapOffset = alignUp(header.nodesOffset + header.numNodes * sizeof(WideBVHNode));
+    std::string materialLibrary = relativeToSource(mesh.materialLibrary, sourcePath);
+    header.materialLibraryLength = materialLibrary.size();
+    header.materialLibraryOffset = alignUp(header.diffuseMapOffset + header.diffuseMapLength);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        header.boundsMin[axis] = mesh.bvh.bounds.min[axis];
+        header.boundsMax[axis] = mesh.bvh.bounds.max[axis];
+    }
+    uint64_t fileSize = header.materialLibraryOffset + header.materialLibraryLength;
+
+    std::vector<char> bytes(fileSize, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + header.verticesOffset, mesh.vertices.data(), header.numVertices * sizeof(Vertex));
+    std::memcpy(bytes.data() + header.indicesOffset, mesh.indices.data(), header.numIndices * sizeof(uint32_t));
+    std::memcpy(bytes.data() + header.nodesOffset, mesh.bvh.nodes.data(), header.numNodes * sizeof(WideBVHNode));
+    std::memcpy(bytes.data() + header.diffuseMapOffset, diffuseMap.data(), diffuseMap.size());
+    std::memcpy(bytes.data() + header.materialLibraryOffset, materialLibrary.data(), materialLibrary.size());
+
+    return replaceFile(cachePath, bytes.data(), bytes.size());
+}
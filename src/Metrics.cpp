@@ -0,0 +1,141 @@
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Metrics.hpp"
+
+namespace
+{
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<MetricsShard>> registry;
+    thread_local MetricsShard *shard = nullptr;
+}
+
+MetricsShard &Metrics::localShard()
+{
+    if (shard == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<MetricsShard>());
+        shard = registry.back().get();
+    }
+    return *shard;
+}
+
+MetricsTotals Metrics::collect()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    MetricsTotals totals;
+    for (const auto &s : registry)
+    {
+        totals.rays += s->rays.load(std::memory_order_relaxed);
+        totals.bvIntersections += s->bvIntersections.load(std::memory_order_relaxed);
+        totals.objectIntersections += s->objectIntersections.load(std::memory_order_relaxed);
+        totals.pathSegments += s->pathSegments.load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+void Metrics::reset()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto &s : registry)
+    {
+        s->rays.store(0, std::memory_order_relaxed);
+        s->bvIntersections.store(0, std::memory_order_relaxed);
+        s->objectIntersections.store(0, std::memory_order_relaxed);
+        s->pathSegments.store(0, std::memory_order_relaxed);
+    }
+}
+
+void FrameReport::print() const
+{
+    printf("Metrics\n-------\n");
+    printf("Render Time                     : %04.2f (sec)\n", renderTime);
+    if (batchFrames > 1)
+        printf("Frames Rendered Together        : %d (times and counts are for all of them)\n", batchFrames);
+    printf("Load / Build / Write Time       : %04.2f / %04.2f / %04.2f (sec)\n", loadTime, buildTime, writeTime);
+    printf("Throughput                      : %04.2f (MRays/sec)\n", megaRaysPerSecond());
+    printf("Rays Cast                       : %lu\n", (unsigned long)counters.rays);
+    printf("Samples Per Pixel (Avg / Max)   : %04.2f / %d\n", averageSamplesPerPixel(), maxSamplesPerPixel);
+    if (passes > 1)
+        printf("Progressive Passes (Noise)      : %d (%04.4f)\n", passes, noise);
+    printf("Bounding Volume Intersections   : %lu\n", (unsigned long)counters.bvIntersections);
+    printf("Successful Object Intersections : %lu\n", (unsigned long)counters.objectIntersections);
+    printf("Average Path Length             : %04.2f\n", averagePathLength());
+    printf("BVH Nodes (Leaves)              : %lu (%lu)\n", (unsigned long)bvhStats.numNodes, (unsigned long)bvhStats.numLeaves);
+    printf("BVH Max Depth                   : %lu\n", (unsigned long)bvhStats.maxDepth);
+    printf("BVH Avg Leaf Size               : %04.2f\n", bvhStats.averageLeafSize);
+    printf("BVH SAH Cost                    : %04.2f\n", bvhStats.sahCost);
+    printf("BVH Build Time                  : %04.4f (sec)\n", bvhStats.buildTime);
+    printf("BVH Refits Since Build          : %lu\n", (unsigned long)bvhStats.refits);
+    printf("----------------------------------------------\n");
+}
+
+ReportWriter::Format ReportWriter::parseFormat(const std::string &name)
+{
+    if (name == "json")
+        return Format::Json;
+    if (name == "csv")
+        return Format::Csv;
+    if (name == "none")
+        return Format::None;
+    throw std::invalid_argument("Unknown report format: " + name);
+}
+
+ReportWriter::ReportWriter(Format format, const std::string &path) : format(format)
+{
+    if (format == Format::None)
+        return;
+
+    file.open(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open report file: " + path);
+    }
+
+    if (format == Format::Csv)
+    {
+        file << "frame,width,height,spp,threads,load_s,build_s,render_s,write_s,total_s,mrays_per_s,"
+             << "rays,bv_intersections,object_intersections,avg_path_length,bvh_nodes,bvh_leaves,bvh_max_depth,bvh_sah_cost,passes,noise,batch_frames\n";
+    }
+}
+
+void ReportWriter::write(const FrameReport &report)
+{
+    if (format == Format::None)
+        return;
+
+    char line[1024];
+    const MetricsTotals &c = report.counters;
+    const BVHStats &b = report.bvhStats;
+
+    if (format == Format::Json)
+    {
+        snprintf(line, sizeof(line),
+                 "{\"frame\":%d,\"width\":%d,\"height\":%d,\"spp\":%d,\"threads\":%lu,"
+                 "\"load_s\":%.6f,\"build_s\":%.6f,\"render_s\":%.6f,\"write_s\":%.6f,\"total_s\":%.6f,"
+                 "\"mrays_per_s\":%.4f,\"rays\":%lu,\"bv_intersections\":%lu,\"object_intersections\":%lu,\"avg_path_length\":%.4f,"
+                 "\"bvh_nodes\":%lu,\"bvh_leaves\":%lu,\"bvh_max_depth\":%lu,\"bvh_sah_cost\":%.4f,\"passes\":%d,\"noise\":%.6f,\"batch_frames\":%d}\n",
+                 report.frame, report.imageWidth, report.imageHeight, report.samplesPerPixel, (unsigned long)report.numThreads,
+                 report.loadTime, report.buildTime, report.renderTime, report.writeTime, report.totalTime(),
+                 report.megaRaysPerSecond(), (unsigned long)c.rays, (unsigned long)c.bvIntersections, (unsigned long)c.objectIntersections, report.averagePathLength(),
+                 (unsigned long)b.numNodes, (unsigned long)b.numLeaves, (unsigned long)b.maxDepth, b.sahCost, report.passes, report.noise,
+                 report.batchFrames);
+    }
+    else
+    {
+        snprintf(line, sizeof(line),
+                 "%d,%d,%d,%d,%lu,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f,%lu,%lu,%lu,%.4f,%lu,%lu,%lu,%.4f,%d,%.6f,%d\n",
+                 report.frame, report.imageWidth, report.imageHeight, report.samplesPerPixel, (unsigned long)report.numThreads,
+                 report.loadTime, report.buildTime, report.renderTime, report.writeTime, report.totalTime(),
+                 report.megaRaysPerSecond(), (unsigned long)c.rays, (unsigned long)c.bvIntersections, (unsigned long)c.objectIntersections, report.averagePathLength(),
+                 (unsigned long)b.numNodes, (unsigned long)b.numLeaves, (unsigned long)b.maxDepth, b.sahCost, report.passes, report.noise,
+                 report.batchFrames);
+    }
+
+    file << line;
+    file.flush();
+}
@@ -1,134 +1,325 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "MappedFile.hpp"
 #include "Object.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+    const size_t MIN_CHUNK_BYTES = 64 * 1024;
+    const size_t CHUNKS_PER_THREAD = 4; // so a thread that is done early can steal
+    const uint32_t NO_INDEX = 0xffffffffu;
+
+    // indices of a face corner into the position, texture coordinate and normal lists
+    struct Corner {
+        int64_t index[3];  // NO_INDEX if not given
+        uint8_t chunkLocal; // bit k: index[k] counts from the chunk's first entry (negative .obj indices)
+    };
+
+    // one line-aligned part of the file and what was parsed from it
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        std::vector<float> positions; // 3 per entry
+        std::vector<float> texcoords; // 2 per entry
+        std::vector<float> normals; // 3 per entry
+        std::vector<Corner> corners; // 3 per triangle
+        std::string materialLibrary; // first mtllib file name
+        std::string error;
+    };
+
+    const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        return p;
+    }
+
+    bool parseFloat(const char*& p, const char* end, float& value) {
+        p = skipSpaces(p, end);
+        if (p < end && *p == '+') { // from_chars takes no plus sign
+            p++;
+        }
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+        return true;
+    }
+
+    // parses numbers into values until the line ends; false if there are fewer than required
+    bool parseFloats(const char*& p, const char* end, float* values, int required, int count) {
+        for (int i = 0; i < count; i++) {
+            values[i] = 0;
+        }
+        for (int i = 0; i < count; i++) {
+            const char* next = skipSpaces(p, end);
+            if (next == end || *next == '\r' || *next == '#') {
+                return i >= required;
+            }
+            if (!parseFloat(p, end, values[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // one .obj index, 1-based or negative (relative to the current end of its list)
+    bool parseIndex(const char*& p, const char* end, size_t listSize, int64_t& index, bool& chunkLocal) {
+        long long value;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || value == 0) {
+            return false;
+        }
+        p = result.ptr;
+        chunkLocal = value < 0;
+        index = value > 0 ? value - 1 : (int64_t)listSize + value;
+        return true;
+    }
+
+    // v, v/vt, v//vn or v/vt/vn
+    bool parseCorner(const char*& p, const char* end, const Chunk& chunk, Corner& corner) {
+        const size_t listSizes[3] = {chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3};
+        corner.chunkLocal = 0;
+        for (int k = 0; k < 3; k++) {
+            corner.index[k] = NO_INDEX;
+            if (k > 0) {
+                if (p == end || *p != '/') {
+                    break;
+                }
+                p++;
+                if (k == 1 && p < end && *p == '/') {
+                    continue; // no texture coordinate
+                }
+            }
+            bool chunkLocal;
+            if (!parseIndex(p, end, listSizes[k], corner.index[k], chunkLocal)) {
+                return false;
+            }
+            corner.chunkLocal |= (uint8_t)(chunkLocal << k);
+        }
+        return true;
+    }
+
+    bool startsWord(const char* p, const char* end, const char* word, size_t length) {
+        return (size_t)(end - p) > length && std::memcmp(p, word, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+    }
+
+    // parses the v, vt, vn, f and mtllib lines of [chunk.begin, chunk.end); other lines are skipped
+    void parseChunk(Chunk& chunk) {
+        std::vector<Corner> face;
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+            if (!lineEnd) {
+                lineEnd = chunk.end;
+            }
+
+            const char* q = skipSpaces(p, lineEnd);
+            bool ok = true;
+            if (startsWord(q, lineEnd, "v", 1)) {
+                float values[3];
+                q += 2;
+                ok = parseFloats(q, lineEnd, values, 3, 3);
+                chunk.positions.insert(chunk.positions.end(), values, values + 3);
+            } else if (startsWord(q, lineEnd, "vt", 2)) {
+                float values[2];
+                q += 3;
+                ok = parseFloats(q, lineEnd, values, 1, 2);
+                chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+            } else if (startsWord(q, lineEnd, "vn", 2)) {
+                float values[3];
+                q += 3;
+                ok = parseFloats(q, lineEnd, values, 3, 3);
+                chunk.normals.insert(chunk.normals.end(), values, values + 3);
+            } else if (startsWord(q, lineEnd, "f", 1)) {
+                face.clear();
+                q = skipSpaces(q + 2, lineEnd);
+                while (ok && q < lineEnd && *q != '\r' && *q != '#') {
+                    Corner corner;
+                    ok = parseCorner(q, lineEnd, chunk, corner);
+                    face.push_back(corner);
+                    q = skipSpaces(q, lineEnd);
+                }
+                ok = ok && face.size() >= 3;
+
+                // triangle fan around the first corner
+                for (size_t i = 1; ok && i + 1 < face.size(); i++) {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[i]);
+                    chunk.corners.push_back(face[i + 1]);
+                }
+            } else if (startsWord(q, lineEnd, "mtllib", 6) && chunk.materialLibrary.empty()) {
+                const char* nameBegin = skipSpaces(q + 7, lineEnd);
+                const char* nameEnd = lineEnd;
+                while (nameEnd > nameBegin && (nameEnd[-1] == '\r' || nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) {
+                    nameEnd--;
+                }
+                chunk.materialLibrary.assign(nameBegin, nameEnd);
+            }
+
+            if (!ok) {
+                chunk.error = "Malformed line: " + std::string(p, lineEnd);
+                return;
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    uint32_t hashCorner(const uint32_t key[3]) {
+        uint64_t h = key[0] * 0x9e3779b97f4a7c15ull;
+        h ^= (key[1] + 0x632be59bd9b4e019ull + (h << 6) + (h >> 2)) * 0xbf58476d1ce4e5b9ull;
+        h ^= (key[2] + 0x632be59bd9b4e019ull + (h << 6) + (h >> 2)) * 0x94d049bb133111ebull;
+        return (uint32_t)(h ^ (h >> 32));
+    }
+}
 
 /** 
  * Constructor
  * Given filename (relative path), parses file data to create Object.
 */
-Object::Object(std::string filename) {
-    std::ifstream inFile;
-    inFile.open(filename);
+Object::Object(std::string filename, size_t numThreads) {
+    MappedFile file(filename);
+    const char* data = file.data();
+    size_t size = file.size();
 
-    if (inFile.is_open()) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
 
-        std::string line;
+    // chunks end right after a line break, so no line is split
+    size_t numChunks = std::max<size_t>(1, std::min(size / MIN_CHUNK_BYTES, numThreads * CHUNKS_PER_THREAD));
+    std::vector<Chunk> chunks(numChunks);
+    const char* chunkBegin = data;
+    for (size_t i = 0; i < numChunks; i++) {
+        const char* chunkEnd = data + size;
+        if (i + 1 < numChunks) {
+            chunkEnd = std::max(chunkBegin, data + size * (i + 1) / numChunks);
+            const char* lineBreak = static_cast<const char*>(std::memchr(chunkEnd, '\n', data + size - chunkEnd));
+            chunkEnd = lineBreak ? lineBreak + 1 : data + size;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
 
-        std::vector<float> vec_s;
-        std::vector<float> vec_t;
-        std::vector<float> vec_nx;
-        std::vector<float> vec_ny;
-        std::vector<float> vec_nz;
+    if (numChunks == 1 || numThreads == 1) {
+        for (Chunk& chunk : chunks) {
+            parseChunk(chunk);
+        }
+    } else {
+        ThreadPool pool(std::min(numThreads, numChunks));
+        pool.parallelFor(numChunks, [&](size_t i, size_t worker) {
+            parseChunk(chunks[i]);
+        });
+    }
 
-        while (getline(inFile, line)) {
-            
-            if (line.length() >= 2 && line.at(0) != '#') { // skip blank & comment lines
-                std::stringstream stream(line);
-                std::string linePrefix;
-                stream >> linePrefix;
-                
-                if (linePrefix == "v") {
-                    Vertex v;
-                    stream >> v.x;
-                    stream >> v.y;
-                    stream >> v.z;
-                    vertices.push_back(v);
-                } else if (linePrefix == "vt") {
-                    float s, t;
-                    stream >> s;
-                    stream >> t;
-                    vec_s.push_back(s);
-                    vec_t.push_back(t);
-                } else if (linePrefix == "vn") {
-                    float nx, ny, nz;
-                    stream >> nx;
-                    stream >> ny;
-                    stream >> nz;
-                    vec_nx.push_back(nx);
-                    vec_ny.push_back(ny);
-                    vec_nz.push_back(nz);
-                } else if (linePrefix == "f") {
-                    std::string face;
-                    while (stream >> face) {
-                        // tokenize face data
-                        std::vector<std::string> tokens = split(face, "//");
-                        
-                        unsigned int v_idx = stoi(tokens.at(0)) - 1;
-                        unsigned int vt_idx = stoi(tokens.at(1)) - 1;
-                        unsigned int vn_idx = stoi(tokens.at(1)) - 1;
-
-                        bool hasVn = false;
-                        bool hasVt = false;
-
-                        if (face.find("//") != std::string::npos) { // v//n
-                            hasVn = true;
-                        } else if (tokens.size() <= 2) { // v/vt
-                            hasVt = true;
-
-                        } else { // v/vt/vn
-                            hasVt = true;
-                            hasVn = true;
-
-                            vn_idx = stoi(tokens.at(2)) - 1;
-                        }
-                        
-                        // get postion from existing vertex
-                        Vertex v = vertices.at(v_idx);
-
-                        float s = 0;
-                        float t = 0;
-
-                        if (hasVt) {
-                            s = vec_s.at(vt_idx);
-                            t = vec_t.at(vt_idx);
-                        }
-
-                        float nx = 0;
-                        float ny = 0;
-                        float nz = 0;
-
-                        // store normals if available
-                        if (hasVn) {
-                            nx = vec_nx.at(vn_idx);
-                            ny = vec_ny.at(vn_idx);
-                            nz = vec_nz.at(vn_idx);
-                        }
-
-                        // create vertex
-                        Vertex* vToAdd = new Vertex(
-                            v.x, v.y, v.z,
-                            s, t,
-                            nx, ny, nz
-                        );
-
-                        storeOrSkip(*vToAdd); 
-
-                        delete vToAdd;       
-                    }
-                } else if (linePrefix == "mtllib") {
-                    /* material file out of scope for this assignment
-                    // find and parse material file
-                    std::string mtlFileName;
-                    stream >> mtlFileName;
-                    
-                    // create path to mtlib, assuming same directory
-                    std::string dir = getDirectory(filename);
-                    parseMtl(dir, mtlFileName);
-                    */
-                }
+    // first entry of every chunk in the file-wide lists
+    std::vector<std::array<size_t, 3>> chunkBases(numChunks);
+    std::array<size_t, 3> listSizes = {0, 0, 0};
+    size_t numCorners = 0;
+    for (size_t i = 0; i < numChunks; i++) {
+        if (!chunks[i].error.empty()) {
+            throw std::runtime_error(filename + ": " + chunks[i].error);
+        }
+        chunkBases[i] = listSizes;
+        listSizes[0] += chunks[i].positions.size() / 3;
+        listSizes[1] += chunks[i].texcoords.size() / 2;
+        listSizes[2] += chunks[i].normals.size() / 3;
+        numCorners += chunks[i].corners.size();
+    }
+
+    // material file assumed in the same directory; many exports name one they do not ship
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.materialLibrary.empty()) {
+            std::string dir = getDirectory(filename);
+            if (std::filesystem::is_regular_file(dir + chunk.materialLibrary)) {
+                parseMtl(dir, chunk.materialLibrary);
             }
+            break;
         }
-    } else {
-        std::stringstream errorMsg;
-        errorMsg << "Filepath does not exist: " << filename << ". Please ensure given path is relative to program execution location.";
-        throw std::runtime_error(errorMsg.str());
     }
 
-    inFile.close();
+    std::vector<float> positions, texcoords, normals;
+    positions.reserve(listSizes[0] * 3);
+    texcoords.reserve(listSizes[1] * 2);
+    normals.reserve(listSizes[2] * 3);
+    for (Chunk& chunk : chunks) {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.texcoords);
+        std::vector<float>().swap(chunk.normals);
+    }
+
+    // open addressing table of vertex indices, keyed on the corner's index triple
+    size_t tableSize = 16;
+    while (tableSize < 2 * numCorners) {
+        tableSize *= 2;
+    }
+    std::vector<uint32_t> table(tableSize, NO_INDEX);
+    std::vector<std::array<uint32_t, 3>> vertexKeys;
+    vertexKeys.reserve(numCorners / 2);
+    vertices.reserve(numCorners / 2);
+    indices.reserve(numCorners);
+
+    for (size_t i = 0; i < numChunks; i++) {
+        for (const Corner& corner : chunks[i].corners) {
+            std::array<uint32_t, 3> key;
+            for (int k = 0; k < 3; k++) {
+                int64_t index = corner.index[k];
+                if (index == NO_INDEX) {
+                    key[k] = NO_INDEX;
+                    continue;
+                }
+                if (corner.chunkLocal & (1u << k)) {
+                    index += (int64_t)chunkBases[i][k];
+                }
+                if (index < 0 || (size_t)index >= listSizes[k]) {
+                    throw std::runtime_error(filename + ": face index out of range");
+                }
+                key[k] = (uint32_t)index;
+            }
+            if (key[0] == NO_INDEX) {
+                throw std::runtime_error(filename + ": face corner without a position");
+            }
+
+            size_t slot = hashCorner(key.data()) & (tableSize - 1);
+            while (table[slot] != NO_INDEX && vertexKeys[table[slot]] != key) {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if (table[slot] == NO_INDEX) {
+                table[slot] = (uint32_t)vertices.size();
+                vertexKeys.push_back(key);
+
+                Vertex v(positions[3 * key[0]], positions[3 * key[0] + 1], positions[3 * key[0] + 2], 0, 0, 0, 0, 0);
+                if (key[1] != NO_INDEX) {
+                    v.s = texcoords[2 * key[1]];
+                    v.t = texcoords[2 * key[1] + 1];
+                }
+                if (key[2] != NO_INDEX) {
+                    v.nx = normals[3 * key[2]];
+                    v.ny = normals[3 * key[2] + 1];
+                    v.nz = normals[3 * key[2] + 2];
+                }
+                vertices.push_back(v);
+            }
+            indices.push_back(table[slot]);
+        }
+    }
 }
 
 /**
@@ -214,19 +405,6 @@ void Object::parseMtl(std::string dir, std::string mtlFileName) {
     inFile.close();
 }
 
-void Object::storeOrSkip(Vertex vToAdd) {
-    for (unsigned int i = 0; i < vertices.size(); i++) {
-        if (vToAdd == vertices.at(i)) {
-            indices.push_back(i);
-            return;
-        }
-    }
-    
-    vertices.push_back(vToAdd);
-    indices.push_back(vertices.size() - 1);
-    
-}
-
 void Object::saveObj(std::string outputFileName) {
     std::ofstream outFile;
     outFile.open(outputFileName);
@@ -238,19 +416,3 @@ void Object::saveObj(std::string outputFileName) {
     }
     outFile.close();
 }
-
-std::vector<std::vector<Vertex>> Object::getFaces() const {
-    std::vector<std::vector<Vertex>> faces;
-
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        if (i + 2 < indices.size()) { // ensure 3+ indices left
-            std::vector<Vertex> triangle;
-            triangle.push_back(vertices[indices[i]]);
-            triangle.push_back(vertices[indices[i + 1]]);
-            triangle.push_back(vertices[indices[i + 2]]);
-            faces.push_back(triangle);
-        }
-    }
-
-    return faces;
-}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include <cmath>
+#include <random>
+
+#include "Perlin.hpp"
+
+namespace
+{
+    // uniform in [-1, 1), from the generator's bits only, so every platform draws the same numbers
+    double uniform(std::mt19937_64 &generator)
+    {
+        return (double)(generator() >> 11) * 0x1.0p-52 - 1.0;
+    }
+
+    // 6t^5 - 15t^4 + 10t^3: flat first and second derivatives at the lattice points
+    inline double fade(double t)
+    {
+        return t * t * t * (t * (t * 6 - 15) + 10);
+    }
+
+    inline double lerp(double t, double a, double b)
+    {
+        return a + t * (b - a);
+    }
+}
+
+Perlin::Perlin(uint64_t seed) : noiseSeed(seed)
+{
+    std::mt19937_64 generator(seed);
+    for (int i = 0; i < SIZE; ++i)
+    {
+        // uniform directions: points in the unit ball, pushed out to the sphere
+        double x, y, z, lengthSquared;
+        do
+        {
+            x = uniform(generator);
+            y = uniform(generator);
+            z = uniform(generator);
+            lengthSquared = x * x + y * y + z * z;
+        } while (lengthSquared > 1 || lengthSquared < 1e-6);
+
+        double length = std::sqrt(lengthSquared);
+        gradientX[i] = x / length;
+        gradientY[i] = y / length;
+        gradientZ[i] = z / length;
+    }
+
+    for (uint8_t *perm : {permX, permY, permZ})
+    {
+        for (int i = 0; i < SIZE; ++i)
+        {
+            perm[i] = (uint8_t)i;
+        }
+        for (int i = SIZE - 1; i > 0; --i)
+        {
+            int target = (int)(generator() % (uint64_t)(i + 1));
+            std::swap(perm[i], perm[target]);
+        }
+    }
+}
+
+double Perlin::noise(const Vec3 &point) const
+{
+    double out;
+    noiseLanes<1>(&point.x, &point.y, &point.z, &out);
+    return out;
+}
+
+void Perlin::noise(const double *x, const double *y, const double *z, double *out) const
+{
+    noiseLanes<LANES>(x, y, z, out);
+}
+
+template <int N>
+void Perlin::noiseLanes(const double *x, const double *y, const double *z, double *out) const
+{
+    alignas(64) double fx[N], fy[N], fz[N];
+    alignas(64) int cellX[N], cellY[N], cellZ[N];
+    alignas(64) double gx[8][N], gy[8][N], gz[8][N]; // per corner, corner bits x << 2 | y << 1 | z
+
+    // lattice cell and position in it; floor without a library call
+    for (int lane = 0; lane < N; ++lane)
+    {
+        int truncatedX = (int)x[lane], truncatedY = (int)y[lane], truncatedZ = (int)z[lane];
+        cellX[lane] = truncatedX - (x[lane] < truncatedX);
+        cellY[lane] = truncatedY - (y[lane] < truncatedY);
+        cellZ[lane] = truncatedZ - (z[lane] < truncatedZ);
+        fx[lane] = x[lane] - cellX[lane];
+        fy[lane] = y[lane] - cellY[lane];
+        fz[lane] = z[lane] - cellZ[lane];
+    }
+
+    // gradients of the eight corners: the table lookups, six permutations per lane
+    for (int lane = 0; lane < N; ++lane)
+    {
+        int x0 = permX[cellX[lane] & (SIZE - 1)], x1 = permX[(cellX[lane] + 1) & (SIZE - 1)];
+        int y0 = permY[cellY[lane] & (SIZE - 1)], y1 = permY[(cellY[lane] + 1) & (SIZE - 1)];
+        int z0 = permZ[cellZ[lane] & (SIZE - 1)], z1 = permZ[(cellZ[lane] + 1) & (SIZE - 1)];
+        const int hashes[8] = {x0 ^ y0 ^ z0, x0 ^ y0 ^ z1, x0 ^ y1 ^ z0, x0 ^ y1 ^ z1,
+                               x1 ^ y0 ^ z0, x1 ^ y0 ^ z1, x1 ^ y1 ^ z0, x1 ^ y1 ^ z1};
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            gx[corner][lane] = gradientX[hashes[corner]];
+            gy[corner][lane] = gradientY[hashes[corner]];
+            gz[corner][lane] = gradientZ[hashes[corner]];
+        }
+    }
+
+    // written out per corner: -O2 does not unroll loops over the corners, and the lane loop only vectorizes without them
+    for (int lane = 0; lane < N; ++lane)
+    {
+        double x0 = fx[lane], y0 = fy[lane], z0 = fz[lane];
+        double x1 = x0 - 1, y1 = y0 - 1, z1 = z0 - 1;
+        double d000 = gx[0][lane] * x0 + gy[0][lane] * y0 + gz[0][lane] * z0;
+        double d001 = gx[1][lane] * x0 + gy[1][lane] * y0 + gz[1][lane] * z1;
+        double d010 = gx[2][lane] * x0 + gy[2][lane] * y1 + gz[2][lane] * z0;
+        double d011 = gx[3][lane] * x0 + gy[3][lane] * y1 + gz[3][lane] * z1;
+        double d100 = gx[4][lane] * x1 + gy[4][lane] * y0 + gz[4][lane] * z0;
+        double d101 = gx[5][lane] * x1 + gy[5][lane] * y0 + gz[5][lane] * z1;
+        double d110 = gx[6][lane] * x1 + gy[6][lane] * y1 + gz[6][lane] * z0;
+        double d111 = gx[7][lane] * x1 + gy[7][lane] * y1 + gz[7][lane] * z1;
+
+        double u = fade(x0), v = fade(y0), w = fade(z0);
+        double x00 = lerp(u, d000, d100), x01 = lerp(u, d001, d101);
+        double x10 = lerp(u, d010, d110), x11 = lerp(u, d011, d111);
+        out[lane] = lerp(w, lerp(v, x00, x10), lerp(v, x01, x11));
+    }
+}
+
+double Perlin::fbm(const Vec3 &point, int octaves) const
+{
+    double out;
+    octaveLanes<1, false>(&point.x, &point.y, &point.z, octaves, &out);
+    return out;
+}
+
+void Perlin::fbm(const double *x, const double *y, const double *z, int octaves, double *out) const
+{
+    octaveLanes<LANES, false>(x, y, z, octaves, out);
+}
+
+double Perlin::turbulence(const Vec3 &point, int octaves) const
+{
+    double out;
+    octaveLanes<1, true>(&point.x, &point.y, &point.z, octaves, &out);
+    return out;
+}
+
+void Perlin::turbulence(const double *x, const double *y, const double *z, int octaves, double *out) const
+{
+    octaveLanes<LANES, true>(x, y, z, octaves, out);
+}
+
+template <int N, bool ABSOLUTE>
+void Perlin::octaveLanes(const double *x, const double *y, const double *z, int octaves, double *out) const
+{
+    alignas(64) double px[N], py[N], pz[N], value[N];
+    for (int lane = 0; lane < N; ++lane)
+    {
+        px[lane] = x[lane];
+        py[lane] = y[lane];
+        pz[lane] = z[lane];
+        out[lane] = 0;
+    }
+
+    double amplitude = 1;
+    for (int octave = 0; octave < octaves; ++octave)
+    {
+        noiseLanes<N>(px, py, pz, value);
+        for (int lane = 0; lane < N; ++lane)
+        {
+            out[lane] += amplitude * (ABSOLUTE ? std::abs(value[lane]) : value[lane]);
+            px[lane] *= 2;
+            py[lane] *= 2;
+            pz[lane] *= 2;
+        }
+        amplitude *= 0.5;
+    }
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef MINGW
+#include <cstdlib>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.hpp"
+#include "Procedural.hpp"
+
+namespace
+{
+    const int LANES = Perlin::LANES;
+
+    // multiply-rotate steps over the words of a pattern's parameters
+    struct KeyBuilder
+    {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+
+        void add(uint64_t word)
+        {
+            h ^= word * 0x87c37b91114253d5ull;
+            h = ((h << 31) | (h >> 33)) * 0x4cf5ad432745937full;
+        }
+        void add(double value)
+        {
+            uint64_t word;
+            std::memcpy(&word, &value, sizeof(word));
+            add(word);
+        }
+        void add(const Vec3 &v)
+        {
+            add(v.x);
+            add(v.y);
+            add(v.z);
+        }
+    };
+
+    /**
+     * The default place for baked textures: a directory of the current user's
+     * own under the system's temporary directory, so other users can neither
+     * pre-place an image there nor replace one. Throws std::runtime_error if
+     * the directory exists but belongs to someone else or is writable by them.
+    */
+    std::filesystem::path userBakeDirectory()
+    {
+#ifdef MINGW
+        const char *user = std::getenv("USERNAME");
+        std::string owner = user ? user : "default";
+#else
+        std::string owner = std::to_string(getuid());
+#endif
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / ("raytracer-bake-" + owner);
+        std::error_code error;
+        if (std::filesystem::create_directory(directory, error))
+            std::filesystem::permissions(directory, std::filesystem::perms::owner_all, error);
+#ifndef MINGW
+        struct stat status;
+        if (lstat(directory.c_str(), &status) != 0 || !S_ISDIR(status.st_mode) || status.st_uid != getuid() ||
+            (status.st_mode & (S_IWGRP | S_IWOTH)))
+            throw std::runtime_error("Not a private directory of the current user: " + directory.string());
+#endif
+        return directory;
+    }
+}
+
+Vec3 MarblePattern::at(const Vec3 &point) const
+{
+    double turbulence = noise->turbulence(noiseScale * point, octaves);
+    double t = 0.5 * (1 + std::sin(bandScale * axis.dot(point) + distortion * turbulence));
+    return dark + t * (light - dark);
+}
+
+void MarblePattern::at(const double *x, const double *y, const double *z, Vec3 *out) const
+{
+    alignas(64) double nx[LANES], ny[LANES], nz[LANES], turbulence[LANES];
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        nx[lane] = noiseScale * x[lane];
+        ny[lane] = noiseScale * y[lane];
+        nz[lane] = noiseScale * z[lane];
+    }
+    noise->turbulence(nx, ny, nz, octaves, turbulence);
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        double along = axis.x * x[lane] + axis.y * y[lane] + axis.z * z[lane];
+        double t = 0.5 * (1 + std::sin(bandScale * along + distortion * turbulence[lane]));
+        out[lane] = dark + t * (light - dark);
+    }
+}
+
+uint64_t MarblePattern::key() const
+{
+    KeyBuilder key;
+    key.add(noise->seed());
+    key.add(light);
+    key.add(dark);
+    key.add(axis);
+    key.add(bandScale);
+    key.add(noiseScale);
+    key.add(distortion);
+    key.add((uint64_t)octaves);
+    return key.h;
+}
+
+Vec3 RipplePattern::bend(const Vec3 &normal, const Vec3 &point, double time) const
+{
+    // central differences of the height field over a fraction of the finest octave's cell, in one batch
+    double step = 0.1 / (scale * std::ldexp(1.0, std::max(octaves - 1, 0)));
+    const double dx[LANES] = {step, -step, 0, 0, 0, 0, 0, 0};
+    const double dz[LANES] = {0, 0, step, -step, 0, 0, 0, 0};
+    alignas(64) double x[LANES], y[LANES], z[LANES], height[LANES];
+    for (int lane = 0; lane < LANES; ++lane)
+    {
+        x[lane] = scale * (point.x + dx[lane]);
+        y[lane] = speed * time;
+        z[lane] = scale * (point.z + dz[lane]);
+    }
+    noise->fbm(x, y, z, octaves, height);
+
+    double slopeX = amplitude * (height[0] - height[1]) / (2 * step);
+    double slopeZ = amplitude * (height[2] - height[3]) / (2 * step);
+    // the normal of y = h(x, z) is (-dh/dx, 1, -dh/dz), flipped along with the surface normal
+    double side = normal.y >= 0 ? 1 : -1;
+    return (normal - side * Vec3(slopeX, 0, slopeZ)).normalize();
+}
+
+void PlanarMapping::uv(const Vec3 &point, double &u, double &v) const
+{
+    Vec3 offset = point - origin;
+    u = offset.dot(edgeU) / edgeU.lengthSquared();
+    v = offset.dot(edgeV) / edgeV.lengthSquared();
+}
+
+double PlanarMapping::uvScale() const
+{
+    return 1 / std::min(edgeU.length(), edgeV.length());
+}
+
+std::shared_ptr<Texture> bakeMarble(const MarblePattern &pattern, const PlanarMapping &mapping, int resolution,
+                                    const std::string &cacheDir, std::shared_ptr<TextureCache> cache)
+{
+    // the pattern and where it lies on the surface, so a texture is only reused for the same texels
+    KeyBuilder key;
+    key.add(pattern.key());
+    key.add(mapping.origin);
+    key.add(mapping.edgeU);
+    key.add(mapping.edgeV);
+
+    std::filesystem::path directory = cacheDir.empty() ? userBakeDirectory() : std::filesystem::path(cacheDir);
+    char name[64];
+    std::snprintf(name, sizeof(name), "marble-%016llx-%d.ppm", (unsigned long long)key.h, resolution);
+    std::string path = (directory / name).string();
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error))
+    {
+        // texel centers, LANES at a time along each row; row 0 is the top of the image, v = 1
+        std::string header = "P6\n" + std::to_string(resolution) + " " + std::to_string(resolution) + "\n255\n";
+        std::vector<uint8_t> bytes(header.begin(), header.end());
+        bytes.reserve(header.size() + (size_t)resolution * resolution * 3);
+        alignas(64) double x[LANES], y[LANES], z[LANES];
+        Vec3 colors[LANES];
+        for (int row = 0; row < resolution; ++row)
+        {
+            double v = 1 - (row + 0.5) / resolution;
+            for (int column = 0; column < resolution; column += LANES)
+            {
+                for (int lane = 0; lane < LANES; ++lane)
+                {
+                    Vec3 point = mapping.point((std::min(column + lane, resolution - 1) + 0.5) / resolution, v);
+                    x[lane] = point.x;
+                    y[lane] = point.y;
+                    z[lane] = point.z;
+                }
+                pattern.at(x, y, z, colors);
+                for (int lane = 0; lane < LANES && column + lane < resolution; ++lane)
+                {
+                    // gamma 2, like the PPMs textures are read from
+                    for (double channel : {colors[lane].x, colors[lane].y, colors[lane].z})
+                    {
+                        bytes.push_back((uint8_t)std::lround(255 * std::sqrt(std::min(std::max(channel, 0.0), 1.0))));
+                    }
+                }
+            }
+        }
+        if (!replaceFile(path, bytes.data(), bytes.size()))
+            throw std::runtime_error("Could not write baked texture: " + path);
+    }
+    return Texture::load(path, "", std::move(cache));
+}
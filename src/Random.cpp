@@ -0,0 +1,47 @@
+#include <algorithm>
+
+#include "Random.hpp"
+
+void Philox::generateBatch(Key key, uint32_t c0, uint32_t c1Begin, uint32_t c2, uint32_t c3, size_t count, uint32_t *out)
+{
+    for (size_t base = 0; base < count; base += BATCH_WIDTH)
+    {
+        size_t lanes = std::min(BATCH_WIDTH, count - base);
+
+        // one array per counter word; every round is the same operation on all lanes
+        uint32_t x0[BATCH_WIDTH], x1[BATCH_WIDTH], x2[BATCH_WIDTH], x3[BATCH_WIDTH];
+        for (size_t i = 0; i < BATCH_WIDTH; ++i)
+        {
+            x0[i] = c0;
+            x1[i] = c1Begin + (uint32_t)(base + i);
+            x2[i] = c2;
+            x3[i] = c3;
+        }
+
+        uint32_t k0 = key.k0, k1 = key.k1;
+        for (int round = 0; round < ROUNDS; ++round)
+        {
+            for (size_t i = 0; i < BATCH_WIDTH; ++i)
+            {
+                uint64_t p0 = (uint64_t)M0 * x0[i];
+                uint64_t p1 = (uint64_t)M1 * x2[i];
+                uint32_t n0 = (uint32_t)(p1 >> 32) ^ x1[i] ^ k0;
+                uint32_t n2 = (uint32_t)(p0 >> 32) ^ x3[i] ^ k1;
+                x1[i] = (uint32_t)p1;
+                x3[i] = (uint32_t)p0;
+                x0[i] = n0;
+                x2[i] = n2;
+            }
+            k0 += W0;
+            k1 += W1;
+        }
+
+        for (size_t i = 0; i < lanes; ++i)
+        {
+            out[0 * count + base + i] = x0[i];
+            out[1 * count + base + i] = x1[i];
+            out[2 * count + base + i] = x2[i];
+            out[3 * count + base + i] = x3[i];
+        }
+    }
+}
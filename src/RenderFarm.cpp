@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#ifndef MINGW
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "RenderFarm.hpp"
+
+namespace
+{
+    RenderSettings workerSettings(RenderSettings settings)
+    {
+        settings.numThreads = 1; // parallelism comes from the processes
+        return settings;
+    }
+
+#ifndef MINGW
+    // false once the other end is gone
+    bool sendAll(int fd, const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool receiveAll(int fd, void *data, size_t size)
+    {
+        char *bytes = static_cast<char *>(data);
+        while (size > 0)
+        {
+            ssize_t received = recv(fd, bytes, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            bytes += received;
+            size -= received;
+        }
+        return true;
+    }
+#endif
+}
+
+RenderFarm::RenderFarm(const RenderSettings &settings, const Camera &camera, std::vector<std::shared_ptr<const World>> frames)
+    : settings(settings), camera(camera), frames(std::move(frames)), renderer(workerSettings(settings)), workers(settings.farmWorkers)
+{
+}
+
+RenderFarm::~RenderFarm()
+{
+    for (Worker &worker : workers)
+    {
+        stop(worker);
+    }
+}
+
+#ifdef MINGW
+
+void RenderFarm::run(const FrameCallback &onFrame)
+{
+    throw std::runtime_error("The render farm needs POSIX processes and sockets");
+}
+
+void RenderFarm::spawn(Worker &worker) {}
+void RenderFarm::stop(Worker &worker) {}
+void RenderFarm::replace(Worker &worker) {}
+
+bool RenderFarm::receive(Worker &worker, std::vector<FrameState> &states, std::vector<double> &packed)
+{
+    return false;
+}
+
+void RenderFarm::workerMain(int fd)
+{
+    std::abort();
+}
+
+#else
+
+void RenderFarm::run(const FrameCallback &onFrame)
+{
+    const std::vector<Renderer::Tile> &tiles = renderer.tileLayout();
+    size_t numTiles = tiles.size();
+
+    pending.clear();
+    for (size_t frame = 0; frame < frames.size(); ++frame)
+    {
+        for (size_t tile = 0; tile < numTiles; ++tile)
+        {
+            pending.push_back({(int32_t)frame, (int32_t)tile});
+        }
+    }
+    attempts.assign(pending.size(), 0);
+
+    std::vector<FrameState> states(frames.size());
+    std::vector<double> packed;
+    size_t framesDone = 0;
+
+    // nothing buffered may be written twice by the forked children
+    fflush(stdout);
+    for (Worker &worker : workers)
+    {
+        spawn(worker);
+    }
+
+    std::vector<pollfd> polled(workers.size());
+    while (framesDone < frames.size())
+    {
+        // keep every worker a few jobs deep
+        for (Worker &worker : workers)
+        {
+            while ((int)worker.assigned.size() < JOBS_PER_WORKER && !pending.empty())
+            {
+                Job job = pending.front();
+                if (!sendAll(worker.fd, &job, sizeof(job)))
+                {
+                    replace(worker);
+                    continue;
+                }
+                pending.pop_front();
+                worker.assigned.push_back(job);
+
+                FrameState &state = states[job.frame];
+                if (!state.started)
+                {
+                    state.started = true;
+                    state.timer.restart();
+                }
+            }
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            polled[i] = {workers[i].fd, POLLIN, 0};
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Render farm: poll failed");
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            if (polled[i].revents == 0)
+                continue;
+
+            // a hang-up with a result still buffered is read first; the next poll reports the hang-up again
+            if (!(polled[i].revents & POLLIN) || !receive(workers[i], states, packed))
+            {
+                replace(workers[i]);
+                continue;
+            }
+
+            const Job &done = workers[i].assigned.front();
+            FrameState &state = states[done.frame];
+            workers[i].assigned.pop_front();
+            if (state.tilesDone == numTiles)
+            {
+                onFrame(done.frame, state.pixels, state.counters, state.maxSamples, state.timer.elapsed());
+                std::vector<Vec3>().swap(state.pixels);
+                framesDone++;
+            }
+        }
+    }
+
+    for (Worker &worker : workers)
+    {
+        stop(worker);
+    }
+}
+
+bool RenderFarm::receive(Worker &worker, std::vector<FrameState> &states, std::vector<double> &packed)
+{
+    ResultHeader header;
+    if (worker.assigned.empty() || !receiveAll(worker.fd, &header, sizeof(header)))
+        return false;
+
+    // results come back in the order the jobs were sent
+    const Job &job = worker.assigned.front();
+    if (header.frame != job.frame || header.tile != job.tile)
+        return false;
+
+    const Renderer::Tile &tile = renderer.tileLayout()[job.tile];
+    int tileWidth = tile.x1 - tile.x0;
+    size_t numPixels = (size_t)tileWidth * (tile.y1 - tile.y0);
+    packed.resize(3 * numPixels);
+    if (!receiveAll(worker.fd, packed.data(), packed.size() * sizeof(double)))
+        return false;
+
+    FrameState &state = states[job.frame];
+    state.pixels.resize((size_t)settings.imageWidth * settings.imageHeight);
+    for (size_t i = 0; i < numPixels; ++i)
+    {
+        int x = tile.x0 + (int)(i % tileWidth);
+        int y = tile.y0 + (int)(i / tileWidth);
+        state.pixels[(size_t)y * settings.imageWidth + x] = Vec3(packed[3 * i], packed[3 * i + 1], packed[3 * i + 2]);
+    }
+
+    state.counters.rays += header.counters.rays;
+    state.counters.bvIntersections += header.counters.bvIntersections;
+    state.counters.objectIntersections += header.counters.objectIntersections;
+    state.counters.pathSegments += header.counters.pathSegments;
+    state.maxSamples = std::max(state.maxSamples, header.maxSamples);
+    state.tilesDone++;
+    return true;
+}
+
+void RenderFarm::spawn(Worker &worker)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        throw std::runtime_error("Render farm: could not create a socket pair");
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        throw std::runtime_error("Render farm: could not fork a worker");
+    }
+
+    if (pid == 0)
+    {
+        // only our own end may stay open, or a dead worker's socket would never hang up
+        close(fds[0]);
+        for (const Worker &other : workers)
+        {
+            if (other.fd >= 0)
+                close(other.fd);
+        }
+        workerMain(fds[1]);
+    }
+
+    close(fds[1]);
+    worker.pid = pid;
+    worker.fd = fds[0];
+}
+
+void RenderFarm::stop(Worker &worker)
+{
+    if (worker.pid < 0)
+        return;
+
+    Job quit = {-1, -1};
+    sendAll(worker.fd, &quit, sizeof(quit));
+    close(worker.fd);
+    waitpid(worker.pid, nullptr, 0);
+    worker.pid = -1;
+    worker.fd = -1;
+}
+
+void RenderFarm::replace(Worker &worker)
+{
+    close(worker.fd);
+    kill(worker.pid, SIGKILL); // in case it is alive but talking nonsense
+    int status = 0;
+    waitpid(worker.pid, &status, 0);
+    numCrashes++;
+    int pid = worker.pid;
+    worker.pid = -1;
+    worker.fd = -1;
+
+    if (WIFSIGNALED(status))
+        printf("Worker %d was killed by signal %d; requeueing %lu job(s)\n", pid, WTERMSIG(status), (unsigned long)worker.assigned.size());
+    else
+        printf("Worker %d exited with status %d; requeueing %lu job(s)\n", pid, WEXITSTATUS(status), (unsigned long)worker.assigned.size());
+
+    // workers render their jobs in order, so only the oldest one can have taken it down; the rest go back uncharged
+    size_t numTiles = renderer.tileLayout().size();
+    if (!worker.assigned.empty())
+    {
+        const Job &job = worker.assigned.front();
+        if (++attempts[job.frame * numTiles + job.tile] >= MAX_ATTEMPTS)
+        {
+            throw std::runtime_error("Render farm: tile " + std::to_string(job.tile) + " of frame " + std::to_string(job.frame) +
+                                     " crashed " + std::to_string(MAX_ATTEMPTS) + " workers");
+        }
+    }
+    while (!worker.assigned.empty())
+    {
+        pending.push_front(worker.assigned.back());
+        worker.assigned.pop_back();
+    }
+
+    fflush(stdout);
+    spawn(worker);
+}
+
+void RenderFarm::workerMain(int fd)
+{
+    std::vector<Vec3> pixels;
+    std::vector<double> packed;
+    const std::vector<Renderer::Tile> &tiles = renderer.tileLayout();
+
+    Job job;
+    while (receiveAll(fd, &job, sizeof(job)) && job.frame >= 0)
+    {
+        Metrics::reset();
+        renderer.renderSingleTile(camera, *frames[job.frame], job.frame, job.tile, pixels);
+
+        const Renderer::Tile &tile = tiles[job.tile];
+        size_t numPixels = (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+        packed.resize(3 * numPixels);
+        for (size_t i = 0; i < numPixels; ++i)
+        {
+            packed[3 * i] = pixels[i].x;
+            packed[3 * i + 1] = pixels[i].y;
+            packed[3 * i + 2] = pixels[i].z;
+        }
+
+        const std::vector<uint32_t> &counts = renderer.sampleCounts();
+        uint32_t maxSamples = 0;
+        for (int y = tile.y0; y < tile.y1; ++y)
+        {
+            for (int x = tile.x0; x < tile.x1; ++x)
+            {
+                maxSamples = std::max(maxSamples, counts[(size_t)y * settings.imageWidth + x]);
+            }
+        }
+
+        ResultHeader header = {job.frame, job.tile, Metrics::collect(), maxSamples};
+        if (!sendAll(fd, &header, sizeof(header)) || !sendAll(fd, packed.data(), packed.size() * sizeof(double)))
+            break;
+    }
+
+    // skip destructors: the coordinator's threads and buffers are not ours
+    _exit(0);
+}
+
+#endif
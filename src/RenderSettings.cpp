@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "RenderSettings.hpp"
+#include "Sampler.hpp"
+
+namespace
+{
+    // parses a positive integer option value, keeping the default on bad input
+    void parsePositive(const std::string &name, const char *value, int &out)
+    {
+        try
+        {
+            int parsed = std::stoi(value);
+            if (parsed < 1)
+                throw std::invalid_argument(name);
+            out = parsed;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Invalid value for " << name << ": " << value << ". Using " << out << "." << std::endl;
+        }
+    }
+
+    void parsePositive(const std::string &name, const char *value, double &out)
+    {
+        try
+        {
+            double parsed = std::stod(value);
+            if (!(parsed > 0))
+                throw std::invalid_argument(name);
+            out = parsed;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Invalid value for " << name << ": " << value << ". Using " << out << "." << std::endl;
+        }
+    }
+}
+
+RenderSettings RenderSettings::fromArgs(int argc, char *argv[])
+{
+    RenderSettings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0)
+        {
+            try
+            {
+                settings.numFrames = std::stod(arg);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Invalid format for given number of frames. Using 2 frames." << std::endl;
+                settings.numFrames = 2;
+            }
+            continue;
+        }
+
+        if (arg == "--stream-tiles")
+        {
+            settings.streamTiles = true;
+            continue;
+        }
+        if (arg == "--packets")
+        {
+            settings.packets = true;
+            continue;
+        }
+        if (arg == "--procedural")
+        {
+            settings.procedural = true;
+            continue;
+        }
+        if (arg == "--wavefront")
+        {
+            settings.wavefront = true;
+            continue;
+        }
+        if (arg == "--nee")
+        {
+            settings.nextEventEstimation = true;
+            continue;
+        }
+        if (arg == "--adaptive")
+        {
+            settings.adaptive = true;
+            continue;
+        }
+        if (arg == "--sample-aov")
+        {
+            settings.sampleCountAov = true;
+            continue;
+        }
+        if (arg == "--aovs")
+        {
+            settings.writeAovs = true;
+            continue;
+        }
+        if (arg == "--denoise")
+        {
+            settings.denoise = true;
+            continue;
+        }
+        if (arg == "--write-passes")
+        {
+            settings.writePasses = true;
+            continue;
+        }
+        if (arg == "--no-mesh-cache")
+        {
+            settings.meshCache = false;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cout << "Missing value for " << arg << ". Ignoring it." << std::endl;
+            break;
+        }
+
+        const char *value = argv[++i];
+        if (arg == "--threads")
+            parsePositive(arg, value, settings.numThreads);
+        else if (arg == "--width")
+            parsePositive(arg, value, settings.imageWidth);
+        else if (arg == "--height")
+            parsePositive(arg, value, settings.imageHeight);
+        else if (arg == "--spp")
+            parsePositive(arg, value, settings.samplesPerPixel);
+        else if (arg == "--min-spp")
+            parsePositive(arg, value, settings.minSamples);
+        else if (arg == "--noise-threshold")
+            parsePositive(arg, value, settings.noiseThreshold);
+        else if (arg == "--rebuild-threshold")
+            parsePositive(arg, value, settings.rebuildThreshold);
+        else if (arg == "--frames-in-flight")
+            parsePositive(arg, value, settings.framesInFlight);
+        else if (arg == "--workers")
+            parsePositive(arg, value, settings.farmWorkers);
+        else if (arg == "--time-budget")
+            parsePositive(arg, value, settings.timeBudget);
+        else if (arg == "--noise-target")
+            parsePositive(arg, value, settings.noiseTarget);
+        else if (arg == "--tile-size")
+            parsePositive(arg, value, settings.tileSize);
+        else if (arg == "--min-depth")
+            parsePositive(arg, value, settings.minDepth);
+        else if (arg == "--max-depth")
+            parsePositive(arg, value, settings.maxDepth);
+        else if (arg == "--seed")
+        {
+            try
+            {
+                settings.seed = std::stoull(value);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "Invalid value for " << arg << ": " << value << ". Using " << settings.seed << "." << std::endl;
+            }
+        }
+        else if (arg == "--sampler")
+            settings.sampler = value;
+        else if (arg == "--format")
+            settings.imageFormat = value;
+        else if (arg == "--report")
+            settings.reportFormat = value;
+        else if (arg == "--report-file")
+            settings.reportFile = value;
+        else if (arg == "--mesh-cache")
+            settings.meshCacheDir = value;
+        else if (arg == "--textured-mesh")
+            settings.texturedMesh = value;
+        else if (arg == "--texture")
+            settings.texture = value;
+        else if (arg == "--texture-cache-mb")
+            parsePositive(arg, value, settings.textureCacheMb);
+        else if (arg == "--bake-procedural")
+            parsePositive(arg, value, settings.bakeResolution);
+        else
+            std::cout << "Unknown option: " << arg << ". Ignoring it." << std::endl;
+    }
+
+    if (settings.numThreads == 0)
+    {
+        settings.numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (settings.reportFormat != "none" && settings.reportFormat != "json" && settings.reportFormat != "csv")
+    {
+        std::cout << "Invalid value for --report: " << settings.reportFormat << ". Using none." << std::endl;
+        settings.reportFormat = "none";
+    }
+    if (!Sampler::isValidName(settings.sampler))
+    {
+        std::cout << "Invalid value for --sampler: " << settings.sampler << ". Using random." << std::endl;
+        settings.sampler = "random";
+    }
+    if (settings.minDepth > settings.maxDepth)
+    {
+        settings.minDepth = settings.maxDepth;
+    }
+    if (settings.minSamples > settings.samplesPerPixel)
+    {
+        settings.minSamples = settings.samplesPerPixel;
+    }
+    if (settings.imageFormat != "p3" && settings.imageFormat != "p6" && settings.imageFormat != "ppm16" && settings.imageFormat != "pfm")
+    {
+        std::cout << "Invalid value for --format: " << settings.imageFormat << ". Using p6." << std::endl;
+        settings.imageFormat = "p6";
+    }
+    if (settings.streamTiles && settings.progressive())
+    {
+        std::cout << "--stream-tiles cannot be combined with progressive rendering. Ignoring it." << std::endl;
+        settings.streamTiles = false;
+    }
+    if (settings.framesInFlight > 1 && (settings.streamTiles || settings.progressive()))
+    {
+        std::cout << "--frames-in-flight cannot be combined with --stream-tiles or progressive rendering. Using 1." << std::endl;
+        settings.framesInFlight = 1;
+    }
+    if (settings.farmWorkers > 0 && (settings.streamTiles || settings.progressive() || settings.sampleCountAov))
+    {
+        std::cout << "--workers cannot be combined with --stream-tiles, --sample-aov or progressive rendering. Ignoring it." << std::endl;
+        settings.farmWorkers = 0;
+    }
+    if (settings.collectAovs() && (settings.streamTiles || settings.progressive() || settings.farmWorkers > 0))
+    {
+        std::cout << "--aovs and --denoise need whole frames in this process; they cannot be combined with --stream-tiles, --workers or progressive rendering. Ignoring them." << std::endl;
+        settings.writeAovs = false;
+        settings.denoise = false;
+    }
+    if (settings.streamTiles && settings.imageFormat == "p3")
+    {
+        std::cout << "--stream-tiles needs a binary format. Using p6." << std::endl;
+        settings.imageFormat = "p6";
+    }
+    if (!settings.texture.empty() && settings.texturedMesh.empty())
+    {
+        std::cout << "--texture needs --textured-mesh. Ignoring it." << std::endl;
+        settings.texture.clear();
+    }
+    if (settings.bakeResolution > 0 && !settings.procedural)
+    {
+        std::cout << "--bake-procedural needs --procedural. Ignoring it." << std::endl;
+        settings.bakeResolution = 0;
+    }
+    if (settings.reportFile.empty())
+    {
+        settings.reportFile = settings.reportFormat == "csv" ? "frames/report.csv" : "frames/report.jsonl";
+    }
+
+    return settings;
+}
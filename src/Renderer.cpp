@@ -0,0 +1,574 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "globals.hpp"
+#include "Material.hpp"
+#include "Metrics.hpp"
+#include "Renderer.hpp"
+#include "Wavefront.hpp"
+
+namespace
+{
+    // interleaves the bits of x and y
+    uint32_t mortonCode(uint32_t x, uint32_t y)
+    {
+        auto spread = [](uint32_t v) {
+            v &= 0x0000ffff;
+            v = (v | (v << 8)) & 0x00ff00ff;
+            v = (v | (v << 4)) & 0x0f0f0f0f;
+            v = (v | (v << 2)) & 0x33333333;
+            v = (v | (v << 1)) & 0x55555555;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+
+    // first hits of one pixel's samples, summed for the AOVs
+    struct FirstHitSums
+    {
+        Vec3 albedo = Vec3(0, 0, 0);
+        Vec3 normal = Vec3(0, 0, 0);
+        double depth = 0;
+        uint32_t numSamples = 0;
+        uint32_t numHits = 0;
+
+        void add(const FirstHit &hit)
+        {
+            albedo += hit.albedo;
+            normal += hit.normal;
+            ++numSamples;
+            if (std::isfinite(hit.depth))
+            {
+                depth += hit.depth;
+                ++numHits;
+            }
+        }
+
+        // squaredDeviations: of the luminance over the pixel's numSamples samples
+        void store(double squaredDeviations, uint32_t pixel, AovBuffers &aovs) const
+        {
+            const double infinity = std::numeric_limits<double>::infinity();
+            double n = std::max(1u, numSamples);
+            aovs.albedo[pixel] = albedo / n;
+            aovs.normal[pixel] = normal / n;
+            aovs.depth[pixel] = numHits > 0 ? depth / numHits : infinity;
+            aovs.variance[pixel] = numSamples >= 2 ? squaredDeviations / (n - 1) / n : infinity;
+        }
+    };
+}
+
+Renderer::Renderer(const RenderSettings &settings)
+    : settings(settings), integrator(settings.minDepth, settings.maxDepth, settings.nextEventEstimation), pool(settings.numThreads), tileBuffers(pool.size()),
+      pixelSamples((size_t)settings.imageWidth * settings.imageHeight), denoiser(settings.imageWidth, settings.imageHeight)
+{
+    int tileSize = settings.tileSize;
+    int tilesX = (settings.imageWidth + tileSize - 1) / tileSize;
+    int tilesY = (settings.imageHeight + tileSize - 1) / tileSize;
+
+    std::vector<std::pair<uint32_t, Tile>> ordered;
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            Tile tile = {tx * tileSize, ty * tileSize,
+                         std::min((tx + 1) * tileSize, settings.imageWidth),
+                         std::min((ty + 1) * tileSize, settings.imageHeight)};
+            ordered.push_back({mortonCode(tx, ty), tile});
+        }
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    for (const auto &entry : ordered)
+    {
+        tiles.push_back(entry.second);
+    }
+
+    for (auto &buffer : tileBuffers)
+    {
+        buffer.resize(tileSize * tileSize);
+    }
+}
+
+void Renderer::copyTile(const Tile &tile, const Vec3 *pixels, std::vector<Vec3> &framebuffer) const
+{
+    // tiles cover disjoint pixels, so only this copy touches the shared framebuffer
+    int tileWidth = tile.x1 - tile.x0;
+    for (int y = tile.y0; y < tile.y1; ++y)
+    {
+        std::copy(pixels + (y - tile.y0) * tileWidth,
+                  pixels + (y - tile.y0 + 1) * tileWidth,
+                  framebuffer.begin() + y * settings.imageWidth + tile.x0);
+    }
+}
+
+void Renderer::render(const Camera &camera, const World &world, int frame, std::vector<Vec3> &framebuffer)
+{
+    integrator.setPixelSpread(camera.pixelSpreadAngle(settings.imageHeight));
+    framebuffer.resize(settings.imageWidth * settings.imageHeight);
+    AovBuffers *frameAovs = nullptr;
+    if (settings.collectAovs())
+    {
+        aovs.resize(framebuffer.size());
+        frameAovs = &aovs;
+    }
+
+    accumulation.clear();
+    pool.parallelFor(tiles.size(), [&](size_t tileIndex, size_t worker) {
+        std::vector<Vec3> &tileBuffer = tileBuffers[worker];
+        renderTile(camera, world, frame, tileIndex, 0, settings.samplesPerPixel, tileBuffer, pixelSamples, frameAovs);
+        copyTile(tiles[tileIndex], tileBuffer.data(), framebuffer);
+    });
+
+    if (settings.denoise)
+        denoiser.denoise(framebuffer, aovs, pool);
+}
+
+void Renderer::renderTiles(const Camera &camera, const World &world, int frame, const TileCallback &onTile)
+{
+    integrator.setPixelSpread(camera.pixelSpreadAngle(settings.imageHeight));
+    accumulation.clear();
+    pool.parallelFor(tiles.size(), [&](size_t tileIndex, size_t worker) {
+        std::vector<Vec3> &tileBuffer = tileBuffers[worker];
+        renderTile(camera, world, frame, tileIndex, 0, settings.samplesPerPixel, tileBuffer, pixelSamples);
+        onTile(tiles[tileIndex], tileBuffer.data());
+    });
+}
+
+int Renderer::renderProgressive(const Camera &camera, const World &world, int frame, std::vector<Vec3> &framebuffer,
+                                double &noise, const PassCallback &onPass)
+{
+    integrator.setPixelSpread(camera.pixelSpreadAngle(settings.imageHeight));
+    Stopwatch timer;
+    framebuffer.resize(settings.imageWidth * settings.imageHeight);
+    accumulation.assign(framebuffer.size(), PixelState());
+
+    int samplesDone = 0;
+    int passes = 0;
+    noise = std::numeric_limits<double>::infinity();
+
+    while (samplesDone < settings.samplesPerPixel)
+    {
+        // every pass doubles the samples so far, so the pass overhead stays logarithmic
+        int passEnd = std::min(settings.samplesPerPixel, std::max(1, 2 * samplesDone));
+        bool firstPass = passes == 0;
+
+        pool.parallelFor(tiles.size(), [&](size_t tileIndex, size_t worker) {
+            // past the deadline, remaining tiles keep their previous samples; the first
+            // pass always completes so that every pixel has a value
+            if (!firstPass && settings.timeBudget > 0 && timer.elapsed() >= settings.timeBudget)
+                return;
+
+            std::vector<Vec3> &tileBuffer = tileBuffers[worker];
+            renderTile(camera, world, frame, tileIndex, samplesDone, passEnd, tileBuffer, pixelSamples);
+            copyTile(tiles[tileIndex], tileBuffer.data(), framebuffer);
+        });
+
+        samplesDone = passEnd;
+        passes++;
+
+        // root mean square of the per-pixel error estimates
+        double sumSquares = 0;
+        for (const PixelState &state : accumulation)
+        {
+            double error = displayError(state);
+            sumSquares += error * error;
+        }
+        noise = std::sqrt(sumSquares / accumulation.size());
+
+        if (onPass)
+            onPass(passes, samplesDone, noise);
+
+        if (settings.timeBudget > 0 && timer.elapsed() >= settings.timeBudget)
+            break;
+        if (settings.noiseTarget > 0 && noise <= settings.noiseTarget)
+            break;
+    }
+
+    accumulation.clear();
+    return passes;
+}
+
+void Renderer::renderFrames(const Camera &camera, std::vector<FrameJob> &jobs)
+{
+    integrator.setPixelSpread(camera.pixelSpreadAngle(settings.imageHeight));
+    accumulation.clear();
+    for (FrameJob &job : jobs)
+    {
+        job.framebuffer->resize(settings.imageWidth * settings.imageHeight);
+        job.sampleCounts.resize(pixelSamples.size());
+        if (settings.collectAovs())
+            job.aovs.resize(pixelSamples.size());
+    }
+
+    pool.parallelFor(jobs.size() * tiles.size(), [&](size_t task, size_t worker) {
+        FrameJob &job = jobs[task / tiles.size()];
+        size_t tileIndex = task % tiles.size();
+        std::vector<Vec3> &tileBuffer = tileBuffers[worker];
+        renderTile(camera, *job.world, job.frame, tileIndex, 0, settings.samplesPerPixel, tileBuffer, job.sampleCounts,
+                   settings.collectAovs() ? &job.aovs : nullptr);
+        copyTile(tiles[tileIndex], tileBuffer.data(), *job.framebuffer);
+    });
+
+    if (settings.denoise)
+    {
+        for (FrameJob &job : jobs)
+        {
+            denoiser.denoise(*job.framebuffer, job.aovs, pool);
+        }
+    }
+}
+
+void Renderer::renderSingleTile(const Camera &camera, const World &world, int frame, size_t tileIndex, std::vector<Vec3> &pixels)
+{
+    integrator.setPixelSpread(camera.pixelSpreadAngle(settings.imageHeight));
+    accumulation.clear();
+    pixels.resize(settings.tileSize * settings.tileSize);
+    renderTile(camera, world, frame, tileIndex, 0, settings.samplesPerPixel, pixels, pixelSamples);
+}
+
+double Renderer::displayError(const PixelState &state)
+{
+    uint32_t n = state.numSamples;
+    if (n < 2)
+        return std::numeric_limits<double>::infinity();
+
+    double standardError = std::sqrt(state.squaredDeviations / (n - 1) / n);
+    // error of the gamma 2 encoded value: d sqrt(L) = dL / (2 sqrt(L))
+    return standardError / (2 * std::sqrt(std::max(state.meanLuminance, MIN_LUMINANCE)));
+}
+
+void Renderer::renderTile(const Camera &camera, const World &world, int frame, size_t tileIndex,
+                          int sampleBegin, int sampleEnd, std::vector<Vec3> &tileBuffer, std::vector<uint32_t> &sampleCounts,
+                          AovBuffers *frameAovs)
+{
+    if (settings.wavefront)
+    {
+        renderTileWavefront(camera, world, frame, tileIndex, sampleBegin, sampleEnd, tileBuffer, sampleCounts, frameAovs);
+        return;
+    }
+
+    const Tile &tile = tiles[tileIndex];
+    int tileWidth = tile.x1 - tile.x0;
+    int imageWidth = settings.imageWidth;
+    int imageHeight = settings.imageHeight;
+    int samplesPerPixel = settings.samplesPerPixel;
+    int minSamples = settings.adaptive ? settings.minSamples : samplesPerPixel;
+    int numSamples = sampleEnd - sampleBegin;
+    const int lanes = RayPacket::SIZE;
+
+    // camera dimensions of the samples of each pixel in a block, per pixel:
+    // jitter x, jitter y, time, lens x | lens y, unused...
+    const int samplesStride = 8 * numSamples;
+    std::vector<double> cameraSamples(lanes * samplesStride);
+
+    RayPacket packet;
+    HitRecord recs[RayPacket::SIZE];
+    Ray rays[RayPacket::SIZE];
+
+    // the block is done once all its pixels are precise enough; deciding per block
+    // rather than per pixel keeps pixels whose first samples all missed a rare
+    // feature (zero variance) sampling as long as their neighbours do
+    auto blockConverged = [&](const PixelState *state, uint32_t laneMask) {
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            if ((laneMask & (1u << lane)) && !(displayError(state[lane]) <= settings.noiseThreshold))
+                return false;
+        }
+        return true;
+    };
+
+    // pixels are processed in blocks that match the packet footprint
+    for (int by = tile.y0; by < tile.y1; by += RayPacket::HEIGHT)
+    {
+        for (int bx = tile.x0; bx < tile.x1; bx += RayPacket::WIDTH)
+        {
+            uint32_t pixels[RayPacket::SIZE];
+            uint32_t insideMask = 0; // lanes on pixels of this tile
+            PixelState state[RayPacket::SIZE];
+            FirstHitSums firstHits[RayPacket::SIZE];
+
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                int x = bx + lane % RayPacket::WIDTH;
+                int y = by + lane / RayPacket::WIDTH;
+                if (x >= tile.x1 || y >= tile.y1)
+                    continue;
+
+                insideMask |= 1u << lane;
+                pixels[lane] = (uint32_t)(y * imageWidth + x);
+                if (!accumulation.empty())
+                    state[lane] = accumulation[pixels[lane]];
+            }
+
+            // lanes whose pixel still needs samples; earlier passes may have finished the block
+            uint32_t laneMask = insideMask;
+            if (sampleBegin >= minSamples && sampleBegin > 0 && blockConverged(state, laneMask))
+                laneMask = 0;
+
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                if (!(laneMask & (1u << lane)))
+                    continue;
+
+                double *laneSamples = &cameraSamples[lane * samplesStride];
+                util.cameraSamples(frame, pixels[lane], sampleBegin, numSamples, laneSamples);
+            }
+
+            for (int s = sampleBegin; s < sampleEnd && laneMask != 0; ++s)
+            {
+                int k = s - sampleBegin;
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (!(laneMask & (1u << lane)))
+                        continue;
+
+                    const double *laneSamples = &cameraSamples[lane * samplesStride];
+                    int i = bx + lane % RayPacket::WIDTH;
+                    int j = imageHeight - 1 - (by + lane / RayPacket::WIDTH);
+                    double u = double(i + laneSamples[k]) / double(imageWidth - 1);
+                    double v = double(j + laneSamples[numSamples + k]) / double(imageHeight - 1);
+                    double time = laneSamples[2 * numSamples + k];
+                    Vec3 lensPoint = Utility::pointInUnitDisk(laneSamples[3 * numSamples + k], laneSamples[4 * numSamples + k]);
+                    rays[lane] = camera.getRay(u, v, time, lensPoint);
+                }
+
+                uint32_t hitMask = 0;
+                if (settings.packets)
+                {
+                    packet.clear();
+                    for (int lane = 0; lane < lanes; ++lane)
+                    {
+                        if (laneMask & (1u << lane))
+                            packet.setRay(lane, rays[lane], std::numeric_limits<double>::infinity());
+                    }
+                    hitMask = world.intersectPacket(packet, 0.001, recs);
+                }
+
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (!(laneMask & (1u << lane)))
+                        continue;
+
+                    util.beginSample(frame, pixels[lane], s);
+                    int pathLength;
+                    FirstHit firstHit;
+                    FirstHit *aov = frameAovs ? &firstHit : nullptr;
+                    Vec3 sample = settings.packets
+                                      ? integrator.radiance(rays[lane], world, (hitMask >> lane) & 1, recs[lane], pathLength, aov)
+                                      : integrator.radiance(rays[lane], world, pathLength, aov);
+                    if (aov)
+                        firstHits[lane].add(firstHit);
+                    Metrics::countRay();
+                    Metrics::countPathSegments(pathLength);
+
+                    // running mean and squared deviations of the luminance (Welford)
+                    PixelState &pixel = state[lane];
+                    pixel.sum += sample;
+                    double luminance = 0.2126 * sample.x + 0.7152 * sample.y + 0.0722 * sample.z;
+                    uint32_t n = ++pixel.numSamples;
+                    double delta = luminance - pixel.meanLuminance;
+                    pixel.meanLuminance += delta / n;
+                    pixel.squaredDeviations += delta * (luminance - pixel.meanLuminance);
+                }
+
+                if (s + 1 >= minSamples && (s + 1 - minSamples) % ADAPTIVE_BATCH == 0 && s + 1 < samplesPerPixel &&
+                    blockConverged(state, laneMask))
+                    laneMask = 0;
+            }
+
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                if (!(insideMask & (1u << lane)))
+                    continue;
+
+                int x = bx + lane % RayPacket::WIDTH;
+                int y = by + lane / RayPacket::WIDTH;
+                Vec3 color = state[lane].sum;
+                color /= double(state[lane].numSamples);
+                tileBuffer[(y - tile.y0) * tileWidth + (x - tile.x0)] = color;
+                sampleCounts[pixels[lane]] = state[lane].numSamples;
+                if (!accumulation.empty())
+                    accumulation[pixels[lane]] = state[lane];
+                if (frameAovs)
+                    firstHits[lane].store(state[lane].squaredDeviations, pixels[lane], *frameAovs);
+            }
+        }
+    }
+}
+
+void Renderer::renderTileWavefront(const Camera &camera, const World &world, int frame, size_t tileIndex,
+                                   int sampleBegin, int sampleEnd, std::vector<Vec3> &tileBuffer, std::vector<uint32_t> &sampleCounts,
+                                   AovBuffers *frameAovs)
+{
+    // renderSingleTile runs on its callers' threads, so the queues belong to the thread rather than a worker
+    static thread_local Wavefront wavefront;
+
+    const Tile &tile = tiles[tileIndex];
+    int tileWidth = tile.x1 - tile.x0;
+    int imageWidth = settings.imageWidth;
+    int imageHeight = settings.imageHeight;
+    int samplesPerPixel = settings.samplesPerPixel;
+    int minSamples = settings.adaptive ? settings.minSamples : samplesPerPixel;
+    const int lanes = RayPacket::SIZE;
+
+    // the same pixel blocks as renderTile, so blocks converge alike
+    struct Block
+    {
+        int x0, y0;
+        uint32_t pixels[RayPacket::SIZE];
+        uint32_t insideMask = 0;
+        uint32_t laneMask = 0; // pixels still sampled
+        PixelState state[RayPacket::SIZE];
+        FirstHitSums firstHits[RayPacket::SIZE];
+    };
+    auto blockConverged = [&](const Block &block) {
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            if ((block.laneMask & (1u << lane)) && !(displayError(block.state[lane]) <= settings.noiseThreshold))
+                return false;
+        }
+        return true;
+    };
+
+    std::vector<Block> blocks;
+    for (int by = tile.y0; by < tile.y1; by += RayPacket::HEIGHT)
+    {
+        for (int bx = tile.x0; bx < tile.x1; bx += RayPacket::WIDTH)
+        {
+            Block block;
+            block.x0 = bx;
+            block.y0 = by;
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                int x = bx + lane % RayPacket::WIDTH;
+                int y = by + lane / RayPacket::WIDTH;
+                if (x >= tile.x1 || y >= tile.y1)
+                    continue;
+
+                block.insideMask |= 1u << lane;
+                block.pixels[lane] = (uint32_t)(y * imageWidth + x);
+                if (!accumulation.empty())
+                    block.state[lane] = accumulation[block.pixels[lane]];
+            }
+            block.laneMask = block.insideMask;
+            if (sampleBegin >= minSamples && sampleBegin > 0 && blockConverged(block))
+                block.laneMask = 0;
+            blocks.push_back(block);
+        }
+    }
+
+    std::vector<double> cameraSamples;
+    for (int waveBegin = sampleBegin; waveBegin < sampleEnd;)
+    {
+        size_t activePixels = 0;
+        for (const Block &block : blocks)
+        {
+            activePixels += popcount(block.laneMask);
+        }
+        if (activePixels == 0)
+            break;
+
+        // a wave ends at the next convergence test, or once it holds WAVE_PATHS paths
+        int waveEnd = std::min(sampleEnd, waveBegin + std::max(1, (int)(WAVE_PATHS / activePixels)));
+        if (waveBegin + 1 >= minSamples)
+        {
+            int nextTest = minSamples + ((waveBegin + 1 - minSamples + ADAPTIVE_BATCH - 1) / ADAPTIVE_BATCH) * ADAPTIVE_BATCH;
+            if (nextTest < samplesPerPixel)
+                waveEnd = std::min(waveEnd, nextTest);
+        }
+        else if (minSamples < samplesPerPixel)
+        {
+            waveEnd = std::min(waveEnd, minSamples);
+        }
+        int numSamples = waveEnd - waveBegin;
+
+        // generate: camera rays block by block, each sample's lanes together so they form packets
+        const int samplesStride = 8 * numSamples;
+        cameraSamples.resize(lanes * samplesStride);
+        wavefront.clear();
+        for (Block &block : blocks)
+        {
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                if (block.laneMask & (1u << lane))
+                    util.cameraSamples(frame, block.pixels[lane], waveBegin, numSamples, &cameraSamples[lane * samplesStride]);
+            }
+            for (int k = 0; k < numSamples; ++k)
+            {
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (!(block.laneMask & (1u << lane)))
+                        continue;
+
+                    const double *laneSamples = &cameraSamples[lane * samplesStride];
+                    int i = block.x0 + lane % RayPacket::WIDTH;
+                    int j = imageHeight - 1 - (block.y0 + lane / RayPacket::WIDTH);
+                    double u = double(i + laneSamples[k]) / double(imageWidth - 1);
+                    double v = double(j + laneSamples[numSamples + k]) / double(imageHeight - 1);
+                    double time = laneSamples[2 * numSamples + k];
+                    Vec3 lensPoint = Utility::pointInUnitDisk(laneSamples[3 * numSamples + k], laneSamples[4 * numSamples + k]);
+                    wavefront.addPath(camera.getRay(u, v, time, lensPoint), block.pixels[lane], waveBegin + k);
+                }
+            }
+        }
+
+        wavefront.trace(integrator, world, frame, settings.packets, frameAovs != nullptr);
+
+        // accumulate, in the order the paths were generated, i.e. every pixel's samples in order
+        size_t path = 0;
+        for (Block &block : blocks)
+        {
+            for (int k = 0; k < numSamples; ++k)
+            {
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    if (!(block.laneMask & (1u << lane)))
+                        continue;
+
+                    const Vec3 &sample = wavefront.radiance(path);
+                    if (frameAovs)
+                        block.firstHits[lane].add(wavefront.firstHit(path));
+                    Metrics::countRay();
+                    Metrics::countPathSegments(wavefront.pathLength(path));
+                    path++;
+
+                    // running mean and squared deviations of the luminance (Welford)
+                    PixelState &pixel = block.state[lane];
+                    pixel.sum += sample;
+                    double luminance = 0.2126 * sample.x + 0.7152 * sample.y + 0.0722 * sample.z;
+                    uint32_t n = ++pixel.numSamples;
+                    double delta = luminance - pixel.meanLuminance;
+                    pixel.meanLuminance += delta / n;
+                    pixel.squaredDeviations += delta * (luminance - pixel.meanLuminance);
+                }
+            }
+
+            if (waveEnd >= minSamples && (waveEnd - minSamples) % ADAPTIVE_BATCH == 0 && waveEnd < samplesPerPixel &&
+                blockConverged(block))
+                block.laneMask = 0;
+        }
+        waveBegin = waveEnd;
+    }
+
+    for (const Block &block : blocks)
+    {
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            if (!(block.insideMask & (1u << lane)))
+                continue;
+
+            int x = block.x0 + lane % RayPacket::WIDTH;
+            int y = block.y0 + lane / RayPacket::WIDTH;
+            Vec3 color = block.state[lane].sum;
+            color /= double(block.state[lane].numSamples);
+            tileBuffer[(y - tile.y0) * tileWidth + (x - tile.x0)] = color;
+            sampleCounts[block.pixels[lane]] = block.state[lane].numSamples;
+            if (!accumulation.empty())
+                accumulation[block.pixels[lane]] = block.state[lane];
+            if (frameAovs)
+                block.firstHits[lane].store(block.state[lane].squaredDeviations, block.pixels[lane], *frameAovs);
+        }
+    }
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "Sampler.hpp"
+
+namespace
+{
+    const double ONE_MINUS_EPSILON = 0x1.fffffffffffffp-1;
+
+    // lowbias32 (Wellons), a cheap full-avalanche 32-bit hash
+    uint32_t mix(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    uint32_t hashCombine(uint32_t hash, uint32_t value)
+    {
+        return mix(hash ^ (value + 0x9e3779b9u + (hash << 6) + (hash >> 2)));
+    }
+
+    uint32_t hashOf(uint32_t seed, uint32_t a, uint32_t b)
+    {
+        return hashCombine(hashCombine(seed, a), b);
+    }
+
+    double toUnit(uint32_t bits)
+    {
+        return bits * (1.0 / 4294967296.0);
+    }
+
+    uint32_t reverseBits(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        return __builtin_bswap32(x);
+    }
+
+    uint32_t seedFrom(uint64_t seed)
+    {
+        return mix((uint32_t)seed ^ mix((uint32_t)(seed >> 32)));
+    }
+
+    /**
+     * Random permutation of [0, length) indexed by i, from Kensler, "Correlated
+     * Multi-Jittered Sampling", 2013. Cycle-walks a hash on the next power of two.
+    */
+    uint32_t permute(uint32_t i, uint32_t length, uint32_t key)
+    {
+        uint32_t w = length - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do
+        {
+            i ^= key;
+            i *= 0xe170893du;
+            i ^= key >> 16;
+            i ^= (i & w) >> 4;
+            i ^= key >> 8;
+            i *= 0x0929eb3fu;
+            i ^= key >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | key >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303u;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= length);
+        return (i + key) % length;
+    }
+
+    // generator matrix of Sobol' dimension 1 (primitive polynomial x + 1), applied a byte at a time
+    struct SobolMatrix
+    {
+        uint32_t byteTables[4][256];
+
+        SobolMatrix()
+        {
+            uint32_t columns[32];
+            uint32_t m = 1;
+            for (int k = 0; k < 32; ++k)
+            {
+                columns[k] = m << (31 - k);
+                m = (m << 1) ^ m;
+            }
+
+            for (int byte = 0; byte < 4; ++byte)
+            {
+                for (uint32_t value = 0; value < 256; ++value)
+                {
+                    uint32_t product = 0;
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        if (value & (1u << bit))
+                            product ^= columns[8 * byte + bit];
+                    }
+                    byteTables[byte][value] = product;
+                }
+            }
+        }
+    };
+
+    // spreads the low 16 bits of x to the even bits
+    uint32_t spreadBits(uint32_t x)
+    {
+        x &= 0x0000ffffu;
+        x = (x | (x << 8)) & 0x00ff00ffu;
+        x = (x | (x << 4)) & 0x0f0f0f0fu;
+        x = (x | (x << 2)) & 0x33333333u;
+        x = (x | (x << 1)) & 0x55555555u;
+        return x;
+    }
+
+    const SobolMatrix SOBOL_DIMENSION_1;
+}
+
+std::shared_ptr<const Sampler> Sampler::create(const std::string &name, uint64_t seed, int samplesPerPixel, int imageWidth)
+{
+    if (name == "random")
+        return nullptr;
+    if (name == "stratified")
+        return std::make_shared<StratifiedSampler>(seed, samplesPerPixel);
+    if (name == "sobol")
+        return std::make_shared<SobolSampler>(seed);
+    if (name == "bluenoise")
+        return std::make_shared<BlueNoiseSampler>(seed, samplesPerPixel, imageWidth);
+    throw std::invalid_argument("Unknown sampler: " + name);
+}
+
+bool Sampler::isValidName(const std::string &name)
+{
+    return name == "random" || name == "stratified" || name == "sobol" || name == "bluenoise";
+}
+
+StratifiedSampler::StratifiedSampler(uint64_t seed, int samplesPerPixel)
+    : seed(seedFrom(seed)), samplesPerPixel((uint32_t)std::max(1, samplesPerPixel))
+{
+    gridSize = std::max(1u, (uint32_t)std::sqrt((double)this->samplesPerPixel));
+    while ((gridSize + 1) * (gridSize + 1) <= this->samplesPerPixel)
+        ++gridSize;
+    while (gridSize * gridSize > this->samplesPerPixel)
+        --gridSize;
+}
+
+uint64_t StratifiedSampler::pixelKey(uint32_t frame, uint32_t pixel) const
+{
+    return hashOf(seed, frame, pixel);
+}
+
+void StratifiedSampler::getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const
+{
+    uint32_t generation = sample / samplesPerPixel;
+    uint32_t index = sample % samplesPerPixel;
+    uint32_t pairHash = hashOf((uint32_t)pixelKey, pair, generation);
+    uint32_t sampleHash = hashCombine(pairHash, index);
+    double jitterX = toUnit(hashCombine(sampleHash, 1));
+    double jitterY = toUnit(hashCombine(sampleHash, 2));
+
+    uint32_t numCells = gridSize * gridSize;
+    if (index >= numCells)
+    {
+        first = jitterX;
+        second = jitterY;
+        return;
+    }
+
+    uint32_t cell = permute(index, numCells, pairHash);
+    first = std::min(ONE_MINUS_EPSILON, (cell % gridSize + jitterX) / gridSize);
+    second = std::min(ONE_MINUS_EPSILON, (cell / gridSize + jitterY) / gridSize);
+}
+
+SobolSampler::SobolSampler(uint64_t seed) : seed(seedFrom(seed))
+{
+}
+
+uint32_t SobolSampler::sobol(uint32_t index, int dimension)
+{
+    if (dimension == 0)
+        return reverseBits(index); // van der Corput
+
+    const uint32_t(*tables)[256] = SOBOL_DIMENSION_1.byteTables;
+    return tables[0][index & 0xff] ^ tables[1][(index >> 8) & 0xff] ^ tables[2][(index >> 16) & 0xff] ^ tables[3][index >> 24];
+}
+
+uint32_t SobolSampler::nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+    // Laine-Karras style hash on the reversed bits: every bit only depends on the bits above it
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+uint64_t SobolSampler::pixelKey(uint32_t frame, uint32_t pixel) const
+{
+    return hashOf(seed, frame, pixel);
+}
+
+void SobolSampler::scrambledPair(uint32_t index, uint32_t pairHash, double &first, double &second)
+{
+    // Owen-scrambled index order, then Owen-scrambled points, each with its own seed
+    index = nestedUniformScramble(index, pairHash);
+    first = toUnit(nestedUniformScramble(sobol(index, 0), hashCombine(pairHash, 1)));
+    second = toUnit(nestedUniformScramble(sobol(index, 1), hashCombine(pairHash, 2)));
+}
+
+void SobolSampler::getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const
+{
+    scrambledPair(sample, hashCombine((uint32_t)pixelKey, pair), first, second);
+}
+
+BlueNoiseSampler::BlueNoiseSampler(uint64_t seed, int samplesPerPixel, int imageWidth)
+    : seed(seedFrom(seed)), imageWidth((uint32_t)std::max(1, imageWidth))
+{
+    blockSize = 1;
+    while (blockSize < (uint32_t)samplesPerPixel && blockSize < (1u << 16))
+        blockSize <<= 1;
+}
+
+uint64_t BlueNoiseSampler::pixelKey(uint32_t frame, uint32_t pixel) const
+{
+    uint32_t x = pixel % imageWidth;
+    uint32_t y = pixel / imageWidth;
+    uint32_t tileHash = hashOf(seed, frame, (y / TILE_SIZE) * 65536 + x / TILE_SIZE);
+
+    // Morton code of the pixel in its tile, children of every quad visited in a random order
+    uint32_t morton = spreadBits(x % TILE_SIZE) | (spreadBits(y % TILE_SIZE) << 1);
+    uint32_t order = SobolSampler::nestedUniformScramble(morton << (32 - 2 * TILE_BITS), tileHash) >> (32 - 2 * TILE_BITS);
+    return (uint64_t)order << 32 | tileHash;
+}
+
+void BlueNoiseSampler::getPair(uint64_t pixelKey, uint32_t sample, uint32_t pair, double &first, double &second) const
+{
+    // pixel k owns points [k * blockSize, (k + 1) * blockSize) of its tile's sequence
+    uint32_t order = (uint32_t)(pixelKey >> 32);
+    uint32_t pairHash = hashOf((uint32_t)pixelKey, pair, sample / blockSize);
+    SobolSampler::scrambledPair(order * blockSize + sample % blockSize, pairHash, first, second);
+}
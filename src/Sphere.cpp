@@ -4,6 +4,10 @@
 #include "globals.hpp"
 #include "Hittable.hpp"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 Sphere::Sphere(const Vec3 &center, double radius, const Material *material)
     : center_start(center), center_end(center), radius(radius), Hittable(material)
 {
@@ -58,7 +62,7 @@ bool Sphere::intersect(const Ray &ray, double tMin, double tMax, HitRecord &rec)
             {
                 rec.t = tTemp;
                 rec.point = ray.at(rec.t);
-                rec.normal = (rec.point - current_center) / radius;
+                rec.setFaceNormal(ray, (rec.point - current_center) / radius);
                 rec.material = material;
                 return true;
             }
@@ -67,7 +71,7 @@ bool Sphere::intersect(const Ray &ray, double tMin, double tMax, HitRecord &rec)
             {
                 rec.t = tTemp;
                 rec.point = ray.at(rec.t);
-                rec.normal = (rec.point - current_center) / radius;
+                rec.setFaceNormal(ray, (rec.point - current_center) / radius);
                 rec.material = material;
                 return true;
             }
@@ -76,6 +80,54 @@ bool Sphere::intersect(const Ray &ray, double tMin, double tMax, HitRecord &rec)
     return false;
 }
 
+void Sphere::intersectPacket(RayPacket &packet, uint32_t activeMask, double t_min, int id) const
+{
+    const int SIZE = RayPacket::SIZE;
+    alignas(64) double a[SIZE], halfB[SIZE], discriminant[SIZE], root[SIZE], tHit[SIZE], hit[SIZE];
+    Vec3 start = center_start, motion = center_end - center_start;
+    double radiusSquared = radius * radius;
+
+    // branch-free passes over all lanes so each one vectorizes; hits are 1.0 / 0.0 until the end
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        double time = packet.time[lane];
+        double ocx = packet.ox[lane] - (start.x + motion.x * time);
+        double ocy = packet.oy[lane] - (start.y + motion.y * time);
+        double ocz = packet.oz[lane] - (start.z + motion.z * time);
+        double dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+
+        a[lane] = dx * dx + dy * dy + dz * dz;
+        halfB[lane] = ocx * dx + ocy * dy + ocz * dz;
+        double c = ocx * ocx + ocy * ocy + ocz * ocz - radiusSquared;
+        discriminant[lane] = halfB[lane] * halfB[lane] - a[lane] * c;
+    }
+
+    // std::sqrt sets errno on negative input, which keeps it scalar at -O2
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        root[lane] = std::sqrt(discriminant[lane] > 0 ? discriminant[lane] : 0.0);
+    }
+
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        double tNear = (-halfB[lane] - root[lane]) / a[lane];
+        double tFar = (-halfB[lane] + root[lane]) / a[lane];
+        double tMax = packet.tMax[lane];
+        bool nearValid = (tNear < tMax) & (tNear > t_min);
+        bool farValid = (tFar < tMax) & (tFar > t_min);
+
+        tHit[lane] = nearValid ? tNear : tFar;
+        hit[lane] = ((discriminant[lane] > 0) & (nearValid | farValid)) ? 1.0 : 0.0;
+    }
+
+    uint32_t hitMask = 0;
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        hitMask |= (uint32_t)(hit[lane] != 0) << lane;
+    }
+    packet.recordHits(hitMask & activeMask, tHit, id);
+}
+
 void Sphere::moveTo(const Vec3 &pos)
 {
     Vec3 offset = pos - center_start;
@@ -93,4 +145,61 @@ void Sphere::translate(const Vec3 &offset)
     center_end += offset;
     boundingBox.min += offset;
     boundingBox.max += offset;
+}
+
+std::shared_ptr<Hittable> Sphere::clone() const
+{
+    return std::make_shared<Sphere>(*this);
+}
+
+bool Sphere::coneCosine(const Vec3 &origin, double time, double &cosMax) const
+{
+    double distanceSquared = (centerAt(time) - origin).lengthSquared();
+    if (distanceSquared <= radius * radius)
+        return false;
+    cosMax = std::sqrt(1.0 - radius * radius / distanceSquared);
+    return true;
+}
+
+bool Sphere::sampleDirection(const Vec3 &origin, double time, double u1, double u2, Vec3 &direction, double &distance,
+                             double &pdf) const
+{
+    double cosMax;
+    if (!coneCosine(origin, time, cosMax))
+        return false;
+
+    // orthonormal basis around the direction to the center
+    Vec3 w = (centerAt(time) - origin).normalize();
+    Vec3 helper = std::fabs(w.x) > 0.9 ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Vec3 u = w.cross(helper).normalize();
+    Vec3 v = w.cross(u);
+
+    double cosTheta = 1.0 + u1 * (cosMax - 1.0);
+    double sinTheta = std::sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+    double phi = 2.0 * M_PI * u2;
+    direction = u * (std::cos(phi) * sinTheta) + v * (std::sin(phi) * sinTheta) + w * cosTheta;
+
+    // the near side, where a ray in this direction enters the sphere
+    Vec3 oc = origin - centerAt(time);
+    double halfB = oc.dot(direction);
+    double discriminant = halfB * halfB - (oc.lengthSquared() - radius * radius);
+    distance = -halfB - std::sqrt(std::max(0.0, discriminant));
+    pdf = 1.0 / (2.0 * M_PI * (1.0 - cosMax));
+    return true;
+}
+
+double Sphere::directionPdf(const Vec3 &origin, double time, const Vec3 &direction) const
+{
+    double cosMax;
+    if (!coneCosine(origin, time, cosMax))
+        return 0;
+    return 1.0 / (2.0 * M_PI * (1.0 - cosMax));
+}
+
+double Sphere::solidAngle(const Vec3 &origin, double time) const
+{
+    double cosMax;
+    if (!coneCosine(origin, time, cosMax))
+        return 0;
+    return 2.0 * M_PI * (1.0 - cosMax);
 }
\ No newline at end of file
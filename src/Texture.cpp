@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#ifdef MINGW
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Texture.hpp"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+namespace
+{
+    const char MAGIC[8] = {'R', 'T', 'T', 'E', 'X', 0, 0, 0};
+    const uint32_t BYTE_ORDER_MARK = 0x01020304u;
+    const uint32_t MAX_LEVELS = 32;
+    const int FRONT_TILES = 16; // per thread, direct mapped
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t tileBits;
+        uint32_t numLevels;
+        // source image
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        // tiles, from the start of the file
+        uint64_t dataOffset;
+        uint64_t numTiles;
+    };
+
+    // the last tiles this thread used, so most lookups take no lock
+    struct FrontCache
+    {
+        uint64_t keys[FRONT_TILES];
+        TextureCache::TilePtr tiles[FRONT_TILES];
+
+        FrontCache() { std::fill(keys, keys + FRONT_TILES, ~0ull); }
+    };
+
+    thread_local FrontCache frontCache;
+    std::atomic<uint64_t> nextTextureId{1};
+
+    // gamma 2 encoded byte -> linear
+    struct DecodeTable
+    {
+        float values[256];
+
+        DecodeTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                values[i] = (float)(i / 255.0 * (i / 255.0));
+            }
+        }
+    };
+
+    const DecodeTable decodeTable;
+
+    Vec3 decode(const uint8_t *rgba)
+    {
+        return Vec3(decodeTable.values[rgba[0]], decodeTable.values[rgba[1]], decodeTable.values[rgba[2]]);
+    }
+
+    uint8_t encode(float linear)
+    {
+        return (uint8_t)std::lround(std::sqrt(std::min(std::max(linear, 0.0f), 1.0f)) * 255);
+    }
+
+    // texel offset inside a tile: the bits of x and y interleaved
+    uint32_t morton(uint32_t x, uint32_t y)
+    {
+        auto spread = [](uint32_t bits) {
+            bits = (bits | (bits << 4)) & 0x0f0fu;
+            bits = (bits | (bits << 2)) & 0x3333u;
+            bits = (bits | (bits << 1)) & 0x5555u;
+            return bits;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+
+    uint64_t alignUp(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t tilesFor(uint32_t texels)
+    {
+        return (texels + TextureCache::TILE_SIZE - 1) / TextureCache::TILE_SIZE;
+    }
+
+    uint64_t keyOf(uint64_t textureId, uint64_t tileIndex)
+    {
+        return textureId << 40 | tileIndex;
+    }
+
+    // reads a plain (P3) or raw (P6) PPM as linear RGB
+    std::vector<float> readPpm(const std::string &path, uint32_t &width, uint32_t &height)
+    {
+        MappedFile file(path);
+        const char *p = file.data();
+        const char *end = p + file.size();
+        auto fail = [&](const char *what) -> std::runtime_error {
+            return std::runtime_error(path + ": " + what);
+        };
+
+        // whitespace and comments between header fields
+        auto skip = [&]() {
+            while (p < end && (std::isspace((unsigned char)*p) || *p == '#'))
+            {
+                if (*p == '#')
+                {
+                    while (p < end && *p != '\n')
+                        p++;
+                }
+                else
+                {
+                    p++;
+                }
+            }
+        };
+        auto number = [&](uint32_t &value) {
+            skip();
+            std::from_chars_result result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+                throw fail("malformed PPM");
+            p = result.ptr;
+        };
+
+        if (end - p < 2 || p[0] != 'P' || (p[1] != '3' && p[1] != '6'))
+            throw fail("not a P3 or P6 PPM");
+        bool binary = p[1] == '6';
+        p += 2;
+
+        uint32_t maxValue;
+        number(width);
+        number(height);
+        number(maxValue);
+        if (width == 0 || height == 0 || width > 65536 || height > 65536 || maxValue == 0 || maxValue > 65535)
+            throw fail("unsupported PPM size or maximum value");
+
+        size_t numValues = (size_t)width * height * 3;
+        std::vector<float> linear(numValues);
+        if (binary)
+        {
+            p++; // the single whitespace after the maximum value
+            size_t bytesPerValue = maxValue > 255 ? 2 : 1;
+            if ((size_t)(end - p) < numValues * bytesPerValue)
+                throw fail("truncated PPM");
+            const unsigned char *raw = reinterpret_cast<const unsigned char *>(p);
+            for (size_t i = 0; i < numValues; ++i)
+            {
+                uint32_t value = bytesPerValue == 2 ? (raw[2 * i] << 8 | raw[2 * i + 1]) : raw[i];
+                double encoded = std::min(value, maxValue) / (double)maxValue;
+                linear[i] = (float)(encoded * encoded);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < numValues; ++i)
+            {
+                uint32_t value;
+                number(value);
+                double encoded = std::min(value, maxValue) / (double)maxValue;
+                linear[i] = (float)(encoded * encoded);
+            }
+        }
+        return linear;
+    }
+
+    // the cache file of a PPM: header, level table and tiles of the whole mip chain
+    std::vector<uint8_t> convert(const std::string &ppmPath, const FileStamp &source)
+    {
+        uint32_t width, height;
+        std::vector<float> image = readPpm(ppmPath, width, height);
+
+        std::vector<Texture::Level> levels;
+        uint64_t numTiles = 0;
+        for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+        {
+            Texture::Level level = {w, h, tilesFor(w), tilesFor(h), numTiles};
+            numTiles += (uint64_t)level.tilesX * level.tilesY;
+            levels.push_back(level);
+            if (w == 1 && h == 1)
+                break;
+        }
+
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = Texture::VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.tileBits = TextureCache::TILE_BITS;
+        header.numLevels = (uint32_t)levels.size();
+        header.sourceSize = source.size;
+        header.sourceTime = source.time;
+        header.sourceHash = MappedFile(ppmPath).hash();
+        header.dataOffset = alignUp(sizeof(Header) + levels.size() * sizeof(Texture::Level), TextureCache::TILE_BYTES);
+        header.numTiles = numTiles;
+
+        std::vector<uint8_t> bytes(header.dataOffset + numTiles * TextureCache::TILE_BYTES, 0);
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        std::memcpy(bytes.data() + sizeof(header), levels.data(), levels.size() * sizeof(Texture::Level));
+
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            const Texture::Level &level = levels[l];
+            if (l > 0)
+            {
+                // 2x2 box filter of the level above, in linear space
+                const Texture::Level &above = levels[l - 1];
+                std::vector<float> next((size_t)level.width * level.height * 3);
+                for (uint32_t y = 0; y < level.height; ++y)
+                {
+                    uint32_t y0 = std::min(2 * y, above.height - 1), y1 = std::min(2 * y + 1, above.height - 1);
+                    for (uint32_t x = 0; x < level.width; ++x)
+                    {
+                        uint32_t x0 = std::min(2 * x, above.width - 1), x1 = std::min(2 * x + 1, above.width - 1);
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            next[((size_t)y * level.width + x) * 3 + c] =
+                                0.25f * (image[((size_t)y0 * above.width + x0) * 3 + c] + image[((size_t)y0 * above.width + x1) * 3 + c] +
+                                         image[((size_t)y1 * above.width + x0) * 3 + c] + image[((size_t)y1 * above.width + x1) * 3 + c]);
+                        }
+                    }
+                }
+                image.swap(next);
+            }
+
+            // texels past the edge of the last tile row and column stay zero, addressing wraps before reaching them
+            for (uint32_t y = 0; y < level.height; ++y)
+            {
+                for (uint32_t x = 0; x < level.width; ++x)
+                {
+                    uint64_t tileIndex = level.firstTile + (uint64_t)(y >> TextureCache::TILE_BITS) * level.tilesX + (x >> TextureCache::TILE_BITS);
+                    uint8_t *texel = bytes.data() + header.dataOffset + tileIndex * TextureCache::TILE_BYTES +
+                                     4 * morton(x & (TextureCache::TILE_SIZE - 1), y & (TextureCache::TILE_SIZE - 1));
+                    const float *rgb = &image[((size_t)y * level.width + x) * 3];
+                    texel[0] = encode(rgb[0]);
+                    texel[1] = encode(rgb[1]);
+                    texel[2] = encode(rgb[2]);
+                    texel[3] = 255;
+                }
+            }
+        }
+        return bytes;
+    }
+}
+
+TextureCache::TextureCache(size_t capacityBytes)
+    : tilesPerShard(std::max<size_t>(1, capacityBytes / TILE_BYTES / SHARDS))
+{
+}
+
+TextureCache::TilePtr TextureCache::get(uint64_t key, const TileLoader &load)
+{
+    Shard &shard = shards[(key * 0x9e3779b97f4a7c15ull) >> 60];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return found->second->second;
+        }
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    auto tile = std::make_shared<Tile>();
+    if (!load(*tile))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end())
+    {
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        return found->second->second;
+    }
+    shard.lru.emplace_front(key, tile);
+    shard.index.emplace(key, shard.lru.begin());
+    while (shard.lru.size() > tilesPerShard)
+    {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return tile;
+}
+
+TextureCache::Stats TextureCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::shared_ptr<Texture> Texture::load(const std::string &ppmPath, const std::string &cacheDir,
+                                       std::shared_ptr<TextureCache> cache)
+{
+    std::shared_ptr<Texture> texture(new Texture());
+    texture->cache = std::move(cache);
+    texture->id = nextTextureId.fetch_add(1);
+
+    FileStamp source;
+    if (!FileStamp::read(ppmPath, source))
+        throw std::runtime_error("Filepath does not exist: " + ppmPath + ". Please ensure given path is relative to program execution location.");
+
+    std::string cachePath = cachePathFor(ppmPath, cacheDir, "texcache");
+    if (texture->openCache(cachePath, ppmPath, source))
+        return texture;
+
+    std::vector<uint8_t> bytes = convert(ppmPath, source);
+    texture->converted = true;
+    if (replaceFile(cachePath, bytes.data(), bytes.size()) && texture->openCache(cachePath, ppmPath, source))
+        return texture;
+
+    if (!texture->readLayout(bytes.data(), bytes.size(), bytes.size()))
+        throw std::runtime_error("Could not convert texture: " + ppmPath);
+    texture->resident = std::move(bytes);
+    return texture;
+}
+
+Texture::~Texture()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool Texture::openCache(const std::string &cachePath, const std::string &ppmPath, const FileStamp &source)
+{
+    fd = ::open(cachePath.c_str(), O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return false;
+
+    // everything is read through the one descriptor, so a cache replaced meanwhile is never half seen
+    struct stat info;
+    Header header;
+    bool usable = fstat(fd, &info) == 0 && readAt(0, sizeof(header), &header) &&
+                  std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                  header.byteOrder == BYTE_ORDER_MARK && header.numLevels >= 1 && header.numLevels <= MAX_LEVELS &&
+                  header.sourceSize == source.size;
+    bool refresh = false;
+    if (usable && header.sourceTime != source.time)
+    {
+        // touched or checked out again; the contents decide
+        try
+        {
+            usable = MappedFile(ppmPath).hash() == header.sourceHash;
+        }
+        catch (const std::runtime_error &e)
+        {
+            usable = false;
+        }
+        refresh = usable;
+    }
+
+    if (usable)
+    {
+        std::vector<uint8_t> layout(sizeof(Header) + header.numLevels * sizeof(Level));
+        usable = readAt(0, layout.size(), layout.data()) && readLayout(layout.data(), layout.size(), (uint64_t)info.st_size);
+    }
+    if (!usable)
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    if (refresh)
+    {
+        std::vector<uint8_t> bytes((size_t)info.st_size);
+        if (readAt(0, bytes.size(), bytes.data()))
+        {
+            header.sourceTime = source.time;
+            std::memcpy(bytes.data(), &header, sizeof(header));
+            replaceFile(cachePath, bytes.data(), bytes.size());
+        }
+    }
+    return true;
+}
+
+bool Texture::readLayout(const uint8_t *bytes, size_t available, uint64_t fileSize)
+{
+    Header header;
+    if (available < sizeof(header))
+        return false;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (header.tileBits != TextureCache::TILE_BITS || header.numLevels < 1 || header.numLevels > MAX_LEVELS ||
+        available < sizeof(Header) + header.numLevels * sizeof(Level))
+        return false;
+
+    std::vector<Level> table(header.numLevels);
+    std::memcpy(table.data(), bytes + sizeof(Header), table.size() * sizeof(Level));
+
+    // each level halves the one above down to 1x1, and the tiles follow one another
+    uint64_t numTiles = 0;
+    for (size_t l = 0; l < table.size(); ++l)
+    {
+        const Level &level = table[l];
+        bool sizeValid = l == 0 ? level.width >= 1 && level.height >= 1 && level.width <= 65536 && level.height <= 65536
+                                : level.width == std::max(1u, table[l - 1].width / 2) && level.height == std::max(1u, table[l - 1].height / 2);
+        if (!sizeValid || level.tilesX != tilesFor(level.width) || level.tilesY != tilesFor(level.height) || level.firstTile != numTiles)
+            return false;
+        numTiles += (uint64_t)level.tilesX * level.tilesY;
+    }
+    const Level &last = table.back();
+    if (last.width != 1 || last.height != 1 || header.numTiles != numTiles ||
+        header.dataOffset % TextureCache::TILE_BYTES != 0 || header.dataOffset < available ||
+        header.dataOffset > fileSize || numTiles > (fileSize - header.dataOffset) / TextureCache::TILE_BYTES)
+        return false;
+
+    levels = std::move(table);
+    dataOffset = header.dataOffset;
+    return true;
+}
+
+bool Texture::readAt(uint64_t offset, size_t size, void *out) const
+{
+    char *data = static_cast<char *>(out);
+#ifdef MINGW
+    std::lock_guard<std::mutex> lock(fileMutex);
+    return lseek(fd, (off_t)offset, SEEK_SET) >= 0 && read(fd, data, size) == (int)size;
+#else
+    while (size > 0)
+    {
+        ssize_t got = pread(fd, data, size, (off_t)offset);
+        if (got <= 0)
+            return false;
+        data += got;
+        size -= got;
+        offset += got;
+    }
+    return true;
+#endif
+}
+
+bool Texture::readTile(uint64_t tileIndex, TextureCache::Tile &out) const
+{
+    uint64_t offset = dataOffset + tileIndex * TextureCache::TILE_BYTES;
+    if (!resident.empty())
+    {
+        std::memcpy(out.data(), resident.data() + offset, TextureCache::TILE_BYTES);
+        return true;
+    }
+    return readAt(offset, TextureCache::TILE_BYTES, out.data());
+}
+
+const TextureCache::Tile *Texture::tileAt(uint64_t tileIndex) const
+{
+    uint64_t key = keyOf(id, tileIndex);
+    int slot = (int)((key * 0x9e3779b97f4a7c15ull) >> 60) & (FRONT_TILES - 1);
+    if (frontCache.keys[slot] != key)
+    {
+        TextureCache::TilePtr tile = cache->get(key, [&](TextureCache::Tile &out) {
+            return readTile(tileIndex, out);
+        });
+        if (!tile)
+            return nullptr;
+        frontCache.keys[slot] = key;
+        frontCache.tiles[slot] = std::move(tile);
+    }
+    return frontCache.tiles[slot].get();
+}
+
+Vec3 Texture::texel(int levelIndex, int x, int y) const
+{
+    const Level &level = levels[levelIndex];
+    uint32_t wrappedX = (uint32_t)(((x % (int)level.width) + (int)level.width) % (int)level.width);
+    uint32_t wrappedY = (uint32_t)(((y % (int)level.height) + (int)level.height) % (int)level.height);
+    const TextureCache::Tile *tile = tileAt(level.firstTile + (uint64_t)(wrappedY >> TextureCache::TILE_BITS) * level.tilesX +
+                                            (wrappedX >> TextureCache::TILE_BITS));
+    if (!tile)
+        return Vec3(0, 0, 0);
+    return decode(tile->data() + 4 * morton(wrappedX & (TextureCache::TILE_SIZE - 1), wrappedY & (TextureCache::TILE_SIZE - 1)));
+}
+
+Vec3 Texture::bilinear(int levelIndex, double u, double v) const
+{
+    // texel centers at half-integer coordinates, row 0 at the top (v = 1)
+    const Level &level = levels[levelIndex];
+    double x = u * level.width - 0.5;
+    double y = (1 - v) * level.height - 0.5;
+    double floorX = std::floor(x), floorY = std::floor(y);
+    double fx = x - floorX, fy = y - floorY;
+    int x0 = (int)floorX, y0 = (int)floorY;
+
+    // most footprints lie inside one tile: look it up once
+    const int innerMask = TextureCache::TILE_SIZE - 1;
+    if (x0 >= 0 && y0 >= 0 && (uint32_t)x0 + 1 < level.width && (uint32_t)y0 + 1 < level.height &&
+        (x0 & innerMask) != innerMask && (y0 & innerMask) != innerMask)
+    {
+        const TextureCache::Tile *tile = tileAt(level.firstTile + (uint64_t)(y0 >> TextureCache::TILE_BITS) * level.tilesX +
+                                                (x0 >> TextureCache::TILE_BITS));
+        if (!tile)
+            return Vec3(0, 0, 0);
+        int tx = x0 & innerMask, ty = y0 & innerMask;
+        const uint8_t *texels = tile->data();
+        Vec3 top = (1 - fx) * decode(texels + 4 * morton(tx, ty)) + fx * decode(texels + 4 * morton(tx + 1, ty));
+        Vec3 bottom = (1 - fx) * decode(texels + 4 * morton(tx, ty + 1)) + fx * decode(texels + 4 * morton(tx + 1, ty + 1));
+        return (1 - fy) * top + fy * bottom;
+    }
+
+    Vec3 top = (1 - fx) * texel(levelIndex, x0, y0) + fx * texel(levelIndex, x0 + 1, y0);
+    Vec3 bottom = (1 - fx) * texel(levelIndex, x0, y0 + 1) + fx * texel(levelIndex, x0 + 1, y0 + 1);
+    return (1 - fy) * top + fy * bottom;
+}
+
+Vec3 Texture::sample(double u, double v, double footprint) const
+{
+    if (!std::isfinite(u) || !std::isfinite(v))
+        return texel(0, 0, 0);
+    // into [0, 1), so the texel coordinates stay small
+    u -= std::floor(u);
+    v -= std::floor(v);
+
+    double lod = footprint > 0 ? std::log2(footprint * std::max(width(), height())) : 0;
+    int lastLevel = numLevels() - 1;
+    if (!(lod > 0))
+        return bilinear(0, u, v);
+    if (lod >= lastLevel)
+        return bilinear(lastLevel, u, v);
+
+    int level = (int)lod;
+    double blend = lod - level;
+    return (1 - blend) * bilinear(level, u, v) + blend * bilinear(level + 1, u, v);
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t numThreads) : numWorkers(std::max<size_t>(1, numThreads))
+{
+    for (size_t i = 0; i < numWorkers; ++i)
+    {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    // worker 0 is whichever thread calls parallelFor
+    for (size_t i = 1; i < numWorkers; ++i)
+    {
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t numTasks, const Task &fn)
+{
+    if (numTasks == 0)
+        return;
+
+    // contiguous chunks keep neighbouring tasks (e.g. tiles) on the same worker
+    size_t chunkSize = (numTasks + numWorkers - 1) / numWorkers;
+    for (size_t worker = 0; worker < numWorkers; ++worker)
+    {
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        size_t begin = std::min(numTasks, worker * chunkSize);
+        size_t end = std::min(numTasks, begin + chunkSize);
+        for (size_t task = begin; task < end; ++task)
+        {
+            queues[worker]->tasks.push_back(task);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &fn;
+        busyWorkers = numWorkers - 1;
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+    currentTask = nullptr;
+    if (failed)
+    {
+        // the queues may still hold the skipped tasks
+        for (auto &queue : queues)
+        {
+            std::lock_guard<std::mutex> queueLock(queue->mutex);
+            queue->tasks.clear();
+        }
+        failed = false;
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void ThreadPool::workerLoop(size_t worker)
+{
+    size_t seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+        }
+
+        drain(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        doneCondition.notify_one();
+    }
+}
+
+void ThreadPool::drain(size_t worker)
+{
+    size_t task;
+    while (!failed && popOrSteal(worker, task))
+    {
+        try
+        {
+            (*currentTask)(task, worker);
+        }
+        catch (...)
+        {
+            // an exception escaping a worker thread would terminate the process
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    }
+}
+
+bool ThreadPool::popOrSteal(size_t worker, size_t &task)
+{
+    {
+        WorkQueue &own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // no new tasks are queued during a run, so one empty sweep means we are done
+    for (size_t i = 1; i < numWorkers; ++i)
+    {
+        WorkQueue &victim = *queues[(worker + i) % numWorkers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -97,6 +97,53 @@ bool Triangle::intersect(const Ray &ray, double tMin, double tMax, HitRecord &re
     return false;
 }
 
+void Triangle::intersectPacket(RayPacket &packet, uint32_t activeMask, double t_min, int id) const
+{
+    const int SIZE = RayPacket::SIZE;
+    const double epsilon = std::numeric_limits<double>::epsilon();
+    alignas(64) double tHit[SIZE], hit[SIZE];
+    Vec3 v0 = v0_start, e1 = v1_start - v0_start, e2 = v2_start - v0_start;
+    Vec3 v0Motion = v0_end - v0_start, e1Motion = (v1_end - v1_start) - v0Motion, e2Motion = (v2_end - v2_start) - v0Motion;
+
+    // one branch-free pass over all lanes, so it vectorizes; hits are 1.0 / 0.0 until the end
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        double time = packet.time[lane];
+        double v0x = v0.x + v0Motion.x * time, v0y = v0.y + v0Motion.y * time, v0z = v0.z + v0Motion.z * time;
+        double e1x = e1.x + e1Motion.x * time, e1y = e1.y + e1Motion.y * time, e1z = e1.z + e1Motion.z * time;
+        double e2x = e2.x + e2Motion.x * time, e2y = e2.y + e2Motion.y * time, e2z = e2.z + e2Motion.z * time;
+        double dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+
+        // Moller-Trumbore, as in intersect
+        double px = dy * e2z - dz * e2y;
+        double py = dz * e2x - dx * e2z;
+        double pz = dx * e2y - dy * e2x;
+        double det = e1x * px + e1y * py + e1z * pz;
+        double invDet = 1 / det;
+
+        double tx = packet.ox[lane] - v0x, ty = packet.oy[lane] - v0y, tz = packet.oz[lane] - v0z;
+        double u = (tx * px + ty * py + tz * pz) * invDet;
+
+        double qx = ty * e1z - tz * e1y;
+        double qy = tz * e1x - tx * e1z;
+        double qz = tx * e1y - ty * e1x;
+        double v = (dx * qx + dy * qy + dz * qz) * invDet;
+        double t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+        bool valid = ((det >= epsilon) | (det <= -epsilon)) & (u >= 0) & (u <= 1) & (v >= 0) & (u + v <= 1) &
+                     (t >= t_min) & (t <= packet.tMax[lane]);
+        tHit[lane] = t;
+        hit[lane] = valid ? 1.0 : 0.0;
+    }
+
+    uint32_t hitMask = 0;
+    for (int lane = 0; lane < SIZE; ++lane)
+    {
+        hitMask |= (uint32_t)(hit[lane] != 0) << lane;
+    }
+    packet.recordHits(hitMask & activeMask, tHit, id);
+}
+
 void Triangle::moveTo(const Vec3 &pos)
 {
     Vec3 centroid_start = (v0_start + v1_start + v2_start) / 3.0;
@@ -119,4 +166,9 @@ void Triangle::translate(const Vec3 &offset)
     v2_end += offset;
     boundingBox.min += offset;
     boundingBox.max += offset;
+}
+
+std::shared_ptr<Hittable> Triangle::clone() const
+{
+    return std::make_shared<Triangle>(*this);
 }
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Hittable.hpp"
+#include "TriangleStore.hpp"
+
+void TriangleStore::clear()
+{
+    count = 0;
+    moving = false;
+    for (std::vector<double> *array : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z,
+                                       &dv0x, &dv0y, &dv0z, &de1x, &de1y, &de1z, &de2x, &de2y, &de2z})
+    {
+        array->clear();
+    }
+    materials.clear();
+    texcoords.clear();
+    uvScales.clear();
+}
+
+void TriangleStore::reserve(size_t capacity)
+{
+    for (std::vector<double> *array : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+    {
+        array->reserve(capacity + LANES);
+    }
+    materials.reserve(capacity);
+}
+
+void TriangleStore::resizeArrays(size_t capacity)
+{
+    // zeroed entries are degenerate (det == 0), so the kernel never reports them
+    for (std::vector<double> *array : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+    {
+        array->resize(capacity, 0.0);
+    }
+    if (moving)
+    {
+        for (std::vector<double> *array : {&dv0x, &dv0y, &dv0z, &de1x, &de1y, &de1z, &de2x, &de2y, &de2z})
+        {
+            array->resize(capacity, 0.0);
+        }
+    }
+}
+
+void TriangleStore::add(const Triangle &triangle)
+{
+    Vec3 v0 = triangle.v0_start;
+    Vec3 e1 = triangle.v1_start - triangle.v0_start;
+    Vec3 e2 = triangle.v2_start - triangle.v0_start;
+    Vec3 dv0 = triangle.v0_end - triangle.v0_start;
+    Vec3 de1 = (triangle.v1_end - triangle.v0_end) - e1;
+    Vec3 de2 = (triangle.v2_end - triangle.v0_end) - e2;
+
+    bool triangleMoves = dv0.length() > 0 || de1.length() > 0 || de2.length() > 0;
+    if (triangleMoves && !moving)
+    {
+        moving = true;
+        resizeArrays(v0x.size());
+    }
+
+    // every range [first, first + LANES) with first < count stays inside the arrays
+    size_t index = count++;
+    resizeArrays(count + LANES);
+
+    v0x[index] = v0.x, v0y[index] = v0.y, v0z[index] = v0.z;
+    e1x[index] = e1.x, e1y[index] = e1.y, e1z[index] = e1.z;
+    e2x[index] = e2.x, e2y[index] = e2.y, e2z[index] = e2.z;
+    if (moving)
+    {
+        dv0x[index] = dv0.x, dv0y[index] = dv0.y, dv0z[index] = dv0.z;
+        de1x[index] = de1.x, de1y[index] = de1.y, de1z[index] = de1.z;
+        de2x[index] = de2.x, de2y[index] = de2.y, de2z[index] = de2.z;
+    }
+    materials.push_back(triangle.material);
+    if (!uvScales.empty())
+    {
+        texcoords.resize(6 * count, 0.0f);
+        uvScales.push_back(0.0f);
+    }
+}
+
+void TriangleStore::add(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2, const Material *material, const float *corners)
+{
+    Vec3 e1 = v1 - v0;
+    Vec3 e2 = v2 - v0;
+    if (moving)
+    {
+        add(Triangle(v0, v1, v2, material));
+    }
+    else
+    {
+        size_t index = count++;
+        resizeArrays(count + LANES);
+
+        v0x[index] = v0.x, v0y[index] = v0.y, v0z[index] = v0.z;
+        e1x[index] = e1.x, e1y[index] = e1.y, e1z[index] = e1.z;
+        e2x[index] = e2.x, e2y[index] = e2.y, e2z[index] = e2.z;
+        materials.push_back(material);
+        if (!uvScales.empty())
+        {
+            texcoords.resize(6 * count, 0.0f);
+            uvScales.push_back(0.0f);
+        }
+    }
+
+    if (!corners)
+        return;
+    if (uvScales.empty())
+    {
+        texcoords.assign(6 * count, 0.0f);
+        uvScales.assign(count, 0.0f);
+    }
+    size_t index = count - 1;
+    std::copy(corners, corners + 6, texcoords.begin() + 6 * index);
+
+    // square root of the area ratio, so one value serves every direction on the surface
+    double uvArea = std::abs((corners[2] - corners[0]) * (corners[5] - corners[1]) - (corners[4] - corners[0]) * (corners[3] - corners[1]));
+    double area = e1.cross(e2).length();
+    uvScales[index] = area > 0 ? (float)std::sqrt(uvArea / area) : 0.0f;
+}
+
+int TriangleStore::intersect(const Ray &ray, uint32_t first, uint32_t num, double tMin, double &closestT) const
+{
+    if (moving)
+        return intersectRange<true>(ray, first, num, tMin, closestT);
+    return intersectRange<false>(ray, first, num, tMin, closestT);
+}
+
+template <bool Moving>
+int TriangleStore::intersectRange(const Ray &ray, uint32_t first, uint32_t num, double tMin, double &closestT) const
+{
+    const double epsilon = std::numeric_limits<double>::epsilon();
+    const double ox = ray.origin.x, oy = ray.origin.y, oz = ray.origin.z;
+    const double dx = ray.direction.x, dy = ray.direction.y, dz = ray.direction.z;
+    const double time = ray.time;
+    // lane numbers as doubles, so the range test below compares doubles like the rest of the lane loop
+    static const double laneIndex[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    int closestIndex = -1;
+
+    for (uint32_t base = first; base < first + num; base += LANES)
+    {
+        alignas(64) double tLane[LANES];
+        alignas(64) double hitLane[LANES];
+        const double tMax = closestT;
+        const double lanesInRange = first + num - base;
+        const double *av0x = v0x.data() + base, *av0y = v0y.data() + base, *av0z = v0z.data() + base;
+        const double *ae1x = e1x.data() + base, *ae1y = e1y.data() + base, *ae1z = e1z.data() + base;
+        const double *ae2x = e2x.data() + base, *ae2y = e2y.data() + base, *ae2z = e2z.data() + base;
+        const double *adv0x = nullptr, *adv0y = nullptr, *adv0z = nullptr;
+        const double *ade1x = nullptr, *ade1y = nullptr, *ade1z = nullptr;
+        const double *ade2x = nullptr, *ade2y = nullptr, *ade2z = nullptr;
+        if (Moving)
+        {
+            adv0x = dv0x.data() + base, adv0y = dv0y.data() + base, adv0z = dv0z.data() + base;
+            ade1x = de1x.data() + base, ade1y = de1y.data() + base, ade1z = de1z.data() + base;
+            ade2x = de2x.data() + base, ade2y = de2y.data() + base, ade2z = de2z.data() + base;
+        }
+
+        // one branch-free pass over LANES triangles: the tests are combined with & instead of &&,
+        // so no lane leaves the loop early and it vectorizes
+        for (int lane = 0; lane < LANES; ++lane)
+        {
+            double ax = av0x[lane], ay = av0y[lane], az = av0z[lane];
+            double ux = ae1x[lane], uy = ae1y[lane], uz = ae1z[lane];
+            double wx = ae2x[lane], wy = ae2y[lane], wz = ae2z[lane];
+            if (Moving)
+            {
+                ax += adv0x[lane] * time, ay += adv0y[lane] * time, az += adv0z[lane] * time;
+                ux += ade1x[lane] * time, uy += ade1y[lane] * time, uz += ade1z[lane] * time;
+                wx += ade2x[lane] * time, wy += ade2y[lane] * time, wz += ade2z[lane] * time;
+            }
+
+            double px = dy * wz - dz * wy;
+            double py = dz * wx - dx * wz;
+            double pz = dx * wy - dy * wx;
+            double det = ux * px + uy * py + uz * pz;
+            double invDet = 1 / det;
+
+            double tx = ox - ax, ty = oy - ay, tz = oz - az;
+            double u = (tx * px + ty * py + tz * pz) * invDet;
+
+            double qx = ty * uz - tz * uy;
+            double qy = tz * ux - tx * uz;
+            double qz = tx * uy - ty * ux;
+            double v = (dx * qx + dy * qy + dz * qz) * invDet;
+            double t = (wx * qx + wy * qy + wz * qz) * invDet;
+
+            bool hit = (laneIndex[lane] < lanesInRange) & ((det >= epsilon) | (det <= -epsilon)) & (u >= 0) & (u <= 1) &
+                       (v >= 0) & (u + v <= 1) & (t >= tMin) & (t <= tMax);
+            tLane[lane] = t;
+            hitLane[lane] = hit ? 1.0 : 0.0;
+        }
+
+        // same winner as testing one by one: the last of the closest hits
+        for (int lane = 0; lane < LANES; ++lane)
+        {
+            if (hitLane[lane] != 0 && tLane[lane] <= closestT)
+            {
+                closestT = tLane[lane];
+                closestIndex = (int)(base + lane);
+            }
+        }
+    }
+
+    return closestIndex;
+}
+
+void TriangleStore::vertexAt(size_t index, double time, Vec3 &v0, Vec3 &e1, Vec3 &e2) const
+{
+    v0 = Vec3(v0x[index], v0y[index], v0z[index]);
+    e1 = Vec3(e1x[index], e1y[index], e1z[index]);
+    e2 = Vec3(e2x[index], e2y[index], e2z[index]);
+    if (moving)
+    {
+        v0 += Vec3(dv0x[index], dv0y[index], dv0z[index]) * time;
+        e1 += Vec3(de1x[index], de1y[index], de1z[index]) * time;
+        e2 += Vec3(de2x[index], de2y[index], de2z[index]) * time;
+    }
+}
+
+void TriangleStore::fillHitRecord(const Ray &ray, int index, double t, HitRecord &rec) const
+{
+    Vec3 v0, e1, e2;
+    vertexAt(index, ray.time, v0, e1, e2);
+
+    rec.t = t;
+    rec.point = ray.at(t);
+    rec.normal = e1.cross(e2).normalize();
+    rec.material = materials[index];
+    rec.setFaceNormal(ray, rec.normal);
+
+    if (!uvScales.empty())
+    {
+        // barycentrics of the hit point
+        Vec3 w = rec.point - v0;
+        double d00 = e1.dot(e1), d01 = e1.dot(e2), d11 = e2.dot(e2);
+        double d20 = w.dot(e1), d21 = w.dot(e2);
+        double denom = d00 * d11 - d01 * d01;
+        double b1 = denom != 0 ? (d11 * d20 - d01 * d21) / denom : 0;
+        double b2 = denom != 0 ? (d00 * d21 - d01 * d20) / denom : 0;
+
+        const float *uv = &texcoords[6 * index];
+        rec.u = uv[0] + b1 * (uv[2] - uv[0]) + b2 * (uv[4] - uv[0]);
+        rec.v = uv[1] + b1 * (uv[3] - uv[1]) + b2 * (uv[5] - uv[1]);
+        rec.uvScale = uvScales[index];
+    }
+}
@@ -1,39 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "Utility.hpp"
 
-std::random_device rd;
-std::mt19937 gen(rd());
-std::uniform_real_distribution<double> dis(0.0, 1.0);
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace
+{
+    // counter word 2 of the per-sample camera dimensions; bounces use 1 + bounce
+    const uint32_t CAMERA_STREAM = 0;
+    const uint32_t NO_PAIR = 0xffffffffu;
+
+    struct ThreadState
+    {
+        RandomStream stream;
+        Philox::Key key = {0, 0};
+        uint32_t pixel = 0;
+        uint32_t sample = 0;
+        uint64_t pixelKey = 0; // of the sampler
+        uint32_t bounceDimension = 0; // first dimension of the current bounce
+        uint32_t dimension = 0;       // next sampler dimension
+        uint32_t dimensionEnd = 0;    // end of the current range
+        uint32_t cachedPair = NO_PAIR; // samplers produce dimensions two at a time
+        double pairValues[2];
+    };
+
+    thread_local ThreadState state;
+}
 
 Utility::Utility() {}
 
+void Utility::setSeed(uint64_t seed)
+{
+    this->seed = seed;
+}
+
+Philox::Key Utility::frameKey(uint32_t frame) const
+{
+    return {(uint32_t)seed, (uint32_t)(seed >> 32) ^ (frame * Philox::W0)};
+}
+
+void Utility::setSampler(std::shared_ptr<const Sampler> sampler)
+{
+    this->sampler = std::move(sampler);
+}
+
+void Utility::beginSample(uint32_t frame, uint32_t pixel, uint32_t sample)
+{
+    state.key = frameKey(frame);
+    state.pixel = pixel;
+    state.sample = sample;
+    state.stream.reset(state.key, pixel, sample, CAMERA_STREAM);
+    if (sampler)
+        state.pixelKey = sampler->pixelKey(frame, pixel);
+    state.cachedPair = NO_PAIR;
+    state.dimension = state.dimensionEnd = 0;
+}
+
+void Utility::beginBounce(uint32_t bounce)
+{
+    state.stream.reset(state.key, state.pixel, state.sample, CAMERA_STREAM + 1 + bounce);
+    state.bounceDimension = SampleLayout::CAMERA_DIMENSIONS + bounce * SampleLayout::BOUNCE_DIMENSIONS;
+    state.dimension = state.dimensionEnd = 0;
+}
+
+void Utility::useDimensions(DimensionRange range)
+{
+    state.dimension = state.bounceDimension + range.first;
+    state.dimensionEnd = state.dimension + range.count;
+}
+
+void Utility::sampleBatch(uint32_t frame, uint32_t pixel, uint32_t firstSample, size_t count, uint32_t block, double *out) const
+{
+    // the scalar stream of a sample starts at block 0, so batches are not reused by randomDouble;
+    // the bits go through a per-thread buffer that keeps its memory between calls
+    thread_local std::vector<uint32_t> bits;
+    bits.resize(4 * count);
+    Philox::generateBatch(frameKey(frame), pixel, firstSample, CAMERA_STREAM, 0x80000000u + block, count, bits.data());
+
+    for (size_t i = 0; i < bits.size(); ++i)
+    {
+        out[i] = Philox::toUnitDouble(bits[i]);
+    }
+}
+
+void Utility::cameraSamples(uint32_t frame, uint32_t pixel, uint32_t firstSample, size_t count, double *out) const
+{
+    if (!sampler)
+    {
+        sampleBatch(frame, pixel, firstSample, count, 0, out);
+        sampleBatch(frame, pixel, firstSample, count, 1, out + 4 * count);
+        return;
+    }
+
+    uint64_t pixelKey = sampler->pixelKey(frame, pixel);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t sample = firstSample + (uint32_t)i;
+        sampler->getPair(pixelKey, sample, SampleLayout::PIXEL_X / 2, out[i], out[count + i]);
+        sampler->getPair(pixelKey, sample, SampleLayout::LENS_U / 2, out[3 * count + i], out[4 * count + i]);
+        out[2 * count + i] = sampler->get(pixelKey, sample, SampleLayout::TIME);
+    }
+}
+
 double Utility::randomDouble()
 {
-    return dis(gen);
+    if (state.dimension < state.dimensionEnd && sampler)
+    {
+        uint32_t dimension = state.dimension++;
+        if (dimension / 2 != state.cachedPair)
+        {
+            state.cachedPair = dimension / 2;
+            sampler->getPair(state.pixelKey, state.sample, state.cachedPair, state.pairValues[0], state.pairValues[1]);
+        }
+        return state.pairValues[dimension % 2];
+    }
+    return state.stream.nextDouble();
 }
 
 double Utility::randomDouble(double min, double max)
 {
-    std::uniform_real_distribution<double> dis(min, max);
-    return dis(gen);
+    return min + (max - min) * randomDouble();
 }
 
 Vec3 Utility::randomPointInUnitDisk()
 {
-    while (true)
-    {
-        auto p = Vec3(randomDouble(-1, 1), randomDouble(-1, 1), 0);
-        if (p.lengthSquared() >= 1)
-            continue;
-        return p;
-    }
+    double u1 = randomDouble();
+    double u2 = randomDouble();
+    return pointInUnitDisk(u1, u2);
 }
 
 Vec3 Utility::randomUnitSphere()
 {
-    Vec3 point;
-    do
-    {
-        point = 2.0 * Vec3(randomDouble(), randomDouble(), randomDouble()) - Vec3(1, 1, 1);
-    } while (point.lengthSquared() >= 1.0);
-    return point;
-}
\ No newline at end of file
+    double u1 = randomDouble();
+    double u2 = randomDouble();
+    double u3 = randomDouble();
+    return pointInUnitSphere(u1, u2, u3);
+}
+
+Vec3 Utility::randomUnitVector()
+{
+    double u1 = randomDouble();
+    double u2 = randomDouble();
+    return pointOnUnitSphere(u1, u2);
+}
+
+Vec3 Utility::pointInUnitDisk(double u1, double u2)
+{
+    double r = std::sqrt(u1);
+    double theta = 2.0 * M_PI * u2;
+    return Vec3(r * std::cos(theta), r * std::sin(theta), 0);
+}
+
+Vec3 Utility::pointInUnitSphere(double u1, double u2, double u3)
+{
+    // uniform direction scaled by a radius whose cube is uniform
+    double z = 1.0 - 2.0 * u1;
+    double ringRadius = std::sqrt(std::max(0.0, 1.0 - z * z));
+    double phi = 2.0 * M_PI * u2;
+    double r = std::cbrt(u3);
+    return Vec3(r * ringRadius * std::cos(phi), r * ringRadius * std::sin(phi), r * z);
+}
+
+Vec3 Utility::pointOnUnitSphere(double u1, double u2)
+{
+    double z = 1.0 - 2.0 * u1;
+    double ringRadius = std::sqrt(std::max(0.0, 1.0 - z * z));
+    double phi = 2.0 * M_PI * u2;
+    return Vec3(ringRadius * std::cos(phi), ringRadius * std::sin(phi), z);
+}
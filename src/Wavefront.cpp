@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <limits>
+
+#include "globals.hpp"
+#include "Material.hpp"
+#include "Wavefront.hpp"
+
+namespace
+{
+    const int NUM_MATERIAL_TYPES = (int)MaterialType::Other + 1;
+}
+
+void Wavefront::clear()
+{
+    paths.clear();
+    pixels.clear();
+    samples.clear();
+}
+
+size_t Wavefront::addPath(const Ray &ray, uint32_t pixel, uint32_t sample)
+{
+    Integrator::Path path;
+    path.ray = ray;
+    paths.push_back(path);
+    pixels.push_back(pixel);
+    samples.push_back(sample);
+    return paths.size() - 1;
+}
+
+void Wavefront::trace(const Integrator &integrator, const World &world, uint32_t frame, bool packets, bool firstHits)
+{
+    size_t numPaths = paths.size();
+    recs.resize(numPaths);
+    pathLengths.assign(numPaths, 0);
+    if (firstHits)
+        firstHitAovs.resize(numPaths);
+
+    active.resize(numPaths);
+    for (size_t i = 0; i < numPaths; ++i)
+    {
+        active[i] = (uint32_t)i;
+    }
+
+    for (int bounce = 0; bounce < integrator.maxBounces() && !active.empty(); ++bounce)
+    {
+        extend(world, bounce, packets && bounce == 0);
+        if (firstHits && bounce == 0)
+        {
+            for (size_t i = 0; i < active.size(); ++i)
+            {
+                uint32_t p = active[i];
+                integrator.firstHit(paths[p].ray, world, hitFlags[i], recs[p], firstHitAovs[p]);
+            }
+        }
+
+        sortHits(integrator, world);
+        shade(integrator, world, frame, bounce);
+        traceShadows(integrator, world);
+        active.swap(survivors);
+    }
+
+    for (uint32_t p : active)
+    {
+        integrator.exhaust(paths[p], world);
+    }
+}
+
+void Wavefront::extend(const World &world, int bounce, bool packets)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    size_t count = active.size();
+    hitFlags.resize(count);
+
+    if (!packets)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t p = active[i];
+            pathLengths[p]++;
+            hitFlags[i] = world.intersect(paths[p].ray, 0.001, infinity, recs[p]);
+        }
+        return;
+    }
+
+    RayPacket packet;
+    HitRecord packetRecs[RayPacket::SIZE];
+    for (size_t first = 0; first < count; first += RayPacket::SIZE)
+    {
+        int lanes = (int)std::min<size_t>(RayPacket::SIZE, count - first);
+        packet.clear();
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            packet.setRay(lane, paths[active[first + lane]].ray, infinity);
+        }
+        uint32_t hitMask = world.intersectPacket(packet, 0.001, packetRecs);
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            uint32_t p = active[first + lane];
+            pathLengths[p]++;
+            hitFlags[first + lane] = (hitMask >> lane) & 1;
+            if (hitFlags[first + lane])
+                recs[p] = packetRecs[lane];
+        }
+    }
+}
+
+void Wavefront::sortHits(const Integrator &integrator, const World &world)
+{
+    // misses end here; the hits go to the shade queue grouped by material type (counting sort)
+    int counts[NUM_MATERIAL_TYPES + 1] = {};
+    hits.clear();
+    for (size_t i = 0; i < active.size(); ++i)
+    {
+        uint32_t p = active[i];
+        if (!hitFlags[i])
+        {
+            integrator.miss(paths[p], world);
+            continue;
+        }
+        hits.push_back(p);
+        counts[(int)recs[p].material->type + 1]++;
+    }
+
+    for (int type = 0; type < NUM_MATERIAL_TYPES; ++type)
+    {
+        counts[type + 1] += counts[type];
+    }
+    sorted.resize(hits.size());
+    for (uint32_t p : hits)
+    {
+        sorted[counts[(int)recs[p].material->type]++] = p;
+    }
+    hits.swap(sorted);
+}
+
+void Wavefront::shade(const Integrator &integrator, const World &world, uint32_t frame, int bounce)
+{
+    survivors.clear();
+    shadowPaths.clear();
+    shadowRays.clear();
+
+    Integrator::LightSample light;
+    for (uint32_t p : hits)
+    {
+        util.beginSample(frame, pixels[p], samples[p]);
+        util.beginBounce(bounce);
+        light.light = nullptr;
+        if (integrator.shade(world, bounce, recs[p], paths[p], light))
+            survivors.push_back(p);
+        if (light.light)
+        {
+            shadowPaths.push_back(p);
+            shadowRays.push_back(light);
+        }
+    }
+}
+
+void Wavefront::traceShadows(const Integrator &integrator, const World &world)
+{
+    for (size_t i = 0; i < shadowPaths.size(); ++i)
+    {
+        integrator.traceShadow(world, shadowRays[i], paths[shadowPaths[i]]);
+    }
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "WideBVH.hpp"
+
+namespace
+{
+    const int MAX_QUANTIZED = 255;
+    const int MIN_EXPONENT = -128;
+    const int MAX_EXPONENT = 127;
+
+    float roundDown(double value)
+    {
+        float rounded = (float)value;
+        if ((double)rounded > value)
+            rounded = std::nextafter(rounded, -std::numeric_limits<float>::infinity());
+        return rounded;
+    }
+
+    double step(int exponent)
+    {
+        return std::ldexp(1.0, exponent);
+    }
+}
+
+void WideBVH::clear()
+{
+    nodes.clear();
+    bounds = BoundingBox();
+}
+
+void WideBVH::build(const BVH &bvh)
+{
+    clear();
+    if (bvh.empty())
+        return;
+
+    nodes.reserve(bvh.nodes.size() / 2 + 1);
+    bounds = bvh.nodes[0].bounds;
+    collapse(bvh, 0);
+}
+
+uint32_t WideBVH::collapse(const BVH &bvh, uint32_t binaryNode)
+{
+    // open up the largest interior child until the node is full
+    std::vector<uint32_t> children;
+    const BVHNode &root = bvh.nodes[binaryNode];
+    if (root.isLeaf())
+    {
+        children.push_back(binaryNode);
+    }
+    else
+    {
+        children.push_back(root.leftOrFirst);
+        children.push_back(root.leftOrFirst + 1);
+    }
+
+    while ((int)children.size() < WIDTH)
+    {
+        int largest = -1;
+        double largestArea = -1;
+        for (int i = 0; i < (int)children.size(); ++i)
+        {
+            const BVHNode &child = bvh.nodes[children[i]];
+            if (!child.isLeaf() && child.bounds.surfaceArea() > largestArea)
+            {
+                largest = i;
+                largestArea = child.bounds.surfaceArea();
+            }
+        }
+        if (largest < 0)
+            break;
+
+        uint32_t opened = children[largest];
+        children[largest] = bvh.nodes[opened].leftOrFirst;
+        children.push_back(bvh.nodes[opened].leftOrFirst + 1);
+    }
+
+    uint32_t nodeIndex = (uint32_t)nodes.size();
+    nodes.emplace_back();
+
+    WideBVHNode node = {};
+    node.numChildren = (uint8_t)children.size();
+
+    // quantization grid: origin at the node min, 255 steps reach the node max
+    const BoundingBox &box = bvh.nodes[binaryNode].bounds;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double lo = box.min[axis];
+        double hi = box.max[axis];
+        float origin = roundDown(lo);
+
+        int exponent = MIN_EXPONENT;
+        double extent = hi - origin;
+        if (extent > 0)
+            exponent = std::max(MIN_EXPONENT, (int)std::ceil(std::log2(extent / MAX_QUANTIZED)));
+        while (exponent < MAX_EXPONENT && origin + MAX_QUANTIZED * step(exponent) < hi)
+            ++exponent;
+
+        node.origin[axis] = origin;
+        node.exponent[axis] = (int8_t)exponent;
+
+        // decode exactly like the traversal and move planes outwards until they enclose the child
+        double scale = stepSize(node.exponent[axis]);
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            const BoundingBox &childBox = bvh.nodes[children[i]].bounds;
+            int qlo = std::min(MAX_QUANTIZED, std::max(0, (int)std::floor((childBox.min[axis] - origin) / scale)));
+            int qhi = std::min(MAX_QUANTIZED, std::max(0, (int)std::ceil((childBox.max[axis] - origin) / scale)));
+            while (qlo > 0 && origin + qlo * scale > childBox.min[axis])
+                --qlo;
+            while (qhi < MAX_QUANTIZED && origin + qhi * scale < childBox.max[axis])
+                ++qhi;
+            node.qlo[axis][i] = (uint8_t)qlo;
+            node.qhi[axis][i] = (uint8_t)qhi;
+        }
+    }
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        const BVHNode &child = bvh.nodes[children[i]];
+        if (child.isLeaf())
+        {
+            if (child.count > std::numeric_limits<uint16_t>::max())
+                throw std::length_error("BVH leaf too large for a wide node");
+            node.child[i] = child.leftOrFirst;
+            node.count[i] = (uint16_t)child.count;
+        }
+        else
+        {
+            node.child[i] = collapse(bvh, children[i]);
+            node.count[i] = 0;
+        }
+    }
+
+    nodes[nodeIndex] = node;
+    return nodeIndex;
+}
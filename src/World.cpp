@@ -1,7 +1,78 @@
+#include <algorithm>
+#include <limits>
+
+#include "Material.hpp"
 #include "World.hpp"
 
-void World::addObject(std::shared_ptr<Hittable> object) {
+size_t World::addObject(std::shared_ptr<const Hittable> object) {
     objects.push_back(object);
+    objectMaterials.push_back(nullptr);
+    bvh = std::make_shared<BVH>();
+    return objects.size() - 1;
+}
+
+void World::build() {
+    objectBounds.clear();
+    objectBounds.reserve(objects.size());
+    for (const auto& object : objects) {
+        objectBounds.push_back(object->boundingBox);
+    }
+    auto built = std::make_shared<BVH>();
+    built->build(objectBounds, 1);
+    bvh = built;
+    builtSahCost = bvh->stats.sahCost;
+    movedObjects.clear();
+    collectLights();
+}
+
+void World::collectLights() {
+    lights.clear();
+    for (size_t id = 0; id < objects.size(); ++id) {
+        const Hittable& object = *objects[id];
+        if (object.material && object.material->emissive && object.supportsLightSampling()) {
+            lights.push_back((uint32_t)id);
+        }
+    }
+}
+
+void World::moveObject(size_t id, const Vec3& pos) {
+    std::shared_ptr<Hittable> moved = objects[id]->clone();
+    moved->moveTo(pos);
+    objects[id] = moved;
+    movedObjects.push_back((uint32_t)id);
+}
+
+void World::setMaterial(size_t id, std::shared_ptr<const Material> material) {
+    std::shared_ptr<Hittable> changed = objects[id]->clone();
+    changed->material = material.get();
+    objects[id] = changed;
+    objectMaterials[id] = material;
+    collectLights();
+}
+
+bool World::update() {
+    if (bvh->empty()) {
+        build();
+        return true;
+    }
+    if (movedObjects.empty()) {
+        return false;
+    }
+
+    for (uint32_t id : movedObjects) {
+        objectBounds[id] = objects[id]->boundingBox;
+    }
+    // refit a copy: earlier snapshots keep traversing the old one
+    auto refitted = std::make_shared<BVH>(*bvh);
+    refitted->refit(objectBounds, movedObjects);
+    bvh = refitted;
+    movedObjects.clear();
+
+    if (bvh->stats.sahCost > rebuildThreshold * builtSahCost) {
+        build();
+        return true;
+    }
+    return false;
 }
 
 bool World::intersect(const Ray& ray, double t_min, double t_max, HitRecord& rec) const {
@@ -9,13 +80,171 @@ bool World::intersect(const Ray& ray, double t_min, double t_max, HitRecord& rec
     bool hitAnything = false;
     double closestSoFar = t_max;
 
+    if (!bvh->empty()) {
+        return bvh->traverse(ray, t_min, t_max, [&](uint32_t index, double tMin, double& closestT) {
+            if (objects[index]->intersect(ray, tMin, closestT, tempRec)) {
+                closestT = tempRec.t;
+                rec = tempRec;
+                rec.object = objects[index].get();
+                return true;
+            }
+            return false;
+        });
+    }
+
     for (const auto& object : objects) {
         if (object->intersect(ray, t_min, closestSoFar, tempRec)) {
             hitAnything = true;
             closestSoFar = tempRec.t;
             rec = tempRec;
+            rec.object = object.get();
         }
     }
 
     return hitAnything;
-}
\ No newline at end of file
+}
+
+uint32_t World::intersectPacket(RayPacket& packet, double t_min, HitRecord* recs) const {
+    uint32_t activeMask = packet.activeMask;
+
+    // the packet is only coherent if every ray crosses the splitting planes in the same order
+    bool coherent = true;
+    int firstLane = activeMask ? __builtin_ctz(activeMask) : 0;
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        if (activeMask & (1u << lane)) {
+            coherent = coherent && (packet.dx[lane] < 0) == (packet.dx[firstLane] < 0) &&
+                       (packet.dy[lane] < 0) == (packet.dy[firstLane] < 0) &&
+                       (packet.dz[lane] < 0) == (packet.dz[firstLane] < 0);
+        }
+    }
+
+    auto traceSingle = [&](int lane, uint32_t root) {
+        Ray ray = packet.ray(lane);
+        HitRecord tempRec;
+        bvh->traverse(ray, t_min, packet.tMax[lane], [&](uint32_t index, double tMin, double& closestT) {
+            if (objects[index]->intersect(ray, tMin, closestT, tempRec)) {
+                closestT = tempRec.t;
+                packet.tMax[lane] = tempRec.t;
+                packet.hitObject[lane] = index;
+                return true;
+            }
+            return false;
+        }, root);
+    };
+
+    if (bvh->empty()) {
+        for (size_t index = 0; index < objects.size(); ++index) {
+            objects[index]->intersectPacket(packet, activeMask, t_min, (int)index);
+        }
+    } else if (!coherent) {
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            if (activeMask & (1u << lane)) {
+                traceSingle(lane, 0);
+            }
+        }
+    } else {
+        const double* directions[3] = {packet.dx, packet.dy, packet.dz};
+        alignas(64) double tEntry[RayPacket::SIZE];
+        uint32_t stack[BVH::MAX_STACK_DEPTH];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            uint32_t nodeIndex = stack[--stackSize];
+            const BVHNode& node = bvh->nodes[nodeIndex];
+
+            // lanes that enter this node before their closest hit so far
+            uint32_t nodeMask = node.bounds.intersectPacket(packet, t_min, activeMask, tEntry);
+            if (nodeMask == 0) {
+                continue;
+            }
+            if (popcount(nodeMask) == 1) {
+                traceSingle(__builtin_ctz(nodeMask), nodeIndex);
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    uint32_t index = bvh->primIndices[node.leftOrFirst + i];
+                    objects[index]->intersectPacket(packet, nodeMask, t_min, (int)index);
+                }
+            } else {
+                // all rays agree on direction signs, so one child is in front for all of them
+                bool leftFirst = directions[node.axis][firstLane] >= 0;
+                uint32_t nearChild = leftFirst ? node.leftOrFirst : node.leftOrFirst + 1;
+                uint32_t farChild = leftFirst ? node.leftOrFirst + 1 : node.leftOrFirst;
+                stack[stackSize++] = farChild;
+                stack[stackSize++] = nearChild;
+            }
+        }
+    }
+
+    // rebuild full hit records from the closest object of each lane
+    uint32_t hitMask = 0;
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        int object = packet.hitObject[lane];
+        if ((activeMask & (1u << lane)) && object >= 0 &&
+            objects[object]->intersect(packet.ray(lane), t_min, std::numeric_limits<double>::infinity(), recs[lane])) {
+            recs[lane].object = objects[object].get();
+            hitMask |= 1u << lane;
+        }
+    }
+    return hitMask;
+}
+
+bool World::sampleLight(const Vec3& origin, double time, double u0, double u1, double u2,
+                        Vec3& direction, double& distance, double& pdf, const Hittable*& light) const {
+    if (lights.empty()) {
+        return false;
+    }
+
+    double total = totalLightWeight(origin, time);
+    if (!(total > 0)) {
+        return false;
+    }
+
+    double target = u0 * total;
+    double weight = 0;
+    for (uint32_t id : lights) {
+        light = objects[id].get();
+        weight = lightWeight(*light, origin, time);
+        if (target < weight) {
+            break;
+        }
+        target -= weight;
+    }
+    if (!(weight > 0) || !light->sampleDirection(origin, time, u1, u2, direction, distance, pdf)) {
+        return false;
+    }
+    pdf *= weight / total;
+    return true;
+}
+
+double World::lightWeight(const Hittable& light, const Vec3& origin, double time) const {
+    Vec3 emitted = MaterialDispatch::emitted(light.material, light.boundingBox.centroid());
+    double luminance = 0.2126 * emitted.x + 0.7152 * emitted.y + 0.0722 * emitted.z;
+    return luminance * light.solidAngle(origin, time);
+}
+
+double World::totalLightWeight(const Vec3& origin, double time) const {
+    double total = 0;
+    for (uint32_t id : lights) {
+        total += lightWeight(*objects[id], origin, time);
+    }
+    return total;
+}
+
+double World::lightPdf(const Hittable* object, const Vec3& origin, double time, const Vec3& direction) const {
+    if (!object || lights.empty() || !object->material->emissive || !object->supportsLightSampling()) {
+        return 0;
+    }
+    double total = totalLightWeight(origin, time);
+    if (!(total > 0)) {
+        return 0;
+    }
+    return object->directionPdf(origin, time, direction) * lightWeight(*object, origin, time) / total;
+}
+
+const BVHStats& World::bvhStats() const {
+    return bvh->stats;
+}
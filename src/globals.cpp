@@ -2,6 +2,3 @@
 
 Utility util;
 
-std::atomic<uint64_t> numRays(0);
-std::atomic<uint64_t> numBVIntersections(0);
-std::atomic<uint64_t> numObjectIntersections(0);
\ No newline at end of file
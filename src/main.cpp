@@ -1,4 +1,5 @@
-#include <ctime>
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -7,109 +8,107 @@
 #include <vector>
 
 #include "Camera.hpp"
+#include "FrameWriter.hpp"
 #include "globals.hpp"
 #include "Material.hpp"
+#include "MeshCache.hpp"
+#include "Metrics.hpp"
 #include "Object.hpp"
 #include "Ray.hpp"
+#include "RenderFarm.hpp"
+#include "Renderer.hpp"
+#include "RenderSettings.hpp"
+#include "Texture.hpp"
 #include "Utility.hpp"
 #include "Vec3.hpp"
 #include "World.hpp"
 
-// constants
-const int MAX_DEPTH = 50;
-
-// mutable
-int numFrames = 2; // adjustable via args
-Vec3 currentBgTop = Vec3(0.53, 0.81, 0.98);
-Vec3 currentBgBottom = Vec3(0.53, 0.81, 0.98);
-
-std::shared_ptr<CompoundShape> loadObject(std::string modelFilePath, Material *objMaterial)
+MeshData loadMesh(const std::string &modelFilePath, const RenderSettings &settings)
 {
     std::cout << "Loading file: " << modelFilePath << std::endl;
 
-    Object *obj = new Object(modelFilePath);
-
-    std::cout << "Successfully parsed .obj file\n"
-              << "Generating triangles..."
-              << std::endl;
+    MeshData mesh;
+    std::string cachePath = MeshCache::pathFor(modelFilePath, settings.meshCacheDir);
+    if (settings.meshCache && MeshCache::load(modelFilePath, cachePath, mesh))
+    {
+        std::cout << "Loaded cached mesh: " << cachePath << std::endl;
+    }
+    else
+    {
+        Object obj(modelFilePath, settings.numThreads);
 
-    std::vector<std::shared_ptr<Triangle>> triangles;
+        std::cout << "Successfully parsed .obj file\n"
+                  << "Generating triangles..."
+                  << std::endl;
 
-    for (const auto &face : obj->getFaces())
-    {
-        auto tri = std::make_shared<Triangle>(Vec3(face[0].x, face[0].y, face[0].z),
-                                              Vec3(face[1].x, face[1].y, face[1].z),
-                                              Vec3(face[2].x, face[2].y, face[2].z),
-                                              objMaterial);
-        triangles.push_back(tri);
+        mesh = MeshData::build(obj);
+        if (settings.meshCache && !MeshCache::save(modelFilePath, cachePath, mesh))
+            std::cout << "Could not write mesh cache: " << cachePath << std::endl;
     }
 
     std::cout << "Successfully loaded " << modelFilePath << "!" << std::endl;
-
-    return std::make_shared<CompoundShape>(triangles, objMaterial);
+    return mesh;
 }
 
-double clamp(double value, double min, double max)
+std::shared_ptr<CompoundShape> loadObject(std::string modelFilePath, Material *objMaterial, const RenderSettings &settings)
 {
-    if (value < min)
-        return min;
-    if (value > max)
-        return max;
-    return value;
+    MeshData mesh = loadMesh(modelFilePath, settings);
+    return std::make_shared<CompoundShape>(mesh.toTriangleMesh(objMaterial), objMaterial);
 }
 
-Vec3 interpolate(const Vec3 &start, const Vec3 &end, int frame, int numFrames)
+// settings.texturedMesh with a TexturedLambertian of its texture, which material receives
+std::shared_ptr<CompoundShape> loadTexturedObject(const RenderSettings &settings, std::shared_ptr<TextureCache> textureCache,
+                                                  std::shared_ptr<Material> &material)
 {
-    return start + (end - start) * (((double)frame) / std::max(numFrames - 1, 1));
+    MeshData mesh = loadMesh(settings.texturedMesh, settings);
+    std::string texturePath = settings.texture.empty() ? mesh.diffuseMap : settings.texture;
+    if (texturePath.empty())
+        throw std::runtime_error(settings.texturedMesh + " names no diffuse map; pass one with --texture");
+
+    std::shared_ptr<Texture> texture = Texture::load(texturePath, settings.meshCacheDir, textureCache);
+    std::cout << (texture->wasConverted() ? "Converted texture: " : "Loaded cached texture: ") << texturePath << " ("
+              << texture->width() << "x" << texture->height() << ", " << texture->numLevels() << " levels)" << std::endl;
+
+    material = std::make_shared<TexturedLambertian>(texture);
+    return std::make_shared<CompoundShape>(mesh.toTriangleMesh(material.get(), true), material.get());
 }
 
-Vec3 rayColor(const Ray &ray, const World &world, int depth)
+void writeImage(const std::string &filename, const std::vector<Vec3> &pixels, int width, int height)
 {
-    if (depth <= 0)
-    {
-        return currentBgTop;
-    }
+    std::vector<uint8_t> bytes = ImageEncoding::encode(ImageFormat::PFM, pixels, width, height);
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    if (!file)
+        throw std::runtime_error("Could not write AOV: " + filename);
+}
 
-    HitRecord rec;
+// frames/albedo_N.pfm, normal_N.pfm and depth_N.pfm; depth is 0 where nothing was hit
+void writeAovs(const AovBuffers &aovs, int frame, int width, int height)
+{
+    std::string suffix = "_" + std::to_string(frame) + ".pfm";
+    writeImage("frames/albedo" + suffix, aovs.albedo, width, height);
+    writeImage("frames/normal" + suffix, aovs.normal, width, height);
 
-    if (world.intersect(ray, 0.001, std::numeric_limits<double>::infinity(), rec))
+    std::vector<Vec3> depth(aovs.depth.size());
+    for (size_t i = 0; i < depth.size(); ++i)
     {
-        numObjectIntersections.fetch_add(1);
-
-        Vec3 attenuation;
-        Ray scattered;
-
-        if (rec.material->emissive)
-        {
-            return rec.material->emitted(rec.point);
-        }
-        else if (rec.material->scatter(ray, rec, attenuation, scattered))
-        {
-            return attenuation * rayColor(scattered, world, depth - 1);
-        }
-        return Vec3(0, 0, 0); // no scattering or emission
+        double d = std::isfinite(aovs.depth[i]) ? aovs.depth[i] : 0.0;
+        depth[i] = Vec3(d, d, d);
     }
+    writeImage("frames/depth" + suffix, depth, width, height);
+}
 
-    // gradient sky
-    Vec3 unitDirection = ray.direction.normalize();
-    double t = 0.5 * (unitDirection.y + 1.0);
-    return (1.0 - t) * currentBgBottom + t * currentBgTop;
+Vec3 interpolate(const Vec3 &start, const Vec3 &end, int frame, int numFrames)
+{
+    return start + (end - start) * (((double)frame) / std::max(numFrames - 1, 1));
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc >= 2)
-    {
-        try
-        {
-            numFrames = std::stod(argv[1]);
-        }
-        catch (const std::exception &e)
-        {
-            std::cout << "Invalid format for given number of frames. Using 2 frames." << std::endl;
-            numFrames = 2;
-        }
-    }
+    RenderSettings settings = RenderSettings::fromArgs(argc, argv);
+    const int numFrames = settings.numFrames;
+    util.setSeed(settings.seed);
+    util.setSampler(Sampler::create(settings.sampler, settings.seed, settings.samplesPerPixel, settings.imageWidth));
 
     // start & end colors
     const Vec3 SUN_COLOR_START = Vec3(1, 1, 0.9);
@@ -160,9 +159,8 @@ int main(int argc, char *argv[])
     try
     {
         // camera setup
-        const int imageWidth = 640;
-        const int imageHeight = 480;
-        const int samplesPerPixel = 100;
+        const int imageWidth = settings.imageWidth;
+        const int imageHeight = settings.imageHeight;
         Vec3 lookFrom(0, 0, 20);
         Vec3 lookAt(0, 0, 0);
         Vec3 up(0, 1, 0);
@@ -172,22 +170,37 @@ int main(int argc, char *argv[])
         double focusDistance = (lookFrom - lookAt).length();
         Camera camera(lookFrom, lookAt, up, verticalFOV, aspectRatio, aperture, focusDistance);
 
-        std::vector<std::shared_ptr<Hittable>> hittables;
+        // the scene persists across frames; moving objects are refitted into its BVH
+        World world;
+        world.setRebuildThreshold(settings.rebuildThreshold);
 
         // sun
         Emissive sunMaterial(SUN_COLOR_START);
         auto sun = std::make_shared<Sphere>(SUN_POSITION_START, 6.0, &sunMaterial);
-        hittables.push_back(sun);
+        size_t sunId = world.addObject(sun);
         // moon
         Emissive moonMaterial(MOON_COLOR_START);
         auto moon = std::make_shared<Sphere>(MOON_POSITION_START, 4.0, &moonMaterial);
-        hittables.push_back(moon);
+        size_t moonId = world.addObject(moon);
 
         // objects floating in water
         // CompoundShape loaded from .obj file
+        Stopwatch loadTimer;
         Emissive objMaterial(Vec3(1.0, 0.8745, 0.8));
-        auto obj = loadObject("../../common/objects/cube.obj", &objMaterial);
-        hittables.push_back(obj);
+        auto obj = loadObject("../../common/objects/cube.obj", &objMaterial, settings);
+        size_t objId = world.addObject(obj);
+        // optional textured mesh, standing in the water between the camera and the spheres
+        std::shared_ptr<TextureCache> textureCache;
+        std::shared_ptr<Material> texturedMaterial;
+        if (!settings.texturedMesh.empty())
+        {
+            textureCache = std::make_shared<TextureCache>((size_t)settings.textureCacheMb << 20);
+            auto texturedObj = loadTexturedObject(settings, textureCache, texturedMaterial);
+            Vec3 size = texturedObj->boundingBox.max - texturedObj->boundingBox.min;
+            texturedObj->moveTo(Vec3(0, -2.2 + size.y / 2, 6));
+            world.addObject(texturedObj);
+        }
+        double loadTime = loadTimer.elapsed();
         // spheres
         auto sphere1 = std::make_shared<Sphere>(SPHERE1_START, 0.6, redLambertian.get());
         auto sphere2 = std::make_shared<Sphere>(SPHERE2_START, 0.7, orangeMetal.get());
@@ -195,12 +208,12 @@ int main(int argc, char *argv[])
         auto sphere4 = std::make_shared<Sphere>(SPHERE4_START, 0.5, purpleTranslucent.get());
         auto sphere5 = std::make_shared<Sphere>(SPHERE5_START, 0.6, pinkMetal.get());
         auto sphere6 = std::make_shared<Sphere>(SPHERE6_START, 0.7, mixedMaterial.get());
-        hittables.push_back(sphere1);
-        hittables.push_back(sphere2);
-        hittables.push_back(sphere3);
-        hittables.push_back(sphere4);
-        hittables.push_back(sphere5);
-        hittables.push_back(sphere6);
+        size_t sphere1Id = world.addObject(sphere1);
+        size_t sphere2Id = world.addObject(sphere2);
+        size_t sphere3Id = world.addObject(sphere3);
+        size_t sphere4Id = world.addObject(sphere4);
+        size_t sphere5Id = world.addObject(sphere5);
+        size_t sphere6Id = world.addObject(sphere6);
 
         // surface
         auto reflectiveWater = std::make_shared<Metal>(Vec3(0.9, 0.9, 1.0), 0.02);
@@ -212,110 +225,280 @@ int main(int argc, char *argv[])
         Vec3 surfaceTopRight(30, -2, 20);
         auto surfaceTri1 = std::make_shared<Triangle>(surfaceBottomLeft, surfaceBottomRight, surfaceTopLeft, surfaceMaterial.get());
         auto surfaceTri2 = std::make_shared<Triangle>(surfaceTopLeft, surfaceBottomRight, surfaceTopRight, surfaceMaterial.get());
-        hittables.push_back(surfaceTri1);
-        hittables.push_back(surfaceTri2);
+        size_t surfaceTri1Id = world.addObject(surfaceTri1);
+        size_t surfaceTri2Id = world.addObject(surfaceTri2);
+        // procedural water: waves that move on from frame to frame
+        auto noise = std::make_shared<const Perlin>(settings.seed);
+        RipplePattern waves;
+        waves.noise = noise;
 
         // backdrop
         auto translucentBackdrop = std::make_shared<Translucent>(1.33, Vec3(0.8, 0.8, 0.9));
-        auto lambertBackdrop = std::make_shared<Lambertian>(Vec3(0.98, 0.98, 1));
-        auto backdropMaterial = std::make_shared<MixedMaterial>(lambertBackdrop, translucentBackdrop, 0.5);
+        std::shared_ptr<Material> lambertBackdrop = std::make_shared<Lambertian>(Vec3(0.98, 0.98, 1));
         Vec3 backdropBottomLeft(-40, -4, -30);
         Vec3 backdropBottomRight(40, -4, -30);
         Vec3 backdropTopLeft(-40, 30, -30);
         Vec3 backdropTopRight(40, 30, -30);
+        if (settings.procedural)
+        {
+            // marble instead; it never moves, so it can be baked into a texture once
+            MarblePattern marble;
+            marble.noise = noise;
+            if (settings.bakeResolution > 0)
+            {
+                if (!textureCache)
+                    textureCache = std::make_shared<TextureCache>((size_t)settings.textureCacheMb << 20);
+                PlanarMapping mapping = {backdropBottomLeft, backdropBottomRight - backdropBottomLeft, backdropTopLeft - backdropBottomLeft};
+                Stopwatch bakeTimer;
+                auto baked = bakeMarble(marble, mapping, settings.bakeResolution, settings.meshCacheDir, textureCache);
+                std::cout << "Marble backdrop texture: " << baked->width() << "x" << baked->height() << ", ready in "
+                          << bakeTimer.elapsed() << " s" << std::endl;
+                lambertBackdrop = std::make_shared<Marble>(marble, baked, mapping);
+            }
+            else
+            {
+                lambertBackdrop = std::make_shared<Marble>(marble);
+            }
+        }
+        auto backdropMaterial = std::make_shared<MixedMaterial>(lambertBackdrop, translucentBackdrop, 0.5);
         auto backropTri1 = std::make_shared<Triangle>(backdropBottomLeft, backdropBottomRight, backdropTopLeft, backdropMaterial.get());
         auto backropTri2 = std::make_shared<Triangle>(backdropTopLeft, backdropBottomRight, backdropTopRight, backdropMaterial.get());
-        hittables.push_back(backropTri1);
-        hittables.push_back(backropTri2);
-
-        std::cout << "Rendering images..." << std::endl;
+        world.addObject(backropTri1);
+        world.addObject(backropTri2);
 
-        for (int frame = 0; frame < numFrames; ++frame)
-        {
-            printf("\nPreparing frame %lu...\n", frame);
-            World world;
-
-            // Reset metrics
-            numRays.store(0);
-            numBVIntersections.store(0);
-            numObjectIntersections.store(0);
-            clock_t timeStart = clock();
+        Renderer renderer(settings);
+        ImageFormat imageFormat = ImageEncoding::parseFormat(settings.imageFormat);
+        // two buffers per frame in flight: one batch renders while the previous one is written
+        FrameWriter frameWriter(imageFormat, imageWidth, imageHeight, 2 * settings.framesInFlight);
+        ReportWriter reportWriter(ReportWriter::parseFormat(settings.reportFormat), settings.reportFile);
 
+        // advances the scene to the given frame and returns an immutable snapshot of it
+        auto snapshotAt = [&](int frame) {
             // update sun, moon, & sky colors
             Vec3 currentSunColor = interpolate(SUN_COLOR_START, SUN_COLOR_END, frame, numFrames);
             Vec3 currentMoonColor = interpolate(MOON_COLOR_START, MOON_COLOR_END, frame, numFrames);
-            currentBgTop = interpolate(BG_TOP_START, BG_TOP_END, frame, numFrames);
-            currentBgBottom = interpolate(BG_BOTTOM_START, BG_BOTTOM_END, frame, numFrames);
-            sunMaterial.emit = currentSunColor;
-            moonMaterial.emit = currentMoonColor;
+            Sky sky;
+            sky.top = interpolate(BG_TOP_START, BG_TOP_END, frame, numFrames);
+            sky.bottom = interpolate(BG_BOTTOM_START, BG_BOTTOM_END, frame, numFrames);
+            world.setSky(sky);
+            world.setMaterial(sunId, std::make_shared<Emissive>(currentSunColor));
+            world.setMaterial(moonId, std::make_shared<Emissive>(currentMoonColor));
 
             // update sun & moon positions
             Vec3 currentSunPosition = interpolate(SUN_POSITION_START, SUN_POSITION_END, frame, numFrames);
             Vec3 currentMoonPosition = interpolate(MOON_POSITION_START, MOON_POSITION_END, frame, numFrames);
-            sun->moveTo(currentSunPosition);
-            moon->moveTo(currentMoonPosition);
+            world.moveObject(sunId, currentSunPosition);
+            world.moveObject(moonId, currentMoonPosition);
 
             // update floating object positions
             Vec3 currentObjPosition = interpolate(OBJ_POSITION_START, OBJ_POSITION_END, frame, numFrames);
-            obj->moveTo(currentObjPosition);
+            world.moveObject(objId, currentObjPosition);
             // spheres
             Vec3 currentSphere1Position = interpolate(SPHERE1_START, SPHERE1_END, frame, numFrames);
-            sphere1->moveTo(currentSphere1Position);
+            world.moveObject(sphere1Id, currentSphere1Position);
             Vec3 currentSphere2Position = interpolate(SPHERE2_START, SPHERE2_END, frame, numFrames);
-            sphere2->moveTo(currentSphere2Position);
+            world.moveObject(sphere2Id, currentSphere2Position);
             Vec3 currentSphere3Position = interpolate(SPHERE3_START, SPHERE3_END, frame, numFrames);
-            sphere3->moveTo(currentSphere3Position);
+            world.moveObject(sphere3Id, currentSphere3Position);
             Vec3 currentSphere4Position = interpolate(SPHERE4_START, SPHERE4_END, frame, numFrames);
-            sphere4->moveTo(currentSphere4Position);
+            world.moveObject(sphere4Id, currentSphere4Position);
             Vec3 currentSphere5Position = interpolate(SPHERE5_START, SPHERE5_END, frame, numFrames);
-            sphere5->moveTo(currentSphere5Position);
+            world.moveObject(sphere5Id, currentSphere5Position);
             Vec3 currentSphere6Position = interpolate(SPHERE6_START, SPHERE6_END, frame, numFrames);
-            sphere6->moveTo(currentSphere6Position);
+            world.moveObject(sphere6Id, currentSphere6Position);
 
-            // add objects to world
-            for (auto &hittable : hittables)
+            if (settings.procedural)
             {
-                world.addObject(hittable);
+                auto water = std::make_shared<Ripples>(waves, (double)frame, 1.33, Vec3(0, 0.22, 0.66));
+                world.setMaterial(surfaceTri1Id, water);
+                world.setMaterial(surfaceTri2Id, water);
             }
 
-            std::string frameFilename = "frames/output_" + std::to_string(frame) + ".ppm";
-            std::ofstream file(frameFilename);
-            file << "P3\n"
-                 << imageWidth << " " << imageHeight << "\n255\n";
+            // refit what moved, rebuilding only when the BVH has degraded
+            world.update();
+            return std::make_shared<const World>(world);
+        };
+
+        auto startReport = [&](int frame, size_t numThreads) {
+            FrameReport report;
+            report.frame = frame;
+            report.imageWidth = imageWidth;
+            report.imageHeight = imageHeight;
+            report.samplesPerPixel = settings.samplesPerPixel;
+            report.numThreads = numThreads;
+            report.loadTime = frame == 0 ? loadTime : 0.0;
+            return report;
+        };
+
+        if (settings.farmWorkers > 0)
+        {
+            // every snapshot exists before the workers are forked, so they all share them
+            std::vector<std::shared_ptr<const World>> snapshots;
+            std::vector<FrameReport> reports;
+            for (int frame = 0; frame < numFrames; ++frame)
+            {
+                FrameReport report = startReport(frame, settings.farmWorkers);
+                Stopwatch phaseTimer;
+                snapshots.push_back(snapshotAt(frame));
+                report.buildTime = phaseTimer.elapsed();
+                reports.push_back(report);
+            }
 
-            for (int j = imageHeight - 1; j >= 0; --j)
+            std::cout << "Rendering images on " << settings.farmWorkers << " worker process(es)..." << std::endl;
+            RenderFarm farm(settings, camera, snapshots);
+            farm.run([&](int frame, std::vector<Vec3> &pixels, const MetricsTotals &counters, uint32_t maxSamples, double renderTime) {
+                FrameReport &report = reports[frame];
+                std::vector<Vec3> &framebuffer = frameWriter.acquireBuffer(report.writeTime);
+                framebuffer.swap(pixels);
+                frameWriter.submit(framebuffer, "frames/output_" + std::to_string(frame) + ImageEncoding::extension(imageFormat));
+
+                report.renderTime = renderTime;
+                report.counters = counters;
+                report.maxSamplesPerPixel = (int)maxSamples;
+                report.bvhStats = snapshots[frame]->bvhStats();
+
+                printf("\nCompleted frame %d!\n", frame);
+                report.print();
+                reportWriter.write(report);
+            });
+            if (farm.crashedWorkers() > 0)
+                printf("Replaced %lu crashed worker(s)\n", (unsigned long)farm.crashedWorkers());
+        }
+        else
+        {
+            std::cout << "Rendering images on " << renderer.numThreads() << " thread(s)..." << std::endl;
+
+            for (int batchStart = 0; batchStart < numFrames; batchStart += settings.framesInFlight)
             {
-                for (int i = 0; i < imageWidth; ++i)
+                int batchEnd = std::min(numFrames, batchStart + settings.framesInFlight);
+                std::vector<FrameReport> reports;
+                std::vector<Renderer::FrameJob> jobs;
+
+                // Reset metrics
+                Metrics::reset();
+
+                for (int frame = batchStart; frame < batchEnd; ++frame)
                 {
-                    Vec3 color(0, 0, 0);
-                    for (int s = 0; s < samplesPerPixel; ++s)
+                    printf("\nPreparing frame %d...\n", frame);
+
+                    FrameReport report = startReport(frame, renderer.numThreads());
+                    report.batchFrames = batchEnd - batchStart;
+                    Stopwatch phaseTimer;
+                    std::shared_ptr<const World> snapshot = snapshotAt(frame);
+                    report.buildTime = phaseTimer.elapsed();
+
+                    reports.push_back(report);
+                    Renderer::FrameJob job;
+                    job.world = snapshot;
+                    job.frame = frame;
+                    jobs.push_back(std::move(job));
+                }
+
+                Stopwatch phaseTimer;
+                if (jobs.size() > 1)
+                {
+                    // write time is the time spent waiting for free buffers; the I/O thread does the rest
+                    for (size_t i = 0; i < jobs.size(); ++i)
+                    {
+                        jobs[i].framebuffer = &frameWriter.acquireBuffer(reports[i].writeTime);
+                    }
+
+                    phaseTimer.restart();
+                    renderer.renderFrames(camera, jobs);
+                    for (size_t i = 0; i < jobs.size(); ++i)
                     {
-                        double u = double(i + util.randomDouble()) / double(imageWidth - 1);
-                        double v = double(j + util.randomDouble()) / double(imageHeight - 1);
-                        double time = util.randomDouble(0.0, 1.0);
+                        reports[i].renderTime = phaseTimer.elapsed();
+                        frameWriter.submit(*jobs[i].framebuffer, "frames/output_" + std::to_string(jobs[i].frame) + ImageEncoding::extension(imageFormat));
+                    }
+                }
+                else if (settings.streamTiles)
+                {
+                    std::string frameFilename = "frames/output_" + std::to_string(jobs[0].frame) + ImageEncoding::extension(imageFormat);
+
+                    // tiles are written as they finish, so writing is part of rendering
+                    TileStreamWriter tileWriter(imageFormat, frameFilename, imageWidth, imageHeight);
+                    renderer.renderTiles(camera, *jobs[0].world, jobs[0].frame, [&](const Renderer::Tile &tile, const Vec3 *pixels) {
+                        tileWriter.writeTile(tile.x0, tile.y0, tile.x1 - tile.x0, tile.y1 - tile.y0, pixels);
+                    });
+                    tileWriter.close();
+                    reports[0].renderTime = phaseTimer.elapsed();
+                    if (settings.sampleCountAov)
+                        jobs[0].sampleCounts = renderer.sampleCounts();
+                }
+                else
+                {
+                    FrameReport &report = reports[0];
+                    std::string frameFilename = "frames/output_" + std::to_string(jobs[0].frame) + ImageEncoding::extension(imageFormat);
+
+                    // write time is the time spent waiting for a free buffer; the I/O thread does the rest
+                    std::vector<Vec3> &framebuffer = frameWriter.acquireBuffer(report.writeTime);
 
-                        Ray ray = camera.getRay(u, v, time);
-                        numRays.fetch_add(1);
-                        color += rayColor(ray, world, MAX_DEPTH);
+                    phaseTimer.restart();
+                    if (settings.progressive())
+                    {
+                        report.passes = renderer.renderProgressive(camera, *jobs[0].world, jobs[0].frame, framebuffer, report.noise,
+                                                                   [&](int pass, int samples, double noise) {
+                            printf("Pass %d: %d spp, noise %.4f, %.2f (sec)\n", pass, samples, noise, phaseTimer.elapsed());
+                            if (settings.writePasses)
+                            {
+                                // the partial image, replaced by the final one once the frame is done
+                                std::vector<uint8_t> bytes = ImageEncoding::encode(imageFormat, framebuffer, imageWidth, imageHeight);
+                                std::ofstream partial(frameFilename, std::ios::binary);
+                                partial.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+                            }
+                        });
                     }
+                    else
+                    {
+                        renderer.render(camera, *jobs[0].world, jobs[0].frame, framebuffer);
+                    }
+                    report.renderTime = phaseTimer.elapsed();
+                    if (settings.sampleCountAov)
+                        jobs[0].sampleCounts = renderer.sampleCounts();
+                    if (settings.writeAovs)
+                        jobs[0].aovs = renderer.aovBuffers();
 
-                    color /= double(samplesPerPixel);
-                    int ir = static_cast<int>(255.99 * clamp(sqrt(color.x), 0.0, 1.0));
-                    int ig = static_cast<int>(255.99 * clamp(sqrt(color.y), 0.0, 1.0));
-                    int ib = static_cast<int>(255.99 * clamp(sqrt(color.z), 0.0, 1.0));
-                    file << ir << " " << ig << " " << ib << "\n";
+                    frameWriter.submit(framebuffer, frameFilename);
+                }
+
+                MetricsTotals counters = Metrics::collect();
+                for (size_t i = 0; i < jobs.size(); ++i)
+                {
+                    int frame = jobs[i].frame;
+                    FrameReport &report = reports[i];
+
+                    if (settings.sampleCountAov)
+                    {
+                        std::vector<uint8_t> counts = ImageEncoding::encodeCounts(jobs[i].sampleCounts, imageWidth, imageHeight);
+                        std::string countsFilename = "frames/samples_" + std::to_string(frame) + ".pgm";
+                        std::ofstream countsFile(countsFilename, std::ios::binary);
+                        countsFile.write(reinterpret_cast<const char *>(counts.data()), counts.size());
+                        if (!countsFile)
+                            throw std::runtime_error("Could not write sample counts: " + countsFilename);
+                    }
+                    if (settings.writeAovs)
+                        writeAovs(jobs[i].aovs, frame, imageWidth, imageHeight);
+
+                    // a single frame's counts stay with the renderer unless the sample AOV asked for a copy
+                    const std::vector<uint32_t> &sampleCounts = jobs.size() > 1 ? jobs[i].sampleCounts : renderer.sampleCounts();
+                    report.maxSamplesPerPixel = sampleCounts.empty() ? 0 : (int)*std::max_element(sampleCounts.begin(), sampleCounts.end());
+                    report.counters = counters;
+                    report.bvhStats = jobs[i].world->bvhStats();
+
+                    printf("Completed frame %d!\n", frame);
+                    report.print();
+                    reportWriter.write(report);
                 }
             }
+        }
 
-            clock_t timeEnd = clock();
+        frameWriter.flush();
 
-            printf("Completed frame %lu!\n", frame);
-            printf("Metrics\n-------\n");
-            printf("Render Time                     : %04.2f (sec)\n", (float)(timeEnd - timeStart) / CLOCKS_PER_SEC);
-            printf("Rays Cast                       : %lu\n", numRays.load());
-            printf("Bounding Volume Intersections   : %lu\n", numBVIntersections.load());
-            printf("Successful Object Intersections : %lu\n", numObjectIntersections.load());
-            printf("----------------------------------------------\n");
+        if (textureCache)
+        {
+            TextureCache::Stats stats = textureCache->stats();
+            printf("Texture cache: %llu hits, %llu misses, %llu evictions (%zu tiles)\n", (unsigned long long)stats.hits,
+                   (unsigned long long)stats.misses, (unsigned long long)stats.evictions, textureCache->capacityTiles());
         }
     }
     catch (const std::runtime_error &e)